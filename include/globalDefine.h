@@ -13,6 +13,7 @@ namespace common
         queue,
         battle
     };
+    const uint32_t PLAYER_STATUS_COUNT = battle + 1;
 }
 
 // wq԰G`q
@@ -29,4 +30,111 @@ namespace battle_constant
     };
 }
 
+namespace player_constant
+{
+    // max resident players in PlayerManager, offline clean players above it are evicted (LRU)
+    const uint64_t RESIDENT_PLAYER_LIMIT = 1000000;
+
+    // player distribution histogram, the last tier / score bucket also counts everything above it
+    const uint32_t DISTRIBUTION_TIER_COUNT = 64;
+    const uint32_t DISTRIBUTION_SCORE_BUCKET_WIDTH = 50;
+    const uint32_t DISTRIBUTION_SCORE_BUCKET_COUNT = 256;
+
+    // ids below this are registered in PlayerManager's bitset (32 MB at most), higher or sparse ids
+    // (stripe-shifted id blocks, odd store rows) go to a hash set instead of growing the bitset
+    const uint64_t PLAYER_ID_BITSET_LIMIT = 1ull << 28;
+
+    // PlayerRecord stores updatedTime relative to this (2020-01-01 00:00:00 UTC, ms)
+    const uint64_t PLAYER_RECORD_EPOCH_MS = 1577836800000ull;
+
+    // where PlayerManager::queryPlayer found the player
+    enum PlayerQuerySource : uint8_t
+    {
+        notFound,
+        memory,     // resident player, current state
+        db,         // not resident, the stored row (flushed before eviction)
+    };
+}
+
+namespace schedule_constant
+{
+    // threads running due scheduler tasks, so a long task (player flush, snapshot) doesn't hold up the short periodic ones.
+    // a task never overlaps itself, a run due while the previous one is still going is skipped
+    const uint32_t SCHEDULE_EXECUTOR_COUNT = 3;
+}
+
+namespace db_constant
+{
+    // sqlite durability / io settings applied at connect (see DbManager::applyStorageProfile)
+    //   legacy    : sqlite defaults (rollback journal, synchronous FULL), readers block the writer
+    //   durable   : WAL, synchronous FULL   - every commit is on disk before it returns
+    //   balanced  : WAL, synchronous NORMAL - a power loss may drop the last commits, never corrupts
+    //   throughput: WAL, synchronous OFF    - the os decides when data hits the disk
+    enum StorageProfile : uint8_t
+    {
+        legacy,
+        durable,
+        balanced,
+        throughput,
+        StorageProfileMax
+    };
+    const StorageProfile STORAGE_PROFILE = StorageProfile::balanced;
+
+    // backend of the player rows (see IPlayerStore)
+    //   sqlite : player_battles / id_allocator tables of the game db
+    //   log    : append-only record file with an in-memory index (LogPlayerStore)
+    //   sharded: player_battles split over PLAYER_SHARD_COUNT sqlite files, each with its own
+    //            connection and writer thread (ShardedPlayerStore)
+    enum PlayerStoreBackend : uint8_t
+    {
+        sqlite,
+        log,
+        sharded,
+        PlayerStoreBackendMax
+    };
+    const PlayerStoreBackend PLAYER_STORE_BACKEND = PlayerStoreBackend::sqlite;
+    const char* const PLAYER_LOG_FILE = "gameMatch.players.log";
+    // the log is compacted when it is at least this big and at most half of it is live
+    const uint64_t PLAYER_LOG_COMPACT_MIN_BYTES = 64ull * 1024 * 1024;
+    // shard files are <prefix>.shard<n>.db; ids go to shards in stripes of PLAYER_SHARD_ID_STRIPE,
+    // so consecutive new players spread over every shard. the count can't change once shards hold rows
+    const char* const PLAYER_SHARD_FILE_PREFIX = "gameMatch.players";
+    const uint32_t PLAYER_SHARD_COUNT = 4;
+    const uint64_t PLAYER_SHARD_ID_STRIPE = 1024;
+
+    // true : only player ids are read at startup, rows are loaded on first login
+    // false: the whole player_battles table is loaded into PlayerManager at startup
+    const bool LAZY_PLAYER_LOADING = true;
+
+    // new player ids are reserved from db in blocks of this size (id_allocator table)
+    const uint64_t PLAYER_ID_BLOCK_SIZE = 10000;
+
+    // saveDirtyPlayers writes at most this many rows per transaction, DbManager's lock is released between chunks
+    const size_t SAVE_BATCH_MAX_ROWS = 10000;
+
+    // read-only connections serving player queries next to the writer connection (WAL profiles only)
+    const size_t READ_CONNECTION_COUNT = 4;
+
+    // binary snapshot of player_battles, loaded at startup instead of scanning the table (see player_snapshot)
+    const char* const PLAYER_SNAPSHOT_FILE = "gameMatch.snapshot";
+    const uint32_t PLAYER_SNAPSHOT_INTERVAL_SECONDS = 600;
+
+    // write-ahead journal of battle results, replayed at startup on top of the saved players (see BattleJournal)
+    const char* const BATTLE_JOURNAL_FILE = "gameMatch.journal";
+    // at a checkpoint the journal is rewritten without the saved records once it is this big
+    const uint64_t BATTLE_JOURNAL_REWRITE_BYTES = 4ull * 1024 * 1024;
+
+    // online backup of the game db (sqlite backup api), copied a few pages at a time on the 1 second scheduler tick.
+    // DbManager's lock is held for one step only, a tick stops stepping after BACKUP_TICK_BUDGET_MS
+    const char* const BACKUP_FILE = "gameMatch.backup.db";
+    const uint32_t BACKUP_INTERVAL_SECONDS = 3600;
+    const int BACKUP_STEP_PAGES = 64;
+    const uint32_t BACKUP_TICK_BUDGET_MS = 50;
+
+    // DbManager calls taking at least this long (lock wait included) go to the slow operation log ("dbstats"),
+    // which keeps the last DB_SLOW_LOG_SIZE of them. 0 turns the log off
+    const double DB_SLOW_OPERATION_MS = 100;
+    const size_t DB_SLOW_LOG_SIZE = 64;
+}
+
 #endif // GLOBAL_DEFINE_H
\ No newline at end of file
@@ -0,0 +1,477 @@
+// @file  : battleJournal.cpp
+// @brief : write-ahead battle result journal with group commit
+// @author: August
+// @date  : 2026-10-19
+#include "battleJournal.h"
+#include "../include/globalDefine.h"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // not 0, so a zero-filled tail never passes as a record
+    const uint32_t RECORD_TYPE_BATTLE = 0x4C544142;
+    const uint32_t RECORD_TYPE_CHECKPOINT = 0x54504B43;
+    const uint32_t FNV_OFFSET = 2166136261u;
+    const uint32_t FNV_PRIME = 16777619u;
+
+    uint32_t hashBytes(uint32_t hash, const unsigned char* pBytes, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ pBytes[i]) * FNV_PRIME;
+        }
+        return hash;
+    }
+
+    bool isFileExists(const std::string& path)
+    {
+        return std::ifstream(path, std::ios::binary).good();
+    }
+}
+
+BattleJournal::BattleJournal()
+{
+    static_assert(sizeof(RecordHeader) == 32, "journal record header must stay 32 bytes");
+}
+
+BattleJournal::~BattleJournal()
+{
+    close();
+}
+
+// reads the whole journal, returns the battles after the last checkpoint and starts the flusher
+bool BattleJournal::open(const std::string& fileName, std::vector<BattleRecord>& vecPendingRecords)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_isOpen)
+    {
+        return false;
+    }
+    m_fileName = fileName;
+    const std::string tempPath = fileName + ".tmp";
+    // a rewrite stopped between removing the journal and renaming its replacement
+    if (!isFileExists(fileName) && isFileExists(tempPath))
+    {
+        std::rename(tempPath.c_str(), fileName.c_str());
+    }
+    std::remove(tempPath.c_str());
+
+    std::string data;
+    {
+        std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+        if (file)
+        {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(&data[0], static_cast<std::streamsize>(data.size()));
+        }
+    }
+
+    m_stats = BattleJournalStats();
+    m_dequeRecords.clear();
+    m_pendingBuffer.clear();
+    vecPendingRecords.clear();
+    size_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= data.size())
+    {
+        RecordHeader header = {};
+        std::memcpy(&header, data.data() + offset, sizeof(header));
+        const size_t recordSize = sizeof(header) + static_cast<size_t>(header.resultCount) * sizeof(BattleResult);
+        if ((header.type != RECORD_TYPE_BATTLE && header.type != RECORD_TYPE_CHECKPOINT)
+            || header.resultCount > data.size() / sizeof(BattleResult) || offset + recordSize > data.size())
+        {
+            break;
+        }
+        const uint32_t checksum = header.checksum;
+        header.checksum = 0;
+        uint32_t hash = hashBytes(FNV_OFFSET, reinterpret_cast<const unsigned char*>(&header), sizeof(header));
+        hash = hashBytes(hash, reinterpret_cast<const unsigned char*>(data.data() + offset + sizeof(header)), recordSize - sizeof(header));
+        if (hash != checksum)
+        {
+            break;
+        }
+
+        m_stats.lastSeq = std::max(m_stats.lastSeq, header.seq);
+        if (header.type == RECORD_TYPE_CHECKPOINT)
+        {
+            m_stats.checkpointSeq = std::max(m_stats.checkpointSeq, header.seq);
+        }
+        else
+        {
+            BattleRecord record;
+            record.seq = header.seq;
+            record.roomId = header.roomId;
+            record.tier = header.tier;
+            record.vecResults.resize(header.resultCount);
+            std::memcpy(record.vecResults.data(), data.data() + offset + sizeof(header), recordSize - sizeof(header));
+            vecPendingRecords.emplace_back(std::move(record));
+            m_dequeRecords.emplace_back(header.seq, data.substr(offset, recordSize));
+        }
+        offset += recordSize;
+    }
+    const uint64_t checkpointSeq = m_stats.checkpointSeq;
+    vecPendingRecords.erase(std::remove_if(vecPendingRecords.begin(), vecPendingRecords.end(),
+        [checkpointSeq](const BattleRecord& record) { return record.seq <= checkpointSeq; }), vecPendingRecords.end());
+    while (!m_dequeRecords.empty() && m_dequeRecords.front().first <= checkpointSeq)
+    {
+        m_dequeRecords.pop_front();
+    }
+    m_stats.durableSeq = m_stats.lastSeq;
+    m_stats.fileBytes = offset;
+
+    if (offset < data.size())
+    {
+        std::cerr << "BattleJournal::open: Dropping " << (data.size() - offset) << " bytes of torn tail from '" << fileName << "'." << std::endl;
+        const std::string rewriteData = _makeRewriteDataNoLock();
+        bool isInTempFile = false;
+        if (!_replaceFile(rewriteData, isInTempFile))
+        {
+            // appends after the torn tail would be cut off with it on the next open
+            if (m_pFile)
+            {
+                std::fclose(m_pFile);
+                m_pFile = nullptr;
+            }
+            return false;
+        }
+        m_stats.fileBytes = rewriteData.size();
+        m_isRewriteDisabled = isInTempFile;
+    }
+    else
+    {
+        m_pFile = std::fopen(fileName.c_str(), "ab");
+        if (!m_pFile)
+        {
+            std::cerr << "BattleJournal::open: Can't open '" << fileName << "'." << std::endl;
+            return false;
+        }
+    }
+    m_isOpen = true;
+    m_isFailed = false;
+    m_isStopping = false;
+    m_flushThread = std::thread(&BattleJournal::_flushLoop, this);
+    return true;
+}
+
+// everything appended so far is synced before the file is closed
+void BattleJournal::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_isStopping = true;
+    }
+    m_flushCondition.notify_all();
+    if (m_flushThread.joinable())
+    {
+        m_flushThread.join();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (m_pFile)
+    {
+        std::fclose(m_pFile);
+        m_pFile = nullptr;
+    }
+    m_isOpen = false;
+    m_isStopping = false;
+    m_isRewriteRequested = false;
+    m_isRewriteDisabled = false;
+    m_pendingBuffer.clear();
+    m_dequeRecords.clear();
+    m_durableCondition.notify_all();
+    _runDurableCallbacks(lock);
+}
+
+uint64_t BattleJournal::append(uint64_t roomId, uint32_t tier, const std::vector<BattleResult>& vecResults)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_isOpen || m_isStopping || m_isFailed)
+    {
+        return 0;
+    }
+    const uint64_t seq = ++m_stats.lastSeq;
+    std::string record = _makeRecord(RECORD_TYPE_BATTLE, seq, roomId, tier, vecResults);
+    m_pendingBuffer += record;
+    m_dequeRecords.emplace_back(seq, std::move(record));
+    m_stats.records++;
+    m_flushCondition.notify_one();
+    return seq;
+}
+
+bool BattleJournal::waitDurable(uint64_t seq)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_durableCondition.wait(lock, [this, seq]() { return m_stats.durableSeq >= seq || m_isFailed || !m_isOpen; });
+    return m_stats.durableSeq >= seq;
+}
+
+void BattleJournal::notifyDurable(uint64_t seq, std::function<void(bool)> callback)
+{
+    bool isDurable = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        isDurable = (m_stats.durableSeq >= seq);
+        if (!isDurable && m_isOpen && !m_isFailed)
+        {
+            m_vecDurableCallbacks.emplace_back(seq, std::move(callback));
+            return;
+        }
+    }
+    callback(isDurable);
+}
+
+uint64_t BattleJournal::getLastSeq()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_stats.lastSeq;
+}
+
+// *** every result of the records up to seq must be committed to the player store ***
+void BattleJournal::checkpoint(uint64_t seq)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_isOpen || seq <= m_stats.checkpointSeq)
+    {
+        return;
+    }
+    m_stats.checkpointSeq = seq;
+    while (!m_dequeRecords.empty() && m_dequeRecords.front().first <= seq)
+    {
+        m_dequeRecords.pop_front();
+    }
+    m_pendingBuffer += _makeRecord(RECORD_TYPE_CHECKPOINT, seq, 0, 0, std::vector<BattleResult>());
+    if (m_stats.fileBytes >= db_constant::BATTLE_JOURNAL_REWRITE_BYTES && !m_isRewriteDisabled)
+    {
+        m_isRewriteRequested = true;
+    }
+    m_flushCondition.notify_one();
+}
+
+BattleJournalStats BattleJournal::getStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_stats;
+}
+
+std::string BattleJournal::_makeRecord(uint32_t type, uint64_t seq, uint64_t roomId, uint32_t tier, const std::vector<BattleResult>& vecResults)
+{
+    RecordHeader header = {};
+    header.type = type;
+    header.seq = seq;
+    header.roomId = roomId;
+    header.resultCount = static_cast<uint32_t>(vecResults.size());
+    header.tier = tier;
+
+    std::string record(sizeof(header) + vecResults.size() * sizeof(BattleResult), '\0');
+    if (!vecResults.empty())
+    {
+        std::memcpy(&record[sizeof(header)], vecResults.data(), vecResults.size() * sizeof(BattleResult));
+    }
+    uint32_t hash = hashBytes(FNV_OFFSET, reinterpret_cast<const unsigned char*>(&header), sizeof(header));
+    header.checksum = hashBytes(hash, reinterpret_cast<const unsigned char*>(record.data() + sizeof(header)), record.size() - sizeof(header));
+    std::memcpy(&record[0], &header, sizeof(header));
+    return record;
+}
+
+bool BattleJournal::_syncFile(FILE* pFile)
+{
+    if (std::fflush(pFile) != 0)
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(pFile)) == 0;
+#else
+    return fsync(fileno(pFile)) == 0;
+#endif
+}
+
+// checkpoint + the uncheckpointed records already on disk, the content of a rewritten journal.
+// records still in m_pendingBuffer are appended to the new file by the next flush
+std::string BattleJournal::_makeRewriteDataNoLock() const
+{
+    std::string data = _makeRecord(RECORD_TYPE_CHECKPOINT, m_stats.checkpointSeq, 0, 0, std::vector<BattleResult>());
+    for (const auto& itRecord : m_dequeRecords)
+    {
+        if (itRecord.first > m_stats.durableSeq)
+        {
+            break;
+        }
+        data += itRecord.second;
+    }
+    return data;
+}
+
+// writes data into a temp file that replaces the journal and reopens it for appends, false when the journal
+// was not replaced (m_pFile is the old journal again, nullptr when even that can't be opened).
+// *** swaps m_pFile: only the flusher, or open() before the flusher starts, may call it; m_mutex is not held ***
+bool BattleJournal::_replaceFile(const std::string& data, bool& isInTempFile)
+{
+    const std::string tempPath = m_fileName + ".tmp";
+    FILE* pTemp = std::fopen(tempPath.c_str(), "wb");
+    if (!pTemp)
+    {
+        std::cerr << "BattleJournal::rewrite: Can't create '" << tempPath << "'." << std::endl;
+        return false;
+    }
+    bool isOk = (std::fwrite(data.data(), 1, data.size(), pTemp) == data.size());
+    isOk = _syncFile(pTemp) && isOk;
+    std::fclose(pTemp);
+    if (!isOk)
+    {
+        std::cerr << "BattleJournal::rewrite: Failed to write '" << tempPath << "'." << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    if (m_pFile)
+    {
+        std::fclose(m_pFile);
+        m_pFile = nullptr;
+    }
+    // a posix rename replaces the journal atomically, the old one stays whole when it fails.
+    // windows can't rename over a file, the old journal goes first; open() finishes a rewrite stopped in between
+#ifdef _WIN32
+    std::remove(m_fileName.c_str());
+#endif
+    bool isReplaced = true;
+    std::string openPath = m_fileName;
+    if (std::rename(tempPath.c_str(), m_fileName.c_str()) != 0)
+    {
+        // appends go on in whichever file still holds the records
+        if (isFileExists(m_fileName))
+        {
+            std::remove(tempPath.c_str());
+            isReplaced = false;
+        }
+        else
+        {
+            openPath = tempPath;
+            isInTempFile = true;
+        }
+        std::cerr << "BattleJournal::rewrite: Failed to rename '" << tempPath << "', appending to '" << openPath << "'." << std::endl;
+    }
+    m_pFile = std::fopen(openPath.c_str(), "ab");
+    if (!m_pFile)
+    {
+        std::cerr << "BattleJournal::rewrite: Can't open '" << openPath << "', journaling stopped." << std::endl;
+        return false;
+    }
+    return isReplaced;
+}
+
+// group commit: one write + fsync for everything appended while the previous sync ran
+void BattleJournal::_flushLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_flushCondition.wait(lock, [this]() { return (!m_pendingBuffer.empty() && !m_isFailed) || m_isRewriteRequested || m_isStopping; });
+        if (!m_pendingBuffer.empty() && !m_isFailed)
+        {
+            std::string buffer;
+            buffer.swap(m_pendingBuffer);
+            const uint64_t batchSeq = m_stats.lastSeq;
+            lock.unlock();
+
+            const auto beginTime = std::chrono::steady_clock::now();
+            const bool isOk = (std::fwrite(buffer.data(), 1, buffer.size(), m_pFile) == buffer.size()) && _syncFile(m_pFile);
+            const double syncMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - beginTime).count();
+
+            lock.lock();
+            if (isOk)
+            {
+                m_stats.durableSeq = batchSeq;
+                m_stats.fileBytes += buffer.size();
+                m_stats.syncs++;
+                m_stats.lastSyncMs = syncMs;
+                m_stats.maxSyncMs = std::max(m_stats.maxSyncMs, syncMs);
+            }
+            else
+            {
+                // results stay in memory and reach the player store with the next save
+                std::cerr << "BattleJournal::flush: Failed to write '" << m_fileName << "', journaling stopped." << std::endl;
+                m_isFailed = true;
+            }
+            m_durableCondition.notify_all();
+        }
+        if (m_isRewriteRequested && !m_isFailed)
+        {
+            // the records are copied under the lock, written and synced outside of it (appends only fill
+            // m_pendingBuffer meanwhile, which is flushed into the new file next)
+            m_isRewriteRequested = false;
+            const std::string data = _makeRewriteDataNoLock();
+            lock.unlock();
+
+            bool isInTempFile = false;
+            const bool isReplaced = _replaceFile(data, isInTempFile);
+
+            lock.lock();
+            if (isReplaced)
+            {
+                m_stats.fileBytes = data.size();
+            }
+            m_isFailed = m_isFailed || (m_pFile == nullptr);
+            m_isRewriteDisabled = isInTempFile;
+        }
+        _runDurableCallbacks(lock);
+        if (m_isStopping && (m_pendingBuffer.empty() || m_isFailed))
+        {
+            break;
+        }
+    }
+}
+
+// runs the callbacks whose record is on disk, and every one left once the journal failed or is closed.
+// m_mutex is released while they run
+void BattleJournal::_runDurableCallbacks(std::unique_lock<std::mutex>& lock)
+{
+    if (m_vecDurableCallbacks.empty())
+    {
+        return;
+    }
+    const bool isFinal = m_isFailed || !m_isOpen;
+    std::vector<std::pair<uint64_t, std::function<void(bool)>>> vecWaiting;
+    vecWaiting.swap(m_vecDurableCallbacks);
+    std::vector<std::pair<uint64_t, std::function<void(bool)>>> vecReady;
+    for (auto& itCallback : vecWaiting)
+    {
+        if (itCallback.first <= m_stats.durableSeq || isFinal)
+        {
+            vecReady.emplace_back(std::move(itCallback));
+        }
+        else
+        {
+            m_vecDurableCallbacks.emplace_back(std::move(itCallback));
+        }
+    }
+    if (vecReady.empty())
+    {
+        return;
+    }
+    const uint64_t durableSeq = m_stats.durableSeq;
+    lock.unlock();
+    for (auto& itCallback : vecReady)
+    {
+        itCallback.second(itCallback.first <= durableSeq);
+    }
+    lock.lock();
+}
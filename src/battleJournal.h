@@ -0,0 +1,111 @@
+// battleJournal.h
+#ifndef BATTLE_JOURNAL_H
+#define BATTLE_JOURNAL_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+
+// one participant of a finished battle, stored as is in the journal
+struct BattleResult
+{
+    uint64_t playerId = 0;
+    uint64_t updatedTime = 0;   // the player's updatedTime after this result, 0 until it is applied
+    uint32_t scoreDelta = 0;
+    uint8_t team = 0;           // battle_constant::TeamColor
+    uint8_t isWin = 0;
+    uint16_t reserved = 0;
+};
+static_assert(sizeof(BattleResult) == 24, "BattleResult must stay 24 bytes");
+
+struct BattleRecord
+{
+    uint64_t seq = 0;
+    uint64_t roomId = 0;
+    uint32_t tier = 0;
+    std::vector<BattleResult> vecResults{};
+};
+
+struct BattleJournalStats
+{
+    uint64_t records = 0;           // appended since open
+    uint64_t syncs = 0;             // group commits (one write + fsync each)
+    uint64_t lastSeq = 0;
+    uint64_t durableSeq = 0;
+    uint64_t checkpointSeq = 0;
+    uint64_t fileBytes = 0;
+    double lastSyncMs = 0;
+    double maxSyncMs = 0;
+};
+
+// sequential write-ahead journal of battle results with group commit: appends only fill a buffer,
+// a flusher thread writes and fsyncs whatever has accumulated, so many rooms share one sync.
+// checkpoint(seq) marks every record up to seq as saved to the player store; on open the records
+// after the last checkpoint are returned for replay. the file is rewritten with the uncheckpointed
+// records once it grows past BATTLE_JOURNAL_REWRITE_BYTES. a torn tail is cut off on open
+class BattleJournal
+{
+public:
+    BattleJournal();
+    ~BattleJournal();
+
+    bool open(const std::string& fileName, std::vector<BattleRecord>& vecPendingRecords);
+    void close();
+
+    // returns the record's seq, 0 when the journal is not open
+    uint64_t append(uint64_t roomId, uint32_t tier, const std::vector<BattleResult>& vecResults);
+    // blocks until the record is on disk, false when the journal failed or was closed first
+    bool waitDurable(uint64_t seq);
+    // callback(isDurable) once the record is on disk, false when the journal failed or was closed first.
+    // runs on the flusher thread (on the caller's when that is already known), must not call into the journal
+    void notifyDurable(uint64_t seq, std::function<void(bool)> callback);
+    uint64_t getLastSeq();
+    void checkpoint(uint64_t seq);
+    BattleJournalStats getStats();
+
+private:
+    struct RecordHeader
+    {
+        uint32_t type;
+        uint32_t checksum;      // fnv-1a of header (checksum = 0) and results
+        uint64_t seq;           // record seq, or the checkpointed seq of a checkpoint record
+        uint64_t roomId;
+        uint32_t resultCount;
+        uint32_t tier;
+    };
+
+    static std::string _makeRecord(uint32_t type, uint64_t seq, uint64_t roomId, uint32_t tier, const std::vector<BattleResult>& vecResults);
+    static bool _syncFile(FILE* pFile);
+    std::string _makeRewriteDataNoLock() const;
+    bool _replaceFile(const std::string& data, bool& isInTempFile);
+    void _flushLoop();
+    void _runDurableCallbacks(std::unique_lock<std::mutex>& lock);
+
+    std::string m_fileName;
+    // guards everything below except m_pFile, which only the flusher touches after open
+    std::mutex m_mutex;
+    std::condition_variable m_flushCondition;
+    std::condition_variable m_durableCondition;
+    FILE* m_pFile = nullptr;
+    std::thread m_flushThread;
+    bool m_isOpen = false;
+    bool m_isFailed = false;
+    bool m_isStopping = false;
+    bool m_isRewriteRequested = false;
+    bool m_isRewriteDisabled = false;   // appending to the temp file of a rewrite whose rename failed
+
+    std::string m_pendingBuffer{};
+    // records after the checkpoint (seq, bytes), written again by a rewrite
+    std::deque<std::pair<uint64_t, std::string>> m_dequeRecords{};
+    // notifyDurable callbacks (seq, callback) whose record is not on disk yet
+    std::vector<std::pair<uint64_t, std::function<void(bool)>>> m_vecDurableCallbacks{};
+    BattleJournalStats m_stats{};
+};
+
+#endif // BATTLE_JOURNAL_H
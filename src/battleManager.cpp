@@ -4,6 +4,7 @@
 // @date  : 2025-05-15
 #include "battleManager.h"
 #include "playerManager.h"
+#include "dbManager.h"
 #include "../include/globalDefine.h"
 #include "../utils/utils.h"
 #include <iostream>
@@ -12,14 +13,14 @@
 #include <thread>
 #include <chrono>
 
-BattleRoom::BattleRoom(const std::vector<Player*>& refVecTeamRed, const std::vector<Player*>& refVecTeamBlue)
-    : m_roomId(BattleManager::instance().getNextRoomId()) // bcyó]m roomId
+BattleRoom::BattleRoom(uint32_t tier, const std::vector<Player*>& refVecTeamRed, const std::vector<Player*>& refVecTeamBlue)
+    : m_tier(tier), m_roomId(BattleManager::instance().getNextRoomId()) // bcyó]m roomId
 {
     for (Player* pPlayer : refVecTeamRed)
     {
         if (pPlayer)
         {
-            pPlayer->setStatus(common::PlayerStatus::battle);
+            PlayerManager::instance().setPlayerStatus(pPlayer, common::PlayerStatus::battle);
             m_vecTeamRed.emplace_back(std::make_unique<Hero>(pPlayer->getId()));
         }
     }
@@ -28,7 +29,7 @@ BattleRoom::BattleRoom(const std::vector<Player*>& refVecTeamRed, const std::vec
     {
         if (pPlayer)
         {
-            pPlayer->setStatus(common::PlayerStatus::battle);
+            PlayerManager::instance().setPlayerStatus(pPlayer, common::PlayerStatus::battle);
             m_vecTeamBlue.emplace_back(std::make_unique<Hero>(pPlayer->getId()));
         }
     }
@@ -76,19 +77,29 @@ void BattleRoom::startBattle()
 
     std::cout << "\n" << (isRedWin ? "Red" : "Blue") << " Team wins in Room " << m_roomId << "!!!" << std::endl;
 
+    std::vector<BattleResult> vecResults;
     for (auto& pHero : vecWinningTeam)
     {
         if (!pHero) continue;
-        const uint64_t playerId = pHero->getPlayerId();
-        BattleManager::instance().PlayerWin(playerId);
+        BattleResult result;
+        result.playerId = pHero->getPlayerId();
+        result.scoreDelta = battle_constant::WINNER_SCORE;
+        result.team = isRedWin ? battle_constant::TeamColor::Red : battle_constant::TeamColor::Blue;
+        result.isWin = 1;
+        vecResults.emplace_back(result);
     }
 
     for (auto& pHero : vecLosingTeam)
     {
         if (!pHero) continue;
-        const uint64_t playerId = pHero->getPlayerId();
-        BattleManager::instance().PlayerLose(playerId);
+        BattleResult result;
+        result.playerId = pHero->getPlayerId();
+        result.scoreDelta = battle_constant::LOSER_SCORE;
+        result.team = isRedWin ? battle_constant::TeamColor::Blue : battle_constant::TeamColor::Red;
+        result.isWin = 0;
+        vecResults.emplace_back(result);
     }
+    BattleManager::instance().applyBattleResults(m_roomId, m_tier, vecResults);
     std::cout << "----- BATTLE ENDS (Room " << m_roomId << ") -----\n" << std::endl;
 
     // ԰Aq BattleManager өж
@@ -247,6 +258,8 @@ bool BattleManager::initialize()
 void BattleManager::release()
 {
     stopMatchmaking();
+    // written before PlayerManager::release waits for the db writer
+    flushMatchHistory();
 
     std::unique_lock<std::mutex> lockBattleRooms(m_battleRoomsMutex, std::defer_lock);
     std::unique_lock<std::mutex> lockTeamQueue(m_teamMatchQueue.mutex, std::defer_lock);
@@ -296,20 +309,96 @@ void BattleManager::addPlayerToQueue(Player* pPlayer)
             return;
         }
         m_teamMatchQueue.addMember(pPlayer);
-        pPlayer->setStatus(common::PlayerStatus::queue);
+        PlayerManager::instance().setPlayerStatus(pPlayer, common::PlayerStatus::queue);
     }
 }
 
-void BattleManager::PlayerWin(uint64_t playerId)
+// the whole room in one journal record, returns without waiting for its sync: a record that doesn't
+// reach the disk is reported by the journal's flusher. the match is queued for match_history right away,
+// also when the journal failed, the results were applied anyway
+void BattleManager::applyBattleResults(uint64_t roomId, uint32_t tier, std::vector<BattleResult>& vecResults)
 {
-    std::cout << "Player " << playerId << " WIN!!! (+ " << battle_constant::WINNER_SCORE << " points)" << std::endl;
-    PlayerManager::instance().handlePlayerBattleResult(playerId, battle_constant::WINNER_SCORE, true);
+    for (const BattleResult& result : vecResults)
+    {
+        if (result.isWin)
+        {
+            std::cout << "Player " << result.playerId << " WIN!!! (+ " << result.scoreDelta << " points)" << std::endl;
+        }
+        else
+        {
+            std::cout << "Player " << result.playerId << " LOSE... (" << result.scoreDelta << " points)" << std::endl;
+        }
+    }
+    const uint64_t seq = PlayerManager::instance().applyBattleResults(roomId, tier, vecResults);
+    if (vecResults.empty())
+    {
+        return;
+    }
+    PlayerManager::instance().notifyBattleResultsDurable(seq, [roomId](bool isDurable)
+        {
+            if (!isDurable)
+            {
+                std::cerr << "Battle Room " << roomId << ": results were not journaled." << std::endl;
+            }
+        });
+    enqueueMatch(makeMatchRecord(roomId, tier, vecResults, false));
 }
 
-void BattleManager::PlayerLose(uint64_t playerId)
+// battleTime is the latest updatedTime of the applied results, so a replayed match is recognized in match_history
+MatchRecord BattleManager::makeMatchRecord(uint64_t roomId, uint32_t tier, const std::vector<BattleResult>& vecResults, bool isReplayed)
 {
-    std::cout << "Player " << playerId << " LOSE... (" << battle_constant::LOSER_SCORE << " points)" << std::endl;
-    PlayerManager::instance().handlePlayerBattleResult(playerId, battle_constant::LOSER_SCORE, false);
+    MatchRecord match;
+    match.roomId = roomId;
+    match.isReplayed = isReplayed;
+    match.tier = tier;
+    for (const BattleResult& result : vecResults)
+    {
+        match.battleTime = std::max(match.battleTime, result.updatedTime);
+        if (result.team < battle_constant::TeamColor::Max)
+        {
+            match.vecRosters[result.team].emplace_back(result.playerId);
+            if (result.isWin)
+            {
+                match.winnerTeam = result.team;
+            }
+        }
+    }
+    return match;
+}
+
+// only a vector append, match_history is written by flushMatchHistory
+void BattleManager::enqueueMatch(MatchRecord match)
+{
+    std::lock_guard<std::mutex> lock(m_pendingMatchesMutex);
+
+    m_vecPendingMatches.emplace_back(std::move(match));
+}
+
+// every queued match in one request to the db writer (multi-row inserts), failed ones are queued again
+void BattleManager::flushMatchHistory()
+{
+    std::vector<MatchRecord> vecMatches;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMatchesMutex);
+
+        vecMatches.swap(m_vecPendingMatches);
+    }
+    if (vecMatches.empty())
+    {
+        return;
+    }
+    std::shared_ptr<std::vector<MatchRecord>> pMatches = std::make_shared<std::vector<MatchRecord>>(std::move(vecMatches));
+    DbManager::instance().submitWrite(
+        [pMatches]() { return DbManager::instance().insertMatchHistory(*pMatches); },
+        [this, pMatches](bool isOk)
+        {
+            if (!isOk)
+            {
+                std::lock_guard<std::mutex> lock(m_pendingMatchesMutex);
+
+                m_vecPendingMatches.insert(m_vecPendingMatches.end(), pMatches->begin(), pMatches->end());
+            }
+        });
 }
 
 // U@Ӧ۰ʼWж ID
@@ -403,7 +492,7 @@ void BattleManager::matchmakingThread()
                     //    m_nextRoomId wg std::atomic O@C
                     {
                         std::lock_guard<std::mutex> lock(m_battleRoomsMutex); // w m_battleRooms
-                        room_ptr = std::make_unique<BattleRoom>(battleTeams[battle_constant::TeamColor::Red], battleTeams[battle_constant::TeamColor::Blue]);
+                        room_ptr = std::make_unique<BattleRoom>(tier, battleTeams[battle_constant::TeamColor::Red], battleTeams[battle_constant::TeamColor::Blue]);
                         roomIdForThread = room_ptr->getRoomId(); // ж ID (b BattleRoom cyƤwlͦ)
                         m_battleRooms[roomIdForThread] = std::move(room_ptr); // N unique_ptr ʨ map 
                     } // bB
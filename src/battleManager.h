@@ -3,6 +3,8 @@
 #define BATTLE_MANAGER_H
 #include "objects/player.h"
 #include "objects/hero.h"
+#include "battleJournal.h"
+#include "objects/matchRecord.h"
 #include <vector>
 #include <map>
 #include <mutex>
@@ -12,7 +14,7 @@
 class BattleRoom
 {
 public:
-    BattleRoom(const std::vector<Player*>& refVecTeamRed, const std::vector<Player*>& refVecTeamBlue);
+    BattleRoom(uint32_t tier, const std::vector<Player*>& refVecTeamRed, const std::vector<Player*>& refVecTeamBlue);
     ~BattleRoom();
     void startBattle();
     void finishBattle(); // finishBattle ̵MsbAΩMz
@@ -20,6 +22,7 @@ public:
     uint64_t getRoomId() const { return m_roomId; } // S roomId
 
 private:
+    uint32_t m_tier = 0;
     uint64_t m_roomId; // sW roomId
     std::vector<std::unique_ptr<Hero>> m_vecTeamRed;
     std::vector<std::unique_ptr<Hero>> m_vecTeamBlue;
@@ -81,8 +84,10 @@ public:
 
     void addPlayerToQueue(Player* pPlayer);
 
-    void PlayerWin(uint64_t playerId);
-    void PlayerLose(uint64_t playerId);
+    void applyBattleResults(uint64_t roomId, uint32_t tier, std::vector<BattleResult>& vecResults);
+    static MatchRecord makeMatchRecord(uint64_t roomId, uint32_t tier, const std::vector<BattleResult>& vecResults, bool isReplayed);
+    void enqueueMatch(MatchRecord match);
+    void flushMatchHistory();
 
     // U@Ӧ۰ʼWж ID
     uint64_t getNextRoomId();
@@ -116,6 +121,10 @@ private:
     std::mutex m_playerAddQueueMutex; // sW@ӤӫO@aJ޿
 
     std::mutex m_battleRoomsMutex;
+
+    // finished matches waiting for the next match_history flush
+    std::vector<MatchRecord> m_vecPendingMatches{};
+    std::mutex m_pendingMatchesMutex;
 };
 
 #endif // BATTLE_MANAGER_H
\ No newline at end of file
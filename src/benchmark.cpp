@@ -0,0 +1,1046 @@
+// @file  : benchmark.cpp
+// @brief : console benchmarks (login storm, player record layout, statement cache, storage profiles, player stores, battle journal, match history, player query)
+// @author: August
+// @date  : 2026-10-19
+#include "benchmark.h"
+#include "playerManager.h"
+#include "dbManager.h"
+#include "logPlayerStore.h"
+#include "shardedPlayerStore.h"
+#include "battleJournal.h"
+#include "battleManager.h"
+#include "objects/player.h"
+#include "objects/playerRecord.h"
+#include "../utils/utils.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    // the current layout needs ~10x the memory of the packed one, it is measured on at most this many players
+    const uint64_t MAP_LAYOUT_MAX_PLAYERS = 10000000;
+    const uint64_t LOOKUP_COUNT = 10000000;
+    // single-row commits pay a full fsync under the durable profile, keep that part short
+    const uint32_t STORAGE_COMMIT_COUNT = 200;
+    const uint32_t STORAGE_QUERY_COUNT = 20000;
+    const char* const BENCH_PLAYER_LOG_FILE = "gameMatch.players.bench.log";
+    const char* const BENCH_PLAYER_SHARD_PREFIX = "gameMatch.players.bench";
+    const uint64_t BENCH_RESERVE_COUNT = 16;
+    const char* const BENCH_BATTLE_JOURNAL_FILE = "gameMatch.journal.bench";
+    // the temp game of --bench and --test-stores: its own game db and the store DbManager opens on it
+    const char* const TEMP_DB_FILE = "gameMatch.temp.db";
+    const char* const TEMP_GAME_STORE_FILE = "gameMatch.players.temp";
+    // one store of every backend in the standalone store tests
+    const char* const TEST_PLAYER_LOG_FILE = "gameMatch.players.test.log";
+    const char* const TEST_PLAYER_SHARD_PREFIX = "gameMatch.players.test.store";
+    const uint64_t STORE_TEST_PLAYERS = 10000;
+    // battle rooms finishing at the same time in the group commit pass
+    const uint32_t JOURNAL_BENCH_ROOMS = 64;
+    // match and player ids of the history benchmark, far above real ones
+    const uint64_t HISTORY_BENCH_FIRST_ID = 1ull << 62;
+    const uint64_t HISTORY_BENCH_PLAYERS = 10000;
+    const uint32_t HISTORY_BENCH_QUERY_COUNT = 2000;
+    const uint32_t HISTORY_BENCH_QUERY_MATCHES = 20;
+    // login / logout rounds of the save avoidance benchmark: every BATTLE_EVERY-th player plays a battle
+    // in a round, every RECONNECT_EVERY-th one drops and logs in again before logging out
+    const uint32_t SAVE_BENCH_ROUNDS = 5;
+    const uint32_t SAVE_BENCH_BATTLE_EVERY = 5;
+    const uint32_t SAVE_BENCH_RECONNECT_EVERY = 10;
+
+    // value at percent (0-100) of sorted samples
+    double getPercentile(const std::vector<double>& vecSortedSamples, double percent)
+    {
+        if (vecSortedSamples.empty())
+        {
+            return 0;
+        }
+        const size_t index = static_cast<size_t>(percent / 100.0 * (vecSortedSamples.size() - 1));
+        return vecSortedSamples[index];
+    }
+
+    double getElapsedMs(std::chrono::steady_clock::time_point beginTime)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - beginTime).count();
+    }
+
+    // next id of a dependent lookup chain: each lookup waits for the previous one, so the time is latency
+    uint64_t nextLookupId(uint64_t id, uint32_t score, uint64_t counts)
+    {
+        id ^= id << 13;
+        id ^= id >> 7;
+        id ^= id << 17;
+        return ((id + score) % counts) + 1;
+    }
+
+    PlayerSnapshot makeSyntheticPlayer(uint64_t id, uint64_t nowMs)
+    {
+        PlayerSnapshot snapshot;
+        snapshot.id = id;
+        snapshot.score = static_cast<uint32_t>((id * 7919) % 3000);
+        snapshot.wins = static_cast<uint32_t>(id % 500);
+        snapshot.updatedTime = nowMs - (id % 86400000);
+        snapshot.status = common::PlayerStatus::offline;
+        return snapshot;
+    }
+
+    // counts synthetic rows on a block of unused ids, written to the game's player store
+    bool writeSyntheticPlayers(uint32_t counts, std::vector<PlayerSnapshot>& vecSnapshots)
+    {
+        uint64_t firstId = 0;
+        DbManager::instance().waitForWrites();
+        if (!DbManager::instance().reservePlayerIdBlock(counts, firstId))
+        {
+            return false;
+        }
+        const uint64_t nowMs = time_utils::getTimestampMS();
+        vecSnapshots.clear();
+        vecSnapshots.reserve(counts);
+        for (uint32_t i = 0; i < counts; i++)
+        {
+            vecSnapshots.emplace_back(makeSyntheticPlayer(firstId + i, nowMs));
+        }
+        return DbManager::instance().updatePlayerBattlesBatch(vecSnapshots) == vecSnapshots.size();
+    }
+
+    void removeDbFile(const std::string& fileName)
+    {
+        std::remove(fileName.c_str());
+        std::remove((fileName + "-wal").c_str());
+        std::remove((fileName + "-shm").c_str());
+        std::remove((fileName + "-journal").c_str());
+    }
+
+    void removeShardFiles(const std::string& filePrefix)
+    {
+        for (uint32_t shard = 0; shard < db_constant::PLAYER_SHARD_COUNT; shard++)
+        {
+            removeDbFile(ShardedPlayerStore::getShardFileName(filePrefix, shard));
+        }
+    }
+
+    void removeTempGameFiles()
+    {
+        removeDbFile(TEMP_DB_FILE);
+        std::remove(TEMP_GAME_STORE_FILE);
+        removeShardFiles(TEMP_GAME_STORE_FILE);
+    }
+
+    void removeStoreTestFiles()
+    {
+        std::remove(TEST_PLAYER_LOG_FILE);
+        removeShardFiles(TEST_PLAYER_SHARD_PREFIX);
+    }
+
+    // the checks every player store has to pass, on the rows [firstId, firstId + count) it was given.
+    // returns the first failed check or an empty string
+    std::string checkPlayerStore(IPlayerStore& store, const std::vector<PlayerSnapshot>& vecWritten, uint64_t overwriteTime)
+    {
+        const uint64_t firstId = vecWritten.front().id;
+        const uint64_t lastId = vecWritten.back().id;
+        const auto isSame = [](const PlayerSnapshot& lhs, const PlayerSnapshot& rhs)
+        {
+            return lhs.id == rhs.id && lhs.score == rhs.score && lhs.wins == rhs.wins && lhs.updatedTime == rhs.updatedTime;
+        };
+
+        // load-one / load-batch read back what was written, missing ids are not found
+        std::vector<uint64_t> vecIds;
+        for (const PlayerSnapshot& written : vecWritten)
+        {
+            vecIds.emplace_back(written.id);
+        }
+        vecIds.emplace_back(lastId + 1);
+        size_t index = 0;
+        bool isMatched = true;
+        const size_t loadedCount = store.loadPlayers(vecIds, [&](const PlayerSnapshot& snapshot)
+            {
+                isMatched = isMatched && index < vecWritten.size() && isSame(snapshot, vecWritten[index]);
+                index++;
+            });
+        PlayerSnapshot snapshot;
+        if (loadedCount != vecWritten.size() || !isMatched)
+        {
+            return "loadPlayers doesn't return the written rows";
+        }
+        if (!store.loadPlayer(firstId, snapshot) || !isSame(snapshot, vecWritten.front()))
+        {
+            return "loadPlayer doesn't return the written row";
+        }
+        if (store.loadPlayer(lastId + 1, snapshot))
+        {
+            return "loadPlayer finds a missing player";
+        }
+
+        // batch upsert overwrites: every other row gets new values and a later updated time
+        std::vector<PlayerSnapshot> vecOverwritten;
+        for (size_t i = 0; i < vecWritten.size(); i += 2)
+        {
+            PlayerSnapshot overwritten = vecWritten[i];
+            overwritten.score += 1;
+            overwritten.wins += 1;
+            overwritten.updatedTime = overwriteTime;
+            vecOverwritten.emplace_back(overwritten);
+        }
+        if (store.savePlayers(vecOverwritten) != vecOverwritten.size())
+        {
+            return "savePlayers fails to overwrite";
+        }
+        if (!store.loadPlayer(vecOverwritten.back().id, snapshot) || !isSame(snapshot, vecOverwritten.back()))
+        {
+            return "loadPlayer returns a stale row";
+        }
+
+        // load-all sees every player once with its newest values, the filter only the overwritten ones
+        std::vector<uint8_t> vecSeen(vecWritten.size(), 0);
+        isMatched = store.forEachPlayer(0, [&](const PlayerSnapshot& row)
+            {
+                if (row.id < firstId || row.id > lastId)
+                {
+                    return;
+                }
+                const size_t offset = static_cast<size_t>(row.id - firstId);
+                const PlayerSnapshot& expected = (offset % 2 == 0) ? vecOverwritten[offset / 2] : vecWritten[offset];
+                vecSeen[offset] += isSame(row, expected) ? 1 : 2;
+            });
+        if (!isMatched || std::any_of(vecSeen.begin(), vecSeen.end(), [](uint8_t seen) { return seen != 1; }))
+        {
+            return "forEachPlayer doesn't return every player once with its newest row";
+        }
+        size_t filteredCount = 0;
+        isMatched = store.forEachPlayer(overwriteTime, [&](const PlayerSnapshot& row)
+            {
+                if (row.id >= firstId && row.id <= lastId)
+                {
+                    filteredCount += (row.updatedTime >= overwriteTime) ? 1 : vecWritten.size();
+                }
+            });
+        if (!isMatched || filteredCount != vecOverwritten.size())
+        {
+            return "forEachPlayer(minUpdatedTime) returns the wrong players";
+        }
+
+        // reserved blocks never overlap and lie above every stored id
+        uint64_t firstBlockId = 0;
+        uint64_t secondBlockId = 0;
+        if (!store.reservePlayerIds(BENCH_RESERVE_COUNT, firstBlockId) || !store.reservePlayerIds(BENCH_RESERVE_COUNT, secondBlockId)
+            || firstBlockId <= lastId || secondBlockId < firstBlockId + BENCH_RESERVE_COUNT)
+        {
+            return "reservePlayerIds hands out overlapping or used ids";
+        }
+
+        // everything survives a reopen
+        store.close();
+        if (!store.open() || !store.loadPlayer(vecOverwritten.front().id, snapshot) || !isSame(snapshot, vecOverwritten.front())
+            || !store.loadPlayer(lastId, snapshot))
+        {
+            return "rows are lost on reopen";
+        }
+        uint64_t reopenedBlockId = 0;
+        if (!store.reservePlayerIds(BENCH_RESERVE_COUNT, reopenedBlockId) || reopenedBlockId < secondBlockId + BENCH_RESERVE_COUNT)
+        {
+            return "reserved ids are handed out again after reopen";
+        }
+
+        // a compacted log replaces the old one on disk: every row is read back from it after a reopen
+        LogPlayerStore* pLogStore = dynamic_cast<LogPlayerStore*>(&store);
+        if (pLogStore)
+        {
+            if (!pLogStore->compact())
+            {
+                return "compact fails";
+            }
+            store.close();
+            size_t liveCount = 0;
+            isMatched = store.open() && store.forEachPlayer(0, [&](const PlayerSnapshot& row)
+                {
+                    liveCount += (row.id >= firstId && row.id <= lastId) ? 1 : 0;
+                });
+            if (!isMatched || liveCount != vecWritten.size() || !store.loadPlayer(vecOverwritten.front().id, snapshot)
+                || !isSame(snapshot, vecOverwritten.front()))
+            {
+                return "rows are lost on reopen after a compaction";
+            }
+        }
+        return std::string();
+    }
+
+    void printLayoutResult(const char* name, uint64_t counts, double bytesPerPlayer, double lookupNs, double scanMs)
+    {
+        std::cout << "  " << std::left << std::setw(10) << name
+            << std::setw(12) << counts
+            << std::setw(14) << bytesPerPlayer
+            << std::setw(14) << lookupNs
+            << std::setw(14) << (scanMs > 0 ? counts / scanMs / 1000.0 : 0)
+            << std::setw(12) << (scanMs > 0 ? counts * bytesPerPlayer / scanMs / 1000000.0 : 0)
+            << (bytesPerPlayer * 100000000.0 / (1024.0 * 1024.0 * 1024.0)) << "\n";
+    }
+}
+
+// login storm: the same number of players through playerLogin one by one, then through playerLoginBatch.
+// existing players are evicted first so both paths load them from db.
+// creates 2 * counts new players, runs only on the temp game (--bench login)
+void benchmark::runLogin(uint32_t counts)
+{
+    auto logoutAll = [](const std::vector<uint64_t>& vecIds)
+    {
+        for (const uint64_t id : vecIds)
+        {
+            PlayerManager::instance().playerLogout(id);
+        }
+    };
+    // flush and drop every offline player, so the next logins have to load them from db
+    auto evictOfflinePlayers = []()
+    {
+        const uint64_t residentLimit = PlayerManager::instance().getPlayerCacheStats().residentLimit;
+        PlayerManager::instance().saveDirtyPlayers();
+        DbManager::instance().waitForWrites();
+        PlayerManager::instance().setResidentPlayerLimit(0);
+        PlayerManager::instance().evictOfflinePlayers();
+        PlayerManager::instance().setResidentPlayerLimit(residentLimit);
+    };
+
+    // new players
+    std::vector<uint64_t> vecSingleIds;
+    auto beginTime = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < counts; i++)
+    {
+        Player* pPlayer = PlayerManager::instance().playerLogin(0);
+        if (pPlayer)
+        {
+            vecSingleIds.emplace_back(pPlayer->getId());
+        }
+    }
+    const double newSingleMs = getElapsedMs(beginTime);
+
+    std::vector<uint64_t> vecBatchIds;
+    beginTime = std::chrono::steady_clock::now();
+    const std::vector<Player*> vecNewPlayers = PlayerManager::instance().playerLoginBatch(std::vector<uint64_t>(counts, 0));
+    const double newBatchMs = getElapsedMs(beginTime);
+    for (Player* pPlayer : vecNewPlayers)
+    {
+        if (pPlayer)
+        {
+            vecBatchIds.emplace_back(pPlayer->getId());
+        }
+    }
+
+    // existing players (the ones just created, logged out and evicted again)
+    logoutAll(vecSingleIds);
+    evictOfflinePlayers();
+    beginTime = std::chrono::steady_clock::now();
+    for (const uint64_t id : vecSingleIds)
+    {
+        PlayerManager::instance().playerLogin(id);
+    }
+    const double existingSingleMs = getElapsedMs(beginTime);
+    logoutAll(vecSingleIds);
+    evictOfflinePlayers();
+
+    beginTime = std::chrono::steady_clock::now();
+    PlayerManager::instance().playerLoginBatch(vecSingleIds);
+    const double existingBatchMs = getElapsedMs(beginTime);
+    logoutAll(vecSingleIds);
+    logoutAll(vecBatchIds);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "bench login (" << counts << " players)\n";
+    std::cout << "  new      : one by one " << newSingleMs << " ms, batch " << newBatchMs << " ms"
+        << " (x" << (newBatchMs > 0 ? newSingleMs / newBatchMs : 0) << ")\n";
+    std::cout << "  existing : one by one " << existingSingleMs << " ms, batch " << existingBatchMs << " ms"
+        << " (x" << (existingBatchMs > 0 ? existingSingleMs / existingBatchMs : 0) << ")\n";
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// a login / logout heavy session: rounds in which every player logs in, a few play a battle, some reconnect,
+// then all log out and the dirty players are flushed. reports how many save requests became row writes
+// and how many were coalesced or skipped as unchanged, against the one write per drained player before.
+// creates counts new players, runs only on the temp game (--bench logout)
+void benchmark::runSaveAvoidance(uint32_t counts)
+{
+    std::vector<uint64_t> vecIds;
+    for (Player* pPlayer : PlayerManager::instance().playerLoginBatch(std::vector<uint64_t>(counts, 0)))
+    {
+        if (pPlayer)
+        {
+            vecIds.emplace_back(pPlayer->getId());
+        }
+    }
+    if (vecIds.empty())
+    {
+        return;
+    }
+    for (const uint64_t id : vecIds)
+    {
+        PlayerManager::instance().playerLogout(id);
+    }
+    PlayerManager::instance().saveDirtyPlayers();
+    DbManager::instance().waitForWrites();
+
+    const PlayerSaveStats beginStats = PlayerManager::instance().getPlayerSaveStats();
+    uint64_t battleCount = 0;
+    const auto beginTime = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < SAVE_BENCH_ROUNDS; round++)
+    {
+        PlayerManager::instance().playerLoginBatch(vecIds);
+        std::vector<BattleResult> vecResults;
+        for (size_t i = round % SAVE_BENCH_BATTLE_EVERY; i < vecIds.size(); i += SAVE_BENCH_BATTLE_EVERY)
+        {
+            BattleResult result;
+            result.playerId = vecIds[i];
+            result.scoreDelta = 10;
+            result.isWin = (i & 1) ? 1 : 0;
+            vecResults.emplace_back(result);
+        }
+        battleCount += vecResults.size();
+        PlayerManager::instance().applyBattleResults(0, 0, vecResults);
+        for (size_t i = 0; i < vecIds.size(); i += SAVE_BENCH_RECONNECT_EVERY)
+        {
+            PlayerManager::instance().playerLogout(vecIds[i]);
+            PlayerManager::instance().playerLogin(vecIds[i]);
+        }
+        for (const uint64_t id : vecIds)
+        {
+            PlayerManager::instance().playerLogout(id);
+        }
+        PlayerManager::instance().saveDirtyPlayers();
+    }
+    DbManager::instance().waitForWrites();
+    const double elapsedMs = getElapsedMs(beginTime);
+    const PlayerSaveStats endStats = PlayerManager::instance().getPlayerSaveStats();
+
+    const uint64_t requests = endStats.requests - beginStats.requests;
+    const uint64_t coalesced = endStats.coalescedRequests - beginStats.coalescedRequests;
+    const uint64_t skipped = endStats.skippedRows - beginStats.skippedRows;
+    const uint64_t written = endStats.savedRows + endStats.failedRows - beginStats.savedRows - beginStats.failedRows;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "bench logout (" << vecIds.size() << " players, " << SAVE_BENCH_ROUNDS << " rounds, " << battleCount << " battle results)\n";
+    std::cout << "  save requests   : " << requests << "\n";
+    std::cout << "  coalesced       : " << coalesced << "\n";
+    std::cout << "  skipped (clean) : " << skipped << "\n";
+    std::cout << "  rows written    : " << written << " (" << (requests > 0 ? written * 100.0 / requests : 0) << "% of requests, "
+        << (requests > 0 ? (coalesced + skipped) * 100.0 / requests : 0) << "% avoided)\n";
+    std::cout << "  without versions: " << (requests - coalesced) << " rows (x"
+        << (written > 0 ? static_cast<double>(requests - coalesced) / written : 0) << " of now), " << elapsedMs << " ms\n";
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// packed PlayerRecord table (indexed by id) against the current unordered_map<id, unique_ptr<Player>>.
+// reports bytes per player, dependent random lookup latency, full scan rate and the 100M players footprint
+void benchmark::runLayout(uint64_t counts)
+{
+    if (counts == 0)
+    {
+        return;
+    }
+    const uint64_t nowMs = time_utils::getTimestampMS();
+    uint64_t checksum = 0;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "bench layout (" << counts << " players)\n";
+    std::cout << "  " << std::left << std::setw(10) << "layout"
+        << std::setw(12) << "players"
+        << std::setw(14) << "bytes/player"
+        << std::setw(14) << "lookup ns"
+        << std::setw(14) << "scan M/s"
+        << std::setw(12) << "scan GB/s"
+        << "100M GB\n";
+
+    {
+        auto beginTime = std::chrono::steady_clock::now();
+        std::vector<PlayerRecord> vecRecords(counts + 1);
+        for (uint64_t id = 1; id <= counts; id++)
+        {
+            vecRecords[id] = PlayerRecord::pack(makeSyntheticPlayer(id, nowMs), false, false);
+        }
+        const double populateMs = getElapsedMs(beginTime);
+
+        beginTime = std::chrono::steady_clock::now();
+        uint64_t id = 1;
+        for (uint64_t i = 0; i < LOOKUP_COUNT; i++)
+        {
+            id = nextLookupId(id, vecRecords[id].score, counts);
+        }
+        const double lookupNs = getElapsedMs(beginTime) * 1000000.0 / LOOKUP_COUNT;
+        checksum += id;
+
+        beginTime = std::chrono::steady_clock::now();
+        for (const PlayerRecord& record : vecRecords)
+        {
+            checksum += record.score + record.wins;
+        }
+        const double scanMs = getElapsedMs(beginTime);
+        printLayoutResult("packed", counts, static_cast<double>(sizeof(PlayerRecord)), lookupNs, scanMs);
+        std::cout << "    (populated in " << populateMs << " ms)\n";
+    }
+
+    {
+        const uint64_t mapCounts = std::min(counts, MAP_LAYOUT_MAX_PLAYERS);
+        auto beginTime = std::chrono::steady_clock::now();
+        std::unordered_map<uint64_t, std::unique_ptr<Player>> mapPlayers;
+        mapPlayers.reserve(mapCounts);
+        for (uint64_t id = 1; id <= mapCounts; id++)
+        {
+            const PlayerSnapshot snapshot = makeSyntheticPlayer(id, nowMs);
+            mapPlayers[id] = std::make_unique<Player>(id, snapshot.score, snapshot.wins, snapshot.updatedTime);
+        }
+        const double populateMs = getElapsedMs(beginTime);
+
+        beginTime = std::chrono::steady_clock::now();
+        uint64_t id = 1;
+        for (uint64_t i = 0; i < LOOKUP_COUNT; i++)
+        {
+            id = nextLookupId(id, mapPlayers.find(id)->second->getScore(), mapCounts);
+        }
+        const double lookupNs = getElapsedMs(beginTime) * 1000000.0 / LOOKUP_COUNT;
+        checksum += id;
+
+        beginTime = std::chrono::steady_clock::now();
+        for (const auto& itPlayer : mapPlayers)
+        {
+            checksum += itPlayer.second->getScore() + itPlayer.second->getWins();
+        }
+        const double scanMs = getElapsedMs(beginTime);
+
+        // estimate: heap blocks rounded to 16 bytes, a node holds the pair plus two links, two links per bucket
+        auto roundUp = [](size_t bytes) { return (bytes + 15) / 16 * 16; };
+        const double bytesPerPlayer = static_cast<double>(roundUp(sizeof(Player)))
+            + roundUp(sizeof(std::pair<const uint64_t, std::unique_ptr<Player>>) + 2 * sizeof(void*))
+            + static_cast<double>(mapPlayers.bucket_count()) * 2 * sizeof(void*) / mapCounts;
+        printLayoutResult("map", mapCounts, bytesPerPlayer, lookupNs, scanMs);
+        std::cout << "    (populated in " << populateMs << " ms, bytes/player estimated from sizeof(Player) = " << sizeof(Player) << ")\n";
+    }
+    std::cout << "  checksum " << checksum << "\n";
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// per-row query / save cost with every statement prepared on each call, then with the statement cache.
+// synthetic rows of the temp game (--bench stmt) are rewritten one commit each under the throughput
+// profile, which doesn't sync, so the time is sql work, not fsync
+void benchmark::runStatementCache(uint32_t counts)
+{
+    std::vector<PlayerSnapshot> vecSnapshots;
+    if (counts == 0 || !writeSyntheticPlayers(counts, vecSnapshots))
+    {
+        return;
+    }
+    const db_constant::StorageProfile originProfile = DbManager::instance().getStorageProfile();
+    if (!DbManager::instance().applyStorageProfile(db_constant::StorageProfile::throughput))
+    {
+        return;
+    }
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "bench stmt (" << counts << " rows)\n";
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const bool isCacheEnabled = (pass == 1);
+        DbManager::instance().setStatementCacheEnabled(isCacheEnabled);
+
+        std::vector<uint64_t> vecIds;
+        std::vector<uint32_t> vecScores;
+        std::vector<uint32_t> vecWins;
+        auto beginTime = std::chrono::steady_clock::now();
+        for (const PlayerSnapshot& written : vecSnapshots)
+        {
+            const uint64_t id = written.id;
+            uint32_t score = 0;
+            uint32_t wins = 0;
+            uint64_t updatedTime = 0;
+            if (DbManager::instance().queryPlayerBattles(id, score, wins, updatedTime))
+            {
+                vecIds.emplace_back(id);
+                vecScores.emplace_back(score);
+                vecWins.emplace_back(wins);
+            }
+        }
+        const double queryMs = getElapsedMs(beginTime);
+
+        beginTime = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < vecIds.size(); i++)
+        {
+            DbManager::instance().updatePlayerBattles(vecIds[i], vecScores[i], vecWins[i]);
+        }
+        const double saveMs = getElapsedMs(beginTime);
+
+        std::cout << "  " << (isCacheEnabled ? "cached    " : "uncached  ")
+            << "query " << queryMs * 1000.0 / counts << " us/row, "
+            << "save " << (vecIds.empty() ? 0 : saveMs * 1000.0 / vecIds.size()) << " us/row\n";
+    }
+    DbManager::instance().setStatementCacheEnabled(true);
+    DbManager::instance().applyStorageProfile(originProfile);
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// save throughput (chunked batch and single-row commits) and query latency under every storage profile.
+// synthetic rows of the temp game (--bench storage) are rewritten, the configured profile is restored at the end
+void benchmark::runStorageProfiles(uint32_t counts)
+{
+    std::vector<PlayerSnapshot> vecSnapshots;
+    if (counts == 0 || !writeSyntheticPlayers(counts, vecSnapshots))
+    {
+        return;
+    }
+    const db_constant::StorageProfile originProfile = DbManager::instance().getStorageProfile();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "bench storage (" << vecSnapshots.size() << " rows)\n";
+    std::cout << "  " << std::left << std::setw(12) << "profile"
+        << std::setw(16) << "batch rows/s"
+        << std::setw(16) << "commit ms"
+        << "query us\n";
+    for (uint8_t profile = 0; profile < db_constant::StorageProfileMax; profile++)
+    {
+        if (!DbManager::instance().applyStorageProfile(static_cast<db_constant::StorageProfile>(profile)))
+        {
+            continue;
+        }
+
+        auto beginTime = std::chrono::steady_clock::now();
+        const size_t savedCount = DbManager::instance().updatePlayerBattlesBatch(vecSnapshots);
+        const double batchMs = getElapsedMs(beginTime);
+
+        const uint32_t commitCount = std::min<uint32_t>(STORAGE_COMMIT_COUNT, static_cast<uint32_t>(vecSnapshots.size()));
+        beginTime = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < commitCount; i++)
+        {
+            DbManager::instance().updatePlayerBattlesBatch(std::vector<PlayerSnapshot>(1, vecSnapshots[i]));
+        }
+        const double commitMs = getElapsedMs(beginTime) / commitCount;
+
+        uint64_t id = 1;
+        beginTime = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < STORAGE_QUERY_COUNT; i++)
+        {
+            PlayerSnapshot snapshot;
+            id = nextLookupId(id, 0, vecSnapshots.size());
+            DbManager::instance().queryPlayerBattles(vecSnapshots[id - 1].id, snapshot.score, snapshot.wins, snapshot.updatedTime);
+        }
+        const double queryUs = getElapsedMs(beginTime) * 1000.0 / STORAGE_QUERY_COUNT;
+
+        std::cout << "  " << std::left << std::setw(12) << DbManager::getStorageProfileName(static_cast<db_constant::StorageProfile>(profile))
+            << std::setw(16) << (batchMs > 0 ? savedCount * 1000.0 / batchMs : 0)
+            << std::setw(16) << commitMs
+            << queryUs << "\n";
+    }
+    DbManager::instance().applyStorageProfile(originProfile);
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// query latency while the db writer flushes 'counts' rows, with reads on the writer connection and on the read pool.
+// the synthetic rows of the temp game (--bench reads) are written, then flushed again while they are queried
+void benchmark::runReadPool(uint32_t counts)
+{
+    std::vector<PlayerSnapshot> vecSnapshots;
+    if (counts == 0 || !writeSyntheticPlayers(counts, vecSnapshots))
+    {
+        return;
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "bench reads (queries during a " << counts << "-row flush)\n";
+    std::cout << "  " << std::left << std::setw(10) << "reads on"
+        << std::setw(12) << "flush ms"
+        << std::setw(10) << "queries"
+        << std::setw(10) << "p50 us"
+        << std::setw(10) << "p99 us"
+        << std::setw(12) << "p99.9 us"
+        << "max us\n";
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const bool isPoolEnabled = (pass == 1);
+        DbManager::instance().waitForWrites();
+        DbManager::instance().setReadPoolEnabled(isPoolEnabled);
+
+        std::atomic<bool> isFlushing{ true };
+        double flushMs = 0;
+        const auto flushBeginTime = std::chrono::steady_clock::now();
+        DbManager::instance().updatePlayerBattlesAsync(vecSnapshots,
+            [&isFlushing, &flushMs, flushBeginTime](size_t)
+            {
+                flushMs = getElapsedMs(flushBeginTime);
+                isFlushing = false;
+            });
+
+        std::vector<double> vecLatencyUs;
+        uint64_t id = 1;
+        while (isFlushing.load())
+        {
+            PlayerSnapshot snapshot;
+            id = nextLookupId(id, 0, vecSnapshots.size());
+            const auto beginTime = std::chrono::steady_clock::now();
+            DbManager::instance().queryPlayerBattles(vecSnapshots[id - 1].id, snapshot.score, snapshot.wins, snapshot.updatedTime);
+            vecLatencyUs.emplace_back(getElapsedMs(beginTime) * 1000.0);
+        }
+        // the callback above references this frame
+        DbManager::instance().waitForWrites();
+        std::sort(vecLatencyUs.begin(), vecLatencyUs.end());
+
+        std::cout << "  " << std::left << std::setw(10) << (isPoolEnabled ? "pool" : "writer")
+            << std::setw(12) << flushMs
+            << std::setw(10) << vecLatencyUs.size()
+            << std::setw(10) << getPercentile(vecLatencyUs, 50)
+            << std::setw(10) << getPercentile(vecLatencyUs, 99)
+            << std::setw(12) << getPercentile(vecLatencyUs, 99.9)
+            << (vecLatencyUs.empty() ? 0 : vecLatencyUs.back()) << "\n";
+    }
+    DbManager::instance().setReadPoolEnabled(true);
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// the same rows through every player store: throughput and latency, then the conformance checks.
+// the sqlite store writes to the temp game db (--bench store), the log and sharded stores to their own temp files
+void benchmark::runPlayerStores(uint32_t counts)
+{
+    if (counts < 2)
+    {
+        return;
+    }
+    // a block of unused ids, one past the end stays missing
+    uint64_t firstId = 0;
+    DbManager::instance().waitForWrites();
+    if (!DbManager::instance().reservePlayerIdBlock(counts + 1, firstId))
+    {
+        return;
+    }
+    const uint64_t nowMs = time_utils::getTimestampMS();
+    std::vector<PlayerSnapshot> vecSnapshots;
+    vecSnapshots.reserve(counts);
+    for (uint32_t i = 0; i < counts; i++)
+    {
+        vecSnapshots.emplace_back(makeSyntheticPlayer(firstId + i, nowMs));
+    }
+    std::vector<uint64_t> vecLookupIds;
+    uint64_t id = 1;
+    for (uint32_t i = 0; i < STORAGE_QUERY_COUNT; i++)
+    {
+        id = nextLookupId(id, 0, counts);
+        vecLookupIds.emplace_back(firstId + id - 1);
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "bench store (" << counts << " players)\n";
+    std::cout << "  " << std::left << std::setw(10) << "store"
+        << std::setw(16) << "save rows/s"
+        << std::setw(14) << "load-one us"
+        << std::setw(14) << "load-all ms"
+        << std::setw(12) << "open ms"
+        << "conformance\n";
+    std::remove(BENCH_PLAYER_LOG_FILE);
+    removeShardFiles(BENCH_PLAYER_SHARD_PREFIX);
+    double saveRates[db_constant::PlayerStoreBackendMax] = {};
+    for (uint8_t backend = 0; backend < db_constant::PlayerStoreBackendMax; backend++)
+    {
+        std::unique_ptr<IPlayerStore> pStore = DbManager::instance().createPlayerStore(static_cast<db_constant::PlayerStoreBackend>(backend),
+            (backend == db_constant::PlayerStoreBackend::sharded) ? BENCH_PLAYER_SHARD_PREFIX : BENCH_PLAYER_LOG_FILE);
+        if (!pStore || !pStore->open())
+        {
+            continue;
+        }
+
+        auto beginTime = std::chrono::steady_clock::now();
+        const size_t savedCount = pStore->savePlayers(vecSnapshots);
+        const double saveMs = getElapsedMs(beginTime);
+
+        PlayerSnapshot snapshot;
+        beginTime = std::chrono::steady_clock::now();
+        for (const uint64_t lookupId : vecLookupIds)
+        {
+            pStore->loadPlayer(lookupId, snapshot);
+        }
+        const double loadOneUs = getElapsedMs(beginTime) * 1000.0 / vecLookupIds.size();
+
+        // the sqlite store also scans the game's own players
+        size_t scannedCount = 0;
+        beginTime = std::chrono::steady_clock::now();
+        pStore->forEachPlayer(0, [&scannedCount](const PlayerSnapshot&) { scannedCount++; });
+        const double loadAllMs = getElapsedMs(beginTime);
+
+        pStore->close();
+        beginTime = std::chrono::steady_clock::now();
+        pStore->open();
+        const double openMs = getElapsedMs(beginTime);
+
+        const std::string failure = checkPlayerStore(*pStore, vecSnapshots, nowMs + 1);
+        saveRates[backend] = (saveMs > 0) ? savedCount * 1000.0 / saveMs : 0;
+        std::cout << "  " << std::left << std::setw(10) << pStore->getName()
+            << std::setw(16) << saveRates[backend]
+            << std::setw(14) << loadOneUs
+            << std::setw(14) << loadAllMs
+            << std::setw(12) << openMs
+            << (failure.empty() ? "ok" : "FAILED: " + failure) << "\n";
+
+        LogPlayerStore* pLogStore = dynamic_cast<LogPlayerStore*>(pStore.get());
+        if (pLogStore)
+        {
+            const uint64_t fileSize = pLogStore->getFileSize();
+            beginTime = std::chrono::steady_clock::now();
+            const bool isCompacted = pLogStore->compact();
+            const double compactMs = getElapsedMs(beginTime);
+            const bool isIntact = pLogStore->loadPlayer(firstId + counts - 1, snapshot) && snapshot.wins == vecSnapshots.back().wins;
+            std::cout << "  log compaction: " << fileSize / (1024.0 * 1024.0) << " MB -> " << pLogStore->getFileSize() / (1024.0 * 1024.0)
+                << " MB in " << compactMs << " ms" << ((isCompacted && isIntact) ? "" : " FAILED") << "\n";
+        }
+        pStore->close();
+    }
+    if (saveRates[db_constant::PlayerStoreBackend::sqlite] > 0)
+    {
+        std::cout << "  sharded save (" << db_constant::PLAYER_SHARD_COUNT << " shards) vs sqlite: "
+            << saveRates[db_constant::PlayerStoreBackend::sharded] / saveRates[db_constant::PlayerStoreBackend::sqlite] << "x\n";
+    }
+    std::remove(BENCH_PLAYER_LOG_FILE);
+    removeShardFiles(BENCH_PLAYER_SHARD_PREFIX);
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// an empty game on temp files: nothing is loaded, no journal, no scheduler and no matchmaking
+bool benchmark::openTempGame()
+{
+    removeTempGameFiles();
+    if (!DbManager::instance().initialize() || !PlayerManager::instance().initialize()
+        || !DbManager::instance().connect(TEMP_DB_FILE, TEMP_GAME_STORE_FILE) || !DbManager::instance().ensureTableSchema())
+    {
+        std::cerr << "benchmark::openTempGame: Failed to open '" << TEMP_DB_FILE << "'." << std::endl;
+        closeTempGame();
+        return false;
+    }
+    return true;
+}
+
+void benchmark::closeTempGame()
+{
+    PlayerManager::instance().release();
+    DbManager::instance().release();
+    removeTempGameFiles();
+}
+
+// the game db and every store are temp files in the working directory, removed again at the end
+bool benchmark::testPlayerStores()
+{
+    removeStoreTestFiles();
+    if (!openTempGame())
+    {
+        return false;
+    }
+    const uint64_t nowMs = time_utils::getTimestampMS();
+    std::vector<PlayerSnapshot> vecSnapshots;
+    vecSnapshots.reserve(STORE_TEST_PLAYERS);
+    for (uint64_t id = 1; id <= STORE_TEST_PLAYERS; id++)
+    {
+        vecSnapshots.emplace_back(makeSyntheticPlayer(id, nowMs));
+    }
+
+    std::cout << "player store tests (" << STORE_TEST_PLAYERS << " players)\n";
+    bool isPassed = true;
+    for (uint8_t backend = 0; backend < db_constant::PlayerStoreBackendMax; backend++)
+    {
+        std::unique_ptr<IPlayerStore> pStore = DbManager::instance().createPlayerStore(static_cast<db_constant::PlayerStoreBackend>(backend),
+            (backend == db_constant::PlayerStoreBackend::sharded) ? TEST_PLAYER_SHARD_PREFIX : TEST_PLAYER_LOG_FILE);
+        std::string failure;
+        if (!pStore || !pStore->open())
+        {
+            failure = "open fails";
+        }
+        else if (pStore->savePlayers(vecSnapshots) != vecSnapshots.size())
+        {
+            failure = "savePlayers fails";
+        }
+        else
+        {
+            failure = checkPlayerStore(*pStore, vecSnapshots, nowMs + 1);
+        }
+        if (pStore)
+        {
+            pStore->close();
+        }
+        std::cout << "  " << std::left << std::setw(10) << (pStore ? pStore->getName() : "?")
+            << (failure.empty() ? "ok" : "FAILED: " + failure) << "\n";
+        isPassed = isPassed && failure.empty();
+    }
+    closeTempGame();
+    removeStoreTestFiles();
+    std::cout << (isPassed ? "all player store tests passed" : "player store tests FAILED") << std::endl;
+    return isPassed;
+}
+
+// durable battle results: rooms that finish one after another pay one fsync each,
+// rooms that finish together share them (group commit). runs on a temp journal
+void benchmark::runBattleJournal(uint32_t counts)
+{
+    if (counts == 0)
+    {
+        return;
+    }
+    // a 3 vs 3 room
+    std::vector<BattleResult> vecResults(6);
+    for (size_t i = 0; i < vecResults.size(); i++)
+    {
+        vecResults[i].playerId = i + 1;
+        vecResults[i].updatedTime = time_utils::getTimestampMS();
+        vecResults[i].isWin = (i < 3) ? 1 : 0;
+        vecResults[i].team = (i < 3) ? battle_constant::TeamColor::Red : battle_constant::TeamColor::Blue;
+        vecResults[i].scoreDelta = vecResults[i].isWin ? battle_constant::WINNER_SCORE : battle_constant::LOSER_SCORE;
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "bench journal (" << counts << " battles)\n";
+    std::cout << "  " << std::left << std::setw(8) << "rooms"
+        << std::setw(16) << "battles/s"
+        << std::setw(10) << "syncs"
+        << std::setw(14) << "battles/sync"
+        << "avg sync ms\n";
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const uint32_t roomCount = (pass == 0) ? 1 : JOURNAL_BENCH_ROOMS;
+        std::remove(BENCH_BATTLE_JOURNAL_FILE);
+        BattleJournal journal;
+        std::vector<BattleRecord> vecPendingRecords;
+        if (!journal.open(BENCH_BATTLE_JOURNAL_FILE, vecPendingRecords))
+        {
+            return;
+        }
+
+        const auto beginTime = std::chrono::steady_clock::now();
+        std::vector<std::thread> vecThreads;
+        for (uint32_t room = 0; room < roomCount; room++)
+        {
+            vecThreads.emplace_back([&journal, &vecResults, room, roomCount, counts]()
+                {
+                    for (uint32_t i = room; i < counts; i += roomCount)
+                    {
+                        journal.waitDurable(journal.append(i + 1, 0, vecResults));
+                    }
+                });
+        }
+        for (std::thread& thread : vecThreads)
+        {
+            thread.join();
+        }
+        const double elapsedMs = getElapsedMs(beginTime);
+        const BattleJournalStats stats = journal.getStats();
+        journal.close();
+
+        std::cout << "  " << std::left << std::setw(8) << roomCount
+            << std::setw(16) << (elapsedMs > 0 ? stats.records * 1000.0 / elapsedMs : 0)
+            << std::setw(10) << stats.syncs
+            << std::setw(14) << (stats.syncs > 0 ? static_cast<double>(stats.records) / stats.syncs : 0)
+            << (stats.syncs > 0 ? elapsedMs / stats.syncs : 0) << "\n";
+    }
+    std::remove(BENCH_BATTLE_JOURNAL_FILE);
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// match history ingestion: the battle side only queues a match, the flush writes them through the db writer
+// in multi-row inserts. then "last N matches" latency on the per-player index. synthetic matches and players
+// use ids from HISTORY_BENCH_FIRST_ID and are removed afterwards
+void benchmark::runMatchHistory(uint32_t counts)
+{
+    if (counts == 0)
+    {
+        return;
+    }
+    std::vector<MatchRecord> vecMatches(counts);
+    uint64_t playerSeed = 1;
+    for (uint32_t i = 0; i < counts; i++)
+    {
+        MatchRecord& match = vecMatches[i];
+        match.roomId = i + 1;
+        match.battleTime = time_utils::getTimestampMS();
+        match.tier = i % 8;
+        match.winnerTeam = static_cast<uint8_t>(i % battle_constant::TeamColor::Max);
+        for (uint8_t team = 0; team < battle_constant::TeamColor::Max; team++)
+        {
+            for (int slot = 0; slot < 3; slot++)
+            {
+                playerSeed = nextLookupId(playerSeed, i, HISTORY_BENCH_PLAYERS);
+                match.vecRosters[team].emplace_back(HISTORY_BENCH_FIRST_ID + playerSeed);
+            }
+        }
+    }
+    DbManager::instance().waitForWrites();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "bench history (" << counts << " matches, " << HISTORY_BENCH_PLAYERS << " players)\n";
+
+    auto beginTime = std::chrono::steady_clock::now();
+    for (MatchRecord& match : vecMatches)
+    {
+        BattleManager::instance().enqueueMatch(std::move(match));
+    }
+    const double enqueueMs = getElapsedMs(beginTime);
+    beginTime = std::chrono::steady_clock::now();
+    BattleManager::instance().flushMatchHistory();
+    DbManager::instance().waitForWrites();
+    const double flushMs = getElapsedMs(beginTime);
+    std::cout << "  enqueue     : " << enqueueMs * 1000000.0 / counts << " ns per match\n";
+    std::cout << "  flush       : " << flushMs << " ms (" << (flushMs > 0 ? counts * 1000.0 / flushMs : 0) << " matches/s)\n";
+
+    std::vector<double> vecSamples;
+    std::vector<MatchRecord> vecHistory;
+    size_t foundCount = 0;
+    uint64_t id = 1;
+    for (uint32_t i = 0; i < HISTORY_BENCH_QUERY_COUNT; i++)
+    {
+        id = nextLookupId(id, 0, HISTORY_BENCH_PLAYERS);
+        beginTime = std::chrono::steady_clock::now();
+        DbManager::instance().queryMatchHistory(HISTORY_BENCH_FIRST_ID + id, HISTORY_BENCH_QUERY_MATCHES, vecHistory);
+        vecSamples.emplace_back(getElapsedMs(beginTime) * 1000.0);
+        foundCount += vecHistory.size();
+    }
+    std::sort(vecSamples.begin(), vecSamples.end());
+    std::cout << "  last " << HISTORY_BENCH_QUERY_MATCHES << "     : p50 " << getPercentile(vecSamples, 50) << " us, p99 "
+        << getPercentile(vecSamples, 99) << " us (" << static_cast<double>(foundCount) / HISTORY_BENCH_QUERY_COUNT << " matches per query)\n";
+
+    DbManager::instance().deleteMatchHistoryRange(HISTORY_BENCH_FIRST_ID, HISTORY_BENCH_FIRST_ID + std::max<uint64_t>(counts, HISTORY_BENCH_PLAYERS));
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// the "query" command's two paths on the same resident players: PlayerManager's snapshot and the db read
+// it replaces (player store, read pool). resident players are queried round-robin up to 'counts' lookups
+void benchmark::runPlayerQuery(uint32_t counts)
+{
+    std::vector<uint64_t> vecIds;
+    PlayerManager::instance().forEachPlayerSnapshot([&vecIds](const PlayerSnapshot& snapshot) { vecIds.emplace_back(snapshot.id); });
+    if (vecIds.empty() || counts == 0)
+    {
+        std::cout << "bench query: no resident players, log some in first ('start').\n";
+        return;
+    }
+    DbManager::instance().waitForWrites();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "bench query (" << counts << " lookups on " << vecIds.size() << " resident players)\n";
+    std::cout << "  " << std::left << std::setw(10) << "source"
+        << std::setw(12) << "p50 us"
+        << std::setw(12) << "p99 us"
+        << std::setw(12) << "max us"
+        << "found\n";
+    for (int pass = 0; pass < 2; pass++)
+    {
+        std::vector<double> vecSamples;
+        vecSamples.reserve(counts);
+        uint32_t foundCount = 0;
+        PlayerSnapshot snapshot;
+        for (uint32_t i = 0; i < counts; i++)
+        {
+            const uint64_t id = vecIds[i % vecIds.size()];
+            const auto beginTime = std::chrono::steady_clock::now();
+            const bool isFound = (pass == 0)
+                ? PlayerManager::instance().queryPlayer(id, snapshot) == player_constant::PlayerQuerySource::memory
+                : DbManager::instance().queryPlayerBattles(id, snapshot.score, snapshot.wins, snapshot.updatedTime);
+            vecSamples.emplace_back(getElapsedMs(beginTime) * 1000.0);
+            foundCount += isFound ? 1 : 0;
+        }
+        std::sort(vecSamples.begin(), vecSamples.end());
+        std::cout << "  " << std::left << std::setw(10) << ((pass == 0) ? "memory" : "db")
+            << std::setw(12) << getPercentile(vecSamples, 50)
+            << std::setw(12) << getPercentile(vecSamples, 99)
+            << std::setw(12) << vecSamples.back()
+            << foundCount << "\n";
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
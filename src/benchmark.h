@@ -0,0 +1,31 @@
+// benchmark.h
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstdint>
+
+// console benchmarks ("bench ..." commands), results are printed to stdout
+namespace benchmark
+{
+    void runLogin(uint32_t counts);
+    void runSaveAvoidance(uint32_t counts);
+    void runLayout(uint64_t counts);
+    void runStatementCache(uint32_t counts);
+    void runStorageProfiles(uint32_t counts);
+    void runReadPool(uint32_t counts);
+    void runPlayerStores(uint32_t counts);
+    void runBattleJournal(uint32_t counts);
+    void runMatchHistory(uint32_t counts);
+    void runPlayerQuery(uint32_t counts);
+
+    // an empty game on temp files in the working directory, the live db is not opened (main's --bench).
+    // the benchmarks that create players run only on it
+    bool openTempGame();
+    void closeTempGame();
+
+    // the player store conformance checks of "bench store" on temp files, without the game (main's --test-stores).
+    // returns false when a check fails
+    bool testPlayerStores();
+}
+
+#endif // BENCHMARK_H
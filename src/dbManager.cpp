@@ -4,13 +4,154 @@
 // @date  : 2025-05-15
 #include "dbManager.h"
 #include "playerManager.h"
+#include "playerSnapshotFile.h"
+#include "sqlitePlayerStore.h"
+#include "logPlayerStore.h"
+#include "shardedPlayerStore.h"
+#include "../include/globalDefine.h"
 #include "../sqlite/sqlite3.h"
 #include <../../utils/utils.h>
 #include <iostream>
 #include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// pragmas of every db_constant::StorageProfile, in enum order
+struct StorageProfileSettings
+{
+    const char* name;
+    const char* journalMode;
+    const char* synchronous;
+    int64_t mmapSize;       // bytes
+    int64_t cacheSizeKb;
+    const char* tempStore;
+};
+const StorageProfileSettings STORAGE_PROFILE_SETTINGS[db_constant::StorageProfileMax] = {
+    { "legacy",     "DELETE", "FULL", 0,                   2000,       "DEFAULT" },
+    { "durable",    "WAL",    "FULL",   0,                    16 * 1024,  "DEFAULT" },
+    { "balanced",   "WAL",    "NORMAL", 256ll * 1024 * 1024,  64 * 1024,  "MEMORY" },
+    { "throughput", "WAL",    "OFF",    1024ll * 1024 * 1024, 256 * 1024, "MEMORY" },
+};
 
 std::unordered_map<std::string, std::string> MAP_CREATE_TABLE_SQL = {
-    {"player_battles", "CREATE TABLE IF NOT EXISTS player_battles (id INTEGER PRIMARY KEY, score INTEGER, wins INTEGER, updated_time INTEGER)"},
+    {"player_battles", SqlitePlayerStore::SQL_CREATE_PLAYER_BATTLES},
+    {"id_allocator", SqlitePlayerStore::SQL_CREATE_ID_ALLOCATOR},
+    {"match_history", "CREATE TABLE IF NOT EXISTS match_history (match_id INTEGER PRIMARY KEY, room_id INTEGER, battle_time INTEGER, "
+        "tier INTEGER, winner_team INTEGER, red_roster TEXT, blue_roster TEXT)"},
+    // per-player index of match_history: a player's last matches are one backward range scan
+    {"match_participants", "CREATE TABLE IF NOT EXISTS match_participants (player_id INTEGER, match_id INTEGER, "
+        "PRIMARY KEY (player_id, match_id)) WITHOUT ROWID"},
+};
+
+// match history is written with multi-row inserts of this many rows per statement
+// (7 / 2 bound values per row, below sqlite's default limit of 999)
+const size_t MATCH_INSERT_ROWS = 64;
+const size_t PARTICIPANT_INSERT_ROWS = 256;
+const char* const SQL_INSERT_MATCH =
+    "INSERT INTO match_history (match_id, room_id, battle_time, tier, winner_team, red_roster, blue_roster) VALUES ";
+const char* const SQL_INSERT_MATCH_ROW = "(?, ?, ?, ?, ?, ?, ?)";
+const char* const SQL_INSERT_PARTICIPANT = "INSERT OR IGNORE INTO match_participants (player_id, match_id) VALUES ";
+const char* const SQL_INSERT_PARTICIPANT_ROW = "(?, ?)";
+const char* const SQL_MAX_MATCH_ID = "SELECT IFNULL(MAX(match_id), 0) FROM match_history;";
+// a match already stored (its journal record was replayed) is skipped before the insert.
+// a replayed match is the same room, battle time and players: looked up through one participant's index rows
+const char* const SQL_FIND_REPLAYED_MATCH =
+    "SELECT 1 FROM match_participants p JOIN match_history m ON m.match_id = p.match_id "
+    "WHERE p.player_id = ? AND m.room_id = ? AND m.battle_time = ? LIMIT 1;";
+const char* const SQL_QUERY_MATCH_HISTORY =
+    "SELECT m.match_id, m.room_id, m.battle_time, m.tier, m.winner_team, m.red_roster, m.blue_roster "
+    "FROM match_participants p JOIN match_history m ON m.match_id = p.match_id "
+    "WHERE p.player_id = ? ORDER BY p.match_id DESC LIMIT ?;";
+
+static std::string makeInsertSql(const char* sqlHead, const char* sqlRow, size_t rows)
+{
+    std::string sql = sqlHead;
+    for (size_t i = 0; i < rows; i++)
+    {
+        sql += (i == 0) ? sqlRow : std::string(", ") + sqlRow;
+    }
+    return sql + ";";
+}
+
+static std::string joinRoster(const std::vector<uint64_t>& vecIds)
+{
+    std::string roster;
+    for (const uint64_t id : vecIds)
+    {
+        roster += roster.empty() ? std::to_string(id) : "," + std::to_string(id);
+    }
+    return roster;
+}
+
+static std::vector<uint64_t> splitRoster(const char* roster)
+{
+    std::vector<uint64_t> vecIds;
+    while (roster && *roster)
+    {
+        char* pEnd = nullptr;
+        vecIds.emplace_back(std::strtoull(roster, &pEnd, 10));
+        roster = (*pEnd == ',') ? pEnd + 1 : pEnd;
+    }
+    return vecIds;
+}
+
+// fsync of a file through a handle of its own: a finished backup is on disk before it replaces the previous one,
+// and files another connection / stream keeps open are synced without touching that handle
+bool DbManager::syncFile(const std::string& path)
+{
+    FILE* pFile = std::fopen(path.c_str(), "r+b");
+    if (!pFile)
+    {
+        return false;
+    }
+#ifdef _WIN32
+    const bool isOk = _commit(_fileno(pFile)) == 0;
+#else
+    const bool isOk = fsync(fileno(pFile)) == 0;
+#endif
+    std::fclose(pFile);
+    return isOk;
+}
+
+// puts fromPath in place of toPath in one step, the old file stays complete until then, and syncs the
+// directory entry. fromPath must be synced first, then a crash leaves one of the two files whole
+bool DbManager::replaceFile(const std::string& fromPath, const std::string& toPath)
+{
+#ifdef _WIN32
+    return MoveFileExA(fromPath.c_str(), toPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (std::rename(fromPath.c_str(), toPath.c_str()) != 0)
+    {
+        return false;
+    }
+    const size_t slashPos = toPath.find_last_of('/');
+    const std::string dirPath = (slashPos == std::string::npos) ? "." : toPath.substr(0, slashPos + 1);
+    const int dirFd = open(dirPath.c_str(), O_RDONLY);
+    if (dirFd < 0)
+    {
+        return false;
+    }
+    const bool isOk = fsync(dirFd) == 0;
+    close(dirFd);
+    return isOk;
+#endif
+}
+
+// created at startup when missing, after the tables
+const std::vector<std::string> VEC_CREATE_INDEX_SQL = {
+    SqlitePlayerStore::SQL_CREATE_PLAYER_BATTLES_INDEX,
 };
 
 DbManager& DbManager::instance()
@@ -26,8 +167,13 @@ DbManager::DbManager()
 
 DbManager::~DbManager()
 {
+    _abortBackup();
+    _stopWriter();
+    _closePlayerStore();
+    _closeReadPool();
     if (m_dbHandler)
     {
+        _finalizeStatementsNoLock();
         sqlite3_close(m_dbHandler);
         m_dbHandler = nullptr;
     }
@@ -36,9 +182,33 @@ DbManager::~DbManager()
 bool DbManager::initialize()
 {
 	m_mapFuncSyncData.clear();
-    m_mapFuncSyncData["player_battles"] = [this]() { this->syncAllPlayerBattles(); };
+    if (db_constant::LAZY_PLAYER_LOADING)
+    {
+        // only ids are needed at startup, rows are loaded by PlayerManager on first login
+        m_mapFuncSyncData["player_battles"] = [this]()
+        {
+            if (!this->syncPlayersFromSnapshot())
+            {
+                this->syncAllPlayerIds();
+            }
+        };
+    }
+    else
+    {
+        m_mapFuncSyncData["player_battles"] = [this]()
+        {
+            if (!this->syncPlayersFromSnapshot())
+            {
+                this->syncAllPlayerBattles();
+            }
+        };
+    }
+    _stopWriter();
+    _closePlayerStore();
+    _closeReadPool();
     if (m_dbHandler)
     {
+        _finalizeStatementsNoLock();
         sqlite3_close(m_dbHandler);
         m_dbHandler = nullptr;
     }
@@ -47,6 +217,14 @@ bool DbManager::initialize()
 
 bool DbManager::connect()
 {
+    const std::string storeFileName = (db_constant::PLAYER_STORE_BACKEND == db_constant::PlayerStoreBackend::sharded)
+        ? db_constant::PLAYER_SHARD_FILE_PREFIX : db_constant::PLAYER_LOG_FILE;
+    return connect(m_dbName, storeFileName);
+}
+
+bool DbManager::connect(const std::string& dbName, const std::string& storeFileName)
+{
+    m_dbName = dbName;
     int rc = sqlite3_open(m_dbName.c_str(), &m_dbHandler);
     if (rc != SQLITE_OK)
     {
@@ -55,15 +233,143 @@ bool DbManager::connect()
 		return false;
     }
 	std::cout << "DbManager::connect database opened successfully." << std::endl;
+    if (!applyStorageProfile(db_constant::STORAGE_PROFILE))
+    {
+        return false;
+    }
+    std::cout << "DbManager::connect storage profile '" << getStorageProfileName(db_constant::STORAGE_PROFILE) << "'." << std::endl;
+
+    m_pPlayerStore = createPlayerStore(db_constant::PLAYER_STORE_BACKEND, storeFileName);
+    if (!m_pPlayerStore || !m_pPlayerStore->open())
+    {
+        std::cerr << "DbManager::connect: Failed to open the player store." << std::endl;
+        m_pPlayerStore.reset();
+        return false;
+    }
+    std::cout << "DbManager::connect player store '" << m_pPlayerStore->getName() << "'." << std::endl;
+    if (!_importPlayersIntoShards())
+    {
+        return false;
+    }
+    _startWriter();
     return true;
 }
 
+// the log store keeps its own file (fileName), the sharded store its shard files (fileName is their prefix),
+// the sqlite store works on this manager's connection
+std::unique_ptr<IPlayerStore> DbManager::createPlayerStore(db_constant::PlayerStoreBackend backend, const std::string& fileName)
+{
+    switch (backend)
+    {
+    case db_constant::PlayerStoreBackend::sqlite:
+        return std::unique_ptr<IPlayerStore>(new SqlitePlayerStore(*this));
+    case db_constant::PlayerStoreBackend::log:
+        return std::unique_ptr<IPlayerStore>(new LogPlayerStore(fileName));
+    case db_constant::PlayerStoreBackend::sharded:
+        return std::unique_ptr<IPlayerStore>(new ShardedPlayerStore(*this, fileName, db_constant::PLAYER_SHARD_COUNT));
+    default:
+        std::cerr << "DbManager::createPlayerStore: Unknown backend " << static_cast<int>(backend) << "." << std::endl;
+        return nullptr;
+    }
+}
+
+// can be switched at runtime, the statement cache is dropped since pragmas may change query plans.
+// the read pool is closed meanwhile: sqlite can't leave WAL mode while other connections are open
+bool DbManager::applyStorageProfile(db_constant::StorageProfile profile)
+{
+    DbStats::Scope scope(m_dbStats, DbStats::admin, &m_mutex);
+
+    if (!m_dbHandler || profile >= db_constant::StorageProfileMax)
+    {
+        std::cerr << "DbManager::applyStorageProfile: Database not open or unknown profile." << std::endl;
+        return false;
+    }
+    _closeReadPool();
+    const bool isApplied = _applyStorageProfileNoLock(profile);
+    _openReadPool(m_storageProfile);
+    return isApplied;
+}
+
+// the pragmas of a profile, also applied by stores that open their own db files
+std::string DbManager::getStorageProfileSql(db_constant::StorageProfile profile)
+{
+    const StorageProfileSettings& settings = STORAGE_PROFILE_SETTINGS[(profile < db_constant::StorageProfileMax) ? profile : db_constant::STORAGE_PROFILE];
+    return std::string("PRAGMA journal_mode = ") + settings.journalMode + ";"
+        + "PRAGMA synchronous = " + settings.synchronous + ";"
+        + "PRAGMA mmap_size = " + std::to_string(settings.mmapSize) + ";"
+        + "PRAGMA cache_size = -" + std::to_string(settings.cacheSizeKb) + ";"
+        + "PRAGMA temp_store = " + settings.tempStore + ";";
+}
+
+bool DbManager::_applyStorageProfileNoLock(db_constant::StorageProfile profile)
+{
+    const StorageProfileSettings& settings = STORAGE_PROFILE_SETTINGS[profile];
+    const std::string sql = getStorageProfileSql(profile);
+
+    _finalizeStatementsNoLock();
+    char* errMsg = nullptr;
+    if (sqlite3_exec(m_dbHandler, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK)
+    {
+        std::cerr << "DbManager::applyStorageProfile: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    // sqlite keeps the old journal mode (without an error) when it can't switch, e.g. inside a transaction
+    std::string journalMode;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(m_dbHandler, "PRAGMA journal_mode;", -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        journalMode = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    std::transform(journalMode.begin(), journalMode.end(), journalMode.begin(), ::toupper);
+    if (journalMode != settings.journalMode)
+    {
+        std::cerr << "DbManager::applyStorageProfile: journal_mode is '" << journalMode << "', expected '" << settings.journalMode << "'." << std::endl;
+        return false;
+    }
+    m_storageProfile = profile;
+    return true;
+}
+
+// the commits of a connection under profile are on disk once this returns true. profiles with synchronous FULL
+// sync every commit themselves; the others (WAL) get their wal and db file synced, so the caller must hold the
+// connection's lock: no commit or checkpoint may move pages between the two files meanwhile
+bool DbManager::syncCommittedNoLock(const std::string& dbFileName, db_constant::StorageProfile profile)
+{
+    const StorageProfileSettings& settings = STORAGE_PROFILE_SETTINGS[(profile < db_constant::StorageProfileMax) ? profile : db_constant::STORAGE_PROFILE];
+    if (std::string(settings.synchronous) == "FULL")
+    {
+        return true;
+    }
+    return syncFile(dbFileName + "-wal") && syncFile(dbFileName);
+}
+
+db_constant::StorageProfile DbManager::getStorageProfile()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_storageProfile;
+}
+
+const char* DbManager::getStorageProfileName(db_constant::StorageProfile profile)
+{
+    return (profile < db_constant::StorageProfileMax) ? STORAGE_PROFILE_SETTINGS[profile].name : "unknown";
+}
+
 void DbManager::release()
 {
+    // queued writes are finished before the connection goes away
+    _abortBackup();
+    _stopWriter();
+    _closePlayerStore();
+
     std::lock_guard<std::mutex> lock(m_mutex);
 
+    _closeReadPool();
     if (m_dbHandler)
     {
+        _finalizeStatementsNoLock();
         sqlite3_close(m_dbHandler);
         m_dbHandler = nullptr;
 	}
@@ -87,6 +393,19 @@ bool DbManager::ensureTableSchema()
             }
         }
     }
+
+    DbStats::Scope scope(m_dbStats, DbStats::schema, &m_mutex);
+    _finalizeStatementsNoLock();
+    for (const std::string& sql : VEC_CREATE_INDEX_SQL)
+    {
+        char* errMsg = nullptr;
+        if (sqlite3_exec(m_dbHandler, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK)
+        {
+            std::cerr << "DbManager::ensureTableSchema: Failed to create index: " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+            return false;
+        }
+    }
     return true;
 }
 
@@ -95,52 +414,120 @@ void DbManager::loadTableData()
     for (auto& itFunc : m_mapFuncSyncData)
     {
 		const std::string tableName = itFunc.first;
-        // itFunc
+        auto beginTime = std::chrono::steady_clock::now();
         itFunc.second();
+        auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - beginTime).count();
+        std::cout << "DbManager::loadTableData: '" << tableName << "' loaded in " << elapsedMs << " ms." << std::endl;
     }
+    // index every loaded player now, so the first leaderboard query doesn't pay for it
+    PlayerManager::instance().updateLeaderboard();
 }
 
 // lƮɨXҦaƦPBplayerManage
 void DbManager::syncAllPlayerBattles()
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    if (!m_dbHandler)
+    if (!m_pPlayerStore)
     {
-        std::cerr << "DbManager::tableExists: Database not open." << std::endl;
+        std::cerr << "DbManager::syncAllPlayerBattles: No player store." << std::endl;
         return;
     }
+    m_pPlayerStore->forEachPlayer(0, [](const PlayerSnapshot& row)
+        {
+            PlayerManager::instance().syncPlayerFromDbNoLock(row.id, row.score, row.wins, row.updatedTime);
+        });
+}
 
-    const char* sql = "SELECT id, score, wins, updated_time FROM player_battles;";
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_dbHandler, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK)
+// lazy mode: only register the player ids (and scores for the leaderboard), rows are loaded on demand by loadPlayerBattles
+void DbManager::syncAllPlayerIds()
+{
+    if (!m_pPlayerStore)
     {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_dbHandler) << std::endl;
+        std::cerr << "DbManager::syncAllPlayerIds: No player store." << std::endl;
         return;
     }
-    uint64_t id = 0;
-    uint32_t score = 0;
-    uint32_t wins = 0;
-    uint64_t updatedTime = 0;
-    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
-    {
-        id = sqlite3_column_int64(stmt, 0);
-        score = sqlite3_column_int(stmt, 1);
-        wins = sqlite3_column_int(stmt, 2);
-        updatedTime = sqlite3_column_int64(stmt, 3);
-        if (id == 0)
+    // the score is needed to seed the leaderboard with every registered player
+    m_pPlayerStore->forEachPlayer(0, [](const PlayerSnapshot& row)
         {
-            continue;
-        }
-        PlayerManager::instance().syncPlayerFromDbNoLock(id, score, wins, updatedTime);
+            PlayerManager::instance().registerPlayerIdNoLock(row.id, row.score);
+        });
+}
+
+// startup from the binary player snapshot: bulk load it, then replay the rows changed since its high-water time.
+// false when there is no usable snapshot, the caller scans player_battles instead
+bool DbManager::syncPlayersFromSnapshot()
+{
+    PlayerSnapshotData data;
+    if (!player_snapshot::readFile(db_constant::PLAYER_SNAPSHOT_FILE, data))
+    {
+        return false;
     }
-    sqlite3_finalize(stmt);
+    std::vector<PlayerSnapshot> vecReplayRows;
+    if (!m_pPlayerStore || !m_pPlayerStore->forEachPlayer(data.highWaterTime,
+        [&vecReplayRows](const PlayerSnapshot& row) { vecReplayRows.emplace_back(row); }))
+    {
+        return false;
+    }
+    PlayerManager::instance().loadPlayerSnapshot(data, vecReplayRows);
+    std::cout << "DbManager::syncPlayersFromSnapshot: " << data.vecIds.size() << " players from snapshot, "
+        << vecReplayRows.size() << " rows replayed." << std::endl;
+    return true;
+}
+
+// scan the player store and write the rows in leaderboard order.
+// *** every change stamped before highWaterTime must be committed ***
+bool DbManager::writePlayerSnapshot(const std::string& path, uint64_t highWaterTime)
+{
+    struct SnapshotRow
+    {
+        uint64_t id;
+        PlayerRecord record;
+    };
+    std::vector<SnapshotRow> vecRows;
+    auto addRow = [&vecRows](const PlayerSnapshot& row) { vecRows.push_back(SnapshotRow{ row.id, PlayerRecord::pack(row, false, false) }); };
+
+    if (!m_pPlayerStore || !m_pPlayerStore->forEachPlayer(0, addRow))
+    {
+        return false;
+    }
+
+    std::sort(vecRows.begin(), vecRows.end(), [](const SnapshotRow& lhs, const SnapshotRow& rhs)
+        {
+            return Leaderboard::KeyLess()(Leaderboard::Key{ lhs.record.score, lhs.id }, Leaderboard::Key{ rhs.record.score, rhs.id });
+        });
+    PlayerSnapshotData data;
+    data.highWaterTime = highWaterTime;
+    data.vecIds.reserve(vecRows.size());
+    data.vecRecords.reserve(vecRows.size());
+    for (const SnapshotRow& row : vecRows)
+    {
+        data.vecIds.emplace_back(row.id);
+        data.vecRecords.emplace_back(row.record);
+    }
+    return player_snapshot::writeFile(path, data);
+}
+
+// read a single player row to load (lazy mode), PlayerManager inserts it.
+// never called under PlayerManager's player lock
+bool DbManager::loadPlayerBattles(uint64_t id, PlayerSnapshot& snapshot)
+{
+    return m_pPlayerStore && m_pPlayerStore->loadPlayer(id, snapshot);
+}
+
+// read many player rows with one prepared statement inside one read transaction (lazy mode, batch login)
+// returns the number of rows read, ids missing in db are skipped.
+// never called under PlayerManager's player lock
+size_t DbManager::loadPlayerBattlesBatch(const std::vector<uint64_t>& vecIds, std::vector<PlayerSnapshot>& vecRows)
+{
+    if (!m_pPlayerStore)
+    {
+        return 0;
+    }
+    return m_pPlayerStore->loadPlayers(vecIds, [&vecRows](const PlayerSnapshot& row) { vecRows.emplace_back(row); });
 }
 
 bool DbManager::isTableExists(const std::string tableName)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    DbStats::Scope scope(m_dbStats, DbStats::schema, &m_mutex);
 
     if (!m_dbHandler) 
     {
@@ -149,26 +536,23 @@ bool DbManager::isTableExists(const std::string tableName)
     }
 
     const char* sql = "SELECT name FROM sqlite_master WHERE type='table' AND name=?;";
-    sqlite3_stmt* stmt = nullptr;
     bool exists = false;
 
-    int rc = sqlite3_prepare_v2(m_dbHandler, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) 
+    sqlite3_stmt* stmt = _prepareStatementNoLock(sql);
+    if (!stmt) 
     {
         std::cerr << "DbManager::tableExists: Failed to prepare statement: " << sqlite3_errmsg(m_dbHandler) << std::endl;
-        // Y prepare ѡA]TO stmt QMz
-        if (stmt) sqlite3_finalize(stmt);
         return false;
     }
 
     sqlite3_bind_text(stmt, 1, tableName.c_str(), -1, SQLITE_STATIC);
 
-    if (sqlite3_step(stmt) == SQLITE_ROW) 
+    if (m_dbStats.sqliteStep(stmt) == SQLITE_ROW) 
     {
         exists = true; // FǰtAܪsb
     }
 
-    sqlite3_finalize(stmt); //  stmt 귽
+    _releaseStatementNoLock(stmt);
     return exists;
 }
 
@@ -189,6 +573,8 @@ bool DbManager::createTable(const std::string tableName)
     char* errMsg = nullptr;
     int rc = sqlite3_exec(m_dbHandler, itSql->second.c_str(), nullptr, nullptr, &errMsg);
 
+    // cached statements were compiled against the old schema
+    _finalizeStatementsNoLock();
     if (rc != SQLITE_OK)
     {
         std::cerr << "SQL error: " << errMsg << std::endl;
@@ -199,127 +585,787 @@ bool DbManager::createTable(const std::string tableName)
     return true;
 }
 
-uint64_t DbManager::insertPlayerBattles()
+// reserve count new player ids: [firstId, firstId + count)
+bool DbManager::reservePlayerIdBlock(uint64_t count, uint64_t& firstId)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pPlayerStore && m_pPlayerStore->reservePlayerIds(count, firstId);
+}
+
+bool DbManager::updatePlayerBattles(uint64_t id, uint32_t score, uint32_t wins)
+{
+    PlayerSnapshot snapshot;
+    snapshot.id = id;
+    snapshot.score = score;
+    snapshot.wins = wins;
+    snapshot.updatedTime = time_utils::getTimestampMS();
+    return updatePlayerBattlesBatch(std::vector<PlayerSnapshot>(1, snapshot)) == 1;
+}
+// write many player rows, returns the number of rows written: the rows from that index on were not
+// written and are left for the caller to retry
+size_t DbManager::updatePlayerBattlesBatch(const std::vector<PlayerSnapshot>& vecSnapshots)
+{
+    return m_pPlayerStore ? m_pPlayerStore->savePlayers(vecSnapshots) : 0;
+}
+
+// every committed player save is on disk, see IPlayerStore::sync
+bool DbManager::syncPlayerBattles()
+{
+    return m_pPlayerStore && m_pPlayerStore->sync();
+}
+
+bool DbManager::queryPlayerBattles(uint64_t id, uint32_t& score, uint32_t& wins, uint64_t& updateTime)
+{
+    PlayerSnapshot snapshot;
+    if (!m_pPlayerStore || !m_pPlayerStore->loadPlayer(id, snapshot))
+    {
+        return false;
+    }
+    score = snapshot.score;
+    wins = snapshot.wins;
+    updateTime = snapshot.updatedTime;
+    return true;
+}
+
+// one savepoint for the matches and their per-player index rows, all or nothing.
+// match ids continue from MAX(match_id); replayed matches that are already stored are skipped
+bool DbManager::insertMatchHistory(const std::vector<MatchRecord>& vecMatches)
+{
+    static const std::string sqlMatchChunk = makeInsertSql(SQL_INSERT_MATCH, SQL_INSERT_MATCH_ROW, MATCH_INSERT_ROWS);
+    static const std::string sqlMatchOne = makeInsertSql(SQL_INSERT_MATCH, SQL_INSERT_MATCH_ROW, 1);
+    static const std::string sqlParticipantChunk = makeInsertSql(SQL_INSERT_PARTICIPANT, SQL_INSERT_PARTICIPANT_ROW, PARTICIPANT_INSERT_ROWS);
+    static const std::string sqlParticipantOne = makeInsertSql(SQL_INSERT_PARTICIPANT, SQL_INSERT_PARTICIPANT_ROW, 1);
+
+    DbStats::Scope scope(m_dbStats, DbStats::insertMatches, &m_mutex);
 
     if (!m_dbHandler)
     {
-        std::cerr << "DbManager::tableExists: Database not open." << std::endl;
+        std::cerr << "DbManager::insertMatchHistory: Database not open." << std::endl;
         return false;
     }
+    if (sqlite3_exec(m_dbHandler, "SAVEPOINT insert_match_history;", nullptr, nullptr, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "DbManager::insertMatchHistory: " << sqlite3_errmsg(m_dbHandler) << std::endl;
+        return false;
+    }
+    uint64_t lastMatchId = 0;
+    sqlite3_stmt* stmt = _prepareStatementNoLock(SQL_MAX_MATCH_ID);
+    bool isOk = stmt && m_dbStats.sqliteStep(stmt) == SQLITE_ROW;
+    if (isOk)
+    {
+        lastMatchId = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+    }
+    _releaseStatementNoLock(stmt);
 
-    // SQL yyw idA SQLite ۰ʥͦ (] id O INTEGER PRIMARY KEY AUTOINCREMENT)
-    const char* sql =
-        "INSERT INTO player_battles (score, wins, updated_time) "
-        "VALUES (?, ?, ?);";
+    std::vector<const MatchRecord*> vecInsertMatches;
+    std::vector<uint64_t> vecMatchIds;
+    std::vector<std::pair<uint64_t, uint64_t>> vecParticipants;
+    std::vector<std::string> vecRosters;
+    for (const MatchRecord& match : vecMatches)
+    {
+        if (!isOk || (match.isReplayed && _isMatchStoredNoLock(match)))
+        {
+            continue;
+        }
+        vecInsertMatches.emplace_back(&match);
+        vecMatchIds.emplace_back(++lastMatchId);
+        for (const std::vector<uint64_t>& vecRoster : match.vecRosters)
+        {
+            vecRosters.emplace_back(joinRoster(vecRoster));
+            for (const uint64_t playerId : vecRoster)
+            {
+                vecParticipants.emplace_back(playerId, lastMatchId);
+            }
+        }
+    }
+    isOk = isOk && _insertRowsNoLock(vecInsertMatches.size(), MATCH_INSERT_ROWS, sqlMatchChunk, sqlMatchOne,
+        [&vecInsertMatches, &vecMatchIds, &vecRosters](sqlite3_stmt* stmt, size_t row, int param)
+        {
+            const MatchRecord& match = *vecInsertMatches[row];
+            sqlite3_bind_int64(stmt, param, static_cast<sqlite3_int64>(vecMatchIds[row]));
+            sqlite3_bind_int64(stmt, param + 1, static_cast<sqlite3_int64>(match.roomId));
+            sqlite3_bind_int64(stmt, param + 2, static_cast<sqlite3_int64>(match.battleTime));
+            sqlite3_bind_int(stmt, param + 3, static_cast<int>(match.tier));
+            sqlite3_bind_int(stmt, param + 4, match.winnerTeam);
+            const std::string& redRoster = vecRosters[row * battle_constant::TeamColor::Max + battle_constant::TeamColor::Red];
+            const std::string& blueRoster = vecRosters[row * battle_constant::TeamColor::Max + battle_constant::TeamColor::Blue];
+            sqlite3_bind_text(stmt, param + 5, redRoster.c_str(), static_cast<int>(redRoster.size()), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, param + 6, blueRoster.c_str(), static_cast<int>(blueRoster.size()), SQLITE_STATIC);
+        });
+    isOk = isOk && _insertRowsNoLock(vecParticipants.size(), PARTICIPANT_INSERT_ROWS, sqlParticipantChunk, sqlParticipantOne,
+        [&vecParticipants](sqlite3_stmt* stmt, size_t row, int param)
+        {
+            sqlite3_bind_int64(stmt, param, static_cast<sqlite3_int64>(vecParticipants[row].first));
+            sqlite3_bind_int64(stmt, param + 1, static_cast<sqlite3_int64>(vecParticipants[row].second));
+        });
 
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_dbHandler, sql, -1, &stmt, nullptr);
+    if (!isOk || m_dbStats.sqliteCommit(m_dbHandler, "RELEASE insert_match_history;") != SQLITE_OK)
+    {
+        std::cerr << "DbManager::insertMatchHistory: Failed to insert matches: " << sqlite3_errmsg(m_dbHandler) << std::endl;
+        sqlite3_exec(m_dbHandler, "ROLLBACK TO insert_match_history; RELEASE insert_match_history;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+}
 
-    if (rc != SQLITE_OK)
+// *** a replayed match has players (the results of resident players), a match without any is never stored twice ***
+bool DbManager::_isMatchStoredNoLock(const MatchRecord& match)
+{
+    uint64_t playerId = 0;
+    for (const std::vector<uint64_t>& vecRoster : match.vecRosters)
     {
-        std::cerr << "Failed to prepare insertNewPlayer statement: " << sqlite3_errmsg(m_dbHandler) << std::endl;
-        return 0;
+        if (!vecRoster.empty())
+        {
+            playerId = vecRoster.front();
+            break;
+        }
+    }
+    if (playerId == 0)
+    {
+        return false;
+    }
+    sqlite3_stmt* stmt = _prepareStatementNoLock(SQL_FIND_REPLAYED_MATCH);
+    if (!stmt)
+    {
+        return false;
     }
-    const uint32_t score = 0;
-	const uint32_t wins = 0;
-	const uint64_t updatedTime = time_utils::getTimestampMS(); // eɶW
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(playerId));
+    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(match.roomId));
+    sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(match.battleTime));
+    const bool isStored = (m_dbStats.sqliteStep(stmt) == SQLITE_ROW);
+    _releaseStatementNoLock(stmt);
+    return isStored;
+}
 
-    sqlite3_bind_int(stmt, 1, score);
-    sqlite3_bind_int(stmt, 2, wins);
-    sqlite3_bind_int64(stmt, 3, updatedTime);
+// newest first, through the per-player index; served by the read pool
+bool DbManager::queryMatchHistory(uint64_t playerId, uint32_t count, std::vector<MatchRecord>& vecMatches)
+{
+    DbStats::Scope scope(m_dbStats, DbStats::queryMatches);
+    vecMatches.clear();
+    ReadConnection* pReader = _acquireReader();
+    if (pReader)
+    {
+        const bool isOk = _queryMatchHistoryNoLock(pReader->handler, pReader->mapStatements, playerId, count, vecMatches);
+        _releaseReader(pReader);
+        return isOk;
+    }
+    scope.lock(m_mutex);
 
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt); // 槹ᥲMzyy
+    if (!m_dbHandler)
+    {
+        std::cerr << "DbManager::queryMatchHistory: Database not open." << std::endl;
+        return false;
+    }
+    return _queryMatchHistoryNoLock(m_dbHandler, m_mapStatements, playerId, count, vecMatches);
+}
 
-    if (rc != SQLITE_DONE)
+bool DbManager::_queryMatchHistoryNoLock(sqlite3* handler, std::unordered_map<std::string, sqlite3_stmt*>& mapStatements,
+    uint64_t playerId, uint32_t count, std::vector<MatchRecord>& vecMatches)
+{
+    sqlite3_stmt* stmt = _prepareStatementNoLock(handler, mapStatements, SQL_QUERY_MATCH_HISTORY);
+    if (!stmt)
     {
-        std::cerr << "Failed to insert new player: " << sqlite3_errmsg(m_dbHandler) << std::endl;
-        return 0;
+        std::cerr << "DbManager::queryMatchHistory: Failed to prepare statement: " << sqlite3_errmsg(handler) << std::endl;
+        return false;
     }
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(playerId));
+    sqlite3_bind_int(stmt, 2, static_cast<int>(count));
 
-    // \JAsͦ ID
-    uint64_t id = sqlite3_last_insert_rowid(m_dbHandler);
-    if (id == 0)
+    int rc = SQLITE_OK;
+    while ((rc = m_dbStats.sqliteStep(stmt)) == SQLITE_ROW)
     {
-        return 0;
+        MatchRecord match;
+        match.matchId = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+        match.roomId = static_cast<uint64_t>(sqlite3_column_int64(stmt, 1));
+        match.battleTime = static_cast<uint64_t>(sqlite3_column_int64(stmt, 2));
+        match.tier = static_cast<uint32_t>(sqlite3_column_int(stmt, 3));
+        match.winnerTeam = static_cast<uint8_t>(sqlite3_column_int(stmt, 4));
+        match.vecRosters[battle_constant::TeamColor::Red] = splitRoster(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5)));
+        match.vecRosters[battle_constant::TeamColor::Blue] = splitRoster(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6)));
+        vecMatches.emplace_back(std::move(match));
     }
-	PlayerManager::instance().syncPlayerFromDbNoLock(id, score, wins, updatedTime); // PB PlayerManager
-    return id;
+    _releaseStatementNoLock(stmt);
+    return rc == SQLITE_DONE;
 }
-bool DbManager::updatePlayerBattles(uint64_t id, uint32_t score, uint32_t wins)
+
+// count rows: full statements of chunkRows rows, the rest one row per statement.
+// bindRow(stmt, row, firstParam) binds one row starting at parameter firstParam
+bool DbManager::_insertRowsNoLock(size_t count, size_t chunkRows, const std::string& sqlChunk, const std::string& sqlOne,
+    const std::function<void(sqlite3_stmt*, size_t, int)>& bindRow)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t row = 0;
+    while (row < count)
+    {
+        const size_t rows = (count - row >= chunkRows) ? chunkRows : 1;
+        sqlite3_stmt* stmt = _prepareStatementNoLock((rows == 1) ? sqlOne.c_str() : sqlChunk.c_str());
+        if (!stmt)
+        {
+            return false;
+        }
+        const int paramsPerRow = sqlite3_bind_parameter_count(stmt) / static_cast<int>(rows);
+        for (size_t i = 0; i < rows; i++, row++)
+        {
+            bindRow(stmt, row, 1 + static_cast<int>(i) * paramsPerRow);
+        }
+        const bool isDone = (m_dbStats.sqliteStep(stmt) == SQLITE_DONE);
+        _releaseStatementNoLock(stmt);
+        if (!isDone)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DbManager::setStatementCacheEnabled(bool isEnabled)
+{
+    DbStats::Scope scope(m_dbStats, DbStats::admin, &m_mutex);
+
+    _closeReadPool();
+    _finalizeStatementsNoLock();
+    m_isStatementCacheEnabled = isEnabled;
+    _openReadPool(m_storageProfile);
+}
+
+void DbManager::setReadPoolEnabled(bool isEnabled)
+{
+    DbStats::Scope scope(m_dbStats, DbStats::admin, &m_mutex);
+
+    _closeReadPool();
+    m_isReadPoolEnabled = isEnabled;
+    _openReadPool(m_storageProfile);
+}
+
+// readers only make sense in WAL mode, with a rollback journal they would block (and be blocked by) the writer.
+// *** caller must hold m_mutex ***
+void DbManager::_openReadPool(db_constant::StorageProfile profile)
+{
+    const StorageProfileSettings& settings = STORAGE_PROFILE_SETTINGS[profile];
+    if (!m_dbHandler || !m_isReadPoolEnabled || std::string(settings.journalMode) != "WAL")
+    {
+        return;
+    }
+    const std::string sql =
+        "PRAGMA mmap_size = " + std::to_string(settings.mmapSize) + ";"
+        + "PRAGMA cache_size = -" + std::to_string(settings.cacheSizeKb) + ";";
+
+    std::lock_guard<std::mutex> lock(m_readPoolMutex);
+    for (size_t i = 0; i < db_constant::READ_CONNECTION_COUNT; i++)
+    {
+        std::unique_ptr<ReadConnection> pReader(new ReadConnection());
+        if (sqlite3_open_v2(m_dbName.c_str(), &pReader->handler, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK
+            || sqlite3_exec(pReader->handler, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "DbManager::_openReadPool: " << sqlite3_errmsg(pReader->handler) << std::endl;
+            sqlite3_close(pReader->handler);
+            break;
+        }
+        m_vecIdleReaders.emplace_back(pReader.get());
+        m_vecReadConnections.emplace_back(std::move(pReader));
+    }
+    m_isReadPoolOpen = !m_vecReadConnections.empty();
+}
+
+// waits until every reader is handed back, new reads fall back to m_dbHandler meanwhile.
+// *** caller must hold m_mutex ***
+void DbManager::_closeReadPool()
+{
+    std::unique_lock<std::mutex> lock(m_readPoolMutex);
+
+    m_isReadPoolOpen = false;
+    m_readPoolCv.wait(lock, [this]() { return m_vecIdleReaders.size() == m_vecReadConnections.size(); });
+    for (auto& pReader : m_vecReadConnections)
+    {
+        _finalizeStatementsNoLock(pReader->mapStatements);
+        sqlite3_close(pReader->handler);
+    }
+    m_vecReadConnections.clear();
+    m_vecIdleReaders.clear();
+}
+
+// nullptr: no pool, the read goes to m_dbHandler under m_mutex
+DbManager::ReadConnection* DbManager::_acquireReader()
+{
+    std::unique_lock<std::mutex> lock(m_readPoolMutex);
+
+    m_readPoolCv.wait(lock, [this]() { return !m_isReadPoolOpen || !m_vecIdleReaders.empty(); });
+    if (!m_isReadPoolOpen)
+    {
+        return nullptr;
+    }
+    ReadConnection* pReader = m_vecIdleReaders.back();
+    m_vecIdleReaders.pop_back();
+    return pReader;
+}
+
+void DbManager::_releaseReader(ReadConnection* pReader)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_readPoolMutex);
+        m_vecIdleReaders.emplace_back(pReader);
+    }
+    m_readPoolCv.notify_all();
+}
+
+// removes the matches of players [firstId, lastId] and their index rows, what a benchmark with its own players wrote
+bool DbManager::deleteMatchHistoryRange(uint64_t firstId, uint64_t lastId)
+{
+    DbStats::Scope scope(m_dbStats, DbStats::admin, &m_mutex);
 
     if (!m_dbHandler)
     {
-        std::cerr << "DbManager::tableExists: Database not open." << std::endl;
         return false;
     }
+    const std::string range = " BETWEEN " + std::to_string(firstId) + " AND " + std::to_string(lastId);
+    const std::string sql = "DELETE FROM match_history WHERE match_id IN (SELECT match_id FROM match_participants WHERE player_id" + range + ");"
+        + "DELETE FROM match_participants WHERE player_id" + range + ";";
+    return sqlite3_exec(m_dbHandler, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+}
 
-    // SQL yyG`N ? ǥPjwǤ@P
-    const char* sql = "UPDATE player_battles SET score = ?, wins = ?, updated_time = ? WHERE id = ?;";
+void DbManager::submitWrite(std::function<bool()> work, std::function<void(bool)> callback)
+{
+    if (!m_isWriterRunning.load())
+    {
+        // no writer (not connected yet / shutting down), run on the caller's thread
+        const bool isOk = work();
+        if (callback)
+        {
+            callback(isOk);
+        }
+        return;
+    }
+    WriteRequest* pRequest = new WriteRequest();
+    pRequest->work = std::move(work);
+    pRequest->callback = std::move(callback);
 
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_dbHandler, sql, -1, &stmt, nullptr);
+    WriteRequest* pHead = m_pWriteHead.load(std::memory_order_relaxed);
+    do
+    {
+        pRequest->pNext = pHead;
+    } while (!m_pWriteHead.compare_exchange_weak(pHead, pRequest));
 
-    if (rc != SQLITE_OK)
+    // the writer was stopped after the check above, its last drain may have missed this request
+    if (!m_isWriterRunning.load())
     {
-        std::cerr << "DbManager::updatePlayerBattles: Failed to prepare statement: " << sqlite3_errmsg(m_dbHandler) << std::endl;
-        return false;
+        _drainWrites();
+        return;
+    }
+    // only the empty -> non-empty transition can find the writer parked
+    if (!pHead)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_writerMutex);
+        }
+        m_writerCv.notify_one();
     }
+}
 
-    const uint64_t updatedTime = time_utils::getTimestampMS();
+std::future<bool> DbManager::submitWrite(std::function<bool()> work)
+{
+    std::shared_ptr<std::promise<bool>> pPromise = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = pPromise->get_future();
+    submitWrite(std::move(work), [pPromise](bool isOk) { pPromise->set_value(isOk); });
+    return result;
+}
 
-    sqlite3_bind_int(stmt, 1, score);
-    sqlite3_bind_int(stmt, 2, wins);
-    sqlite3_bind_int64(stmt, 3, updatedTime);
-    sqlite3_bind_int64(stmt, 4, id);
+// callback gets the number of committed rows, rows from that index on were not written
+void DbManager::updatePlayerBattlesAsync(std::vector<PlayerSnapshot> vecSnapshots, std::function<void(size_t)> callback)
+{
+    std::shared_ptr<std::vector<PlayerSnapshot>> pSnapshots = std::make_shared<std::vector<PlayerSnapshot>>(std::move(vecSnapshots));
+    std::shared_ptr<size_t> pSavedCount = std::make_shared<size_t>(0);
+    submitWrite(
+        [this, pSnapshots, pSavedCount]()
+        {
+            *pSavedCount = updatePlayerBattlesBatch(*pSnapshots);
+            return true;
+        },
+        [pSavedCount, callback](bool isOk)
+        {
+            if (callback)
+            {
+                callback(isOk ? *pSavedCount : 0);
+            }
+        });
+}
 
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt); // 槹ᥲMzyy
+// callback gets the first id of the committed block, 0 on failure
+void DbManager::reservePlayerIdBlockAsync(uint64_t count, std::function<void(uint64_t)> callback)
+{
+    std::shared_ptr<uint64_t> pFirstId = std::make_shared<uint64_t>(0);
+    submitWrite(
+        [this, count, pFirstId]() { return reservePlayerIdBlock(count, *pFirstId); },
+        [pFirstId, callback](bool isOk)
+        {
+            if (callback)
+            {
+                callback(isOk ? *pFirstId : 0);
+            }
+        });
+}
+
+// blocks until every write submitted before this call is committed (requests run in submit order).
+// *** never call from a write callback ***
+void DbManager::waitForWrites()
+{
+    submitWrite([]() { return true; }).wait();
+}
+
+// the copy itself runs in stepBackup. the destination skips syncs while copying (it is a temp file),
+// so the last step doesn't fsync under DbManager's lock; it is synced once before the rename
+bool DbManager::startBackup(const std::string& fileName)
+{
+    std::lock_guard<std::mutex> backupLock(m_backupMutex);
 
-    if (rc != SQLITE_DONE)
+    if (m_pBackup)
     {
-        std::cerr << "DbManager::updatePlayerBattles: Failed to save player: " << sqlite3_errmsg(m_dbHandler) << std::endl;
+        std::cerr << "DbManager::startBackup: A backup into '" << m_backupStats.fileName << "' is running." << std::endl;
+        return false;
+    }
+    const std::string tempPath = fileName + ".tmp";
+    std::remove(tempPath.c_str());
+    sqlite3* pDest = nullptr;
+    if (sqlite3_open(tempPath.c_str(), &pDest) != SQLITE_OK
+        || sqlite3_exec(pDest, "PRAGMA synchronous = OFF;", nullptr, nullptr, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "DbManager::startBackup: Can't open '" << tempPath << "': " << sqlite3_errmsg(pDest) << std::endl;
+        sqlite3_close(pDest);
+        return false;
+    }
+    sqlite3_backup* pBackup = nullptr;
+    int pageSize = 0;
+    {
+        DbStats::Scope scope(m_dbStats, DbStats::admin, &m_mutex);
+        if (m_dbHandler)
+        {
+            pBackup = sqlite3_backup_init(pDest, "main", m_dbHandler, "main");
+            sqlite3_stmt* stmt = nullptr;
+            if (sqlite3_prepare_v2(m_dbHandler, "PRAGMA page_size;", -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                pageSize = sqlite3_column_int(stmt, 0);
+            }
+            sqlite3_finalize(stmt);
+        }
+    }
+    if (!pBackup)
+    {
+        std::cerr << "DbManager::startBackup: Failed to start: " << sqlite3_errmsg(pDest) << std::endl;
+        sqlite3_close(pDest);
+        std::remove(tempPath.c_str());
         return false;
     }
 
+    m_pBackup = pBackup;
+    m_pBackupDest = pDest;
+    m_backupBeginTime = std::chrono::steady_clock::now();
+    DbBackupStats stats;
+    stats.isRunning = true;
+    stats.fileName = fileName;
+    stats.pageSize = static_cast<uint64_t>(pageSize);
+    stats.completed = m_backupStats.completed;
+    stats.failed = m_backupStats.failed;
+    m_backupStats = stats;
     return true;
 }
-bool DbManager::queryPlayerBattles(uint64_t id, uint32_t& score, uint32_t& wins, uint64_t& updateTime)
+
+// copies BACKUP_STEP_PAGES pages per step until BACKUP_TICK_BUDGET_MS is used, releasing DbManager's lock
+// between steps. a step is skipped while the db writer's transaction is open: sqlite would refuse it, and
+// waiting for the commit keeps uncommitted pages out of the copy. pages the writer changes later are
+// copied again by sqlite, the backup never restarts
+void DbManager::stepBackup()
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    std::lock_guard<std::mutex> backupLock(m_backupMutex);
 
-    if (!m_dbHandler)
+    if (!m_pBackup)
     {
-        std::cerr << "DbManager::tableExists: Database not open." << std::endl;
+        return;
+    }
+    const auto tickBeginTime = std::chrono::steady_clock::now();
+    const auto tickBudget = std::chrono::milliseconds(db_constant::BACKUP_TICK_BUDGET_MS);
+    int rc = SQLITE_OK;
+    while (std::chrono::steady_clock::now() - tickBeginTime < tickBudget)
+    {
+        const auto stepBeginTime = std::chrono::steady_clock::now();
+        {
+            DbStats::Scope scope(m_dbStats, DbStats::backupStep, &m_mutex);
+            if (!m_dbHandler)
+            {
+                rc = SQLITE_MISUSE;
+            }
+            else if (sqlite3_get_autocommit(m_dbHandler) == 0)
+            {
+                rc = SQLITE_BUSY;
+            }
+            else
+            {
+                rc = sqlite3_backup_step(m_pBackup, db_constant::BACKUP_STEP_PAGES);
+            }
+        }
+        const double stallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepBeginTime).count();
+        m_backupStats.maxStallMs = std::max(m_backupStats.maxStallMs, stallMs);
+        m_backupStats.steps++;
+        if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+        {
+            m_backupStats.busySteps++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (rc != SQLITE_OK)
+        {
+            break;
+        }
+    }
+
+    m_backupStats.totalPages = static_cast<uint64_t>(sqlite3_backup_pagecount(m_pBackup));
+    m_backupStats.copiedPages = m_backupStats.totalPages - static_cast<uint64_t>(sqlite3_backup_remaining(m_pBackup));
+    m_backupStats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_backupBeginTime).count();
+    if (rc == SQLITE_DONE)
+    {
+        _finishBackupNoLock(true);
+    }
+    else if (rc != SQLITE_OK && rc != SQLITE_BUSY && rc != SQLITE_LOCKED)
+    {
+        std::cerr << "DbManager::stepBackup: Backup failed: " << sqlite3_errstr(rc) << std::endl;
+        _finishBackupNoLock(false);
+    }
+}
+
+DbBackupStats DbManager::getBackupStats()
+{
+    std::lock_guard<std::mutex> backupLock(m_backupMutex);
+
+    return m_backupStats;
+}
+
+// a backup still running when the connection closes is dropped
+void DbManager::_abortBackup()
+{
+    std::lock_guard<std::mutex> backupLock(m_backupMutex);
+
+    if (m_pBackup)
+    {
+        _finishBackupNoLock(false);
+    }
+}
+
+// *** m_backupMutex must be held ***
+void DbManager::_finishBackupNoLock(bool isOk)
+{
+    int rc = SQLITE_OK;
+    {
+        DbStats::Scope scope(m_dbStats, DbStats::admin, &m_mutex);
+        rc = sqlite3_backup_finish(m_pBackup);
+    }
+    sqlite3_close(m_pBackupDest);
+    m_pBackup = nullptr;
+    m_pBackupDest = nullptr;
+    m_backupStats.isRunning = false;
+
+    const std::string tempPath = m_backupStats.fileName + ".tmp";
+    isOk = isOk && rc == SQLITE_OK && syncFile(tempPath);
+    if (isOk)
+    {
+        std::remove(m_backupStats.fileName.c_str());
+        isOk = std::rename(tempPath.c_str(), m_backupStats.fileName.c_str()) == 0;
+    }
+    if (!isOk)
+    {
+        std::remove(tempPath.c_str());
+        m_backupStats.failed++;
+        std::cerr << "DbManager::stepBackup: Backup into '" << m_backupStats.fileName << "' failed." << std::endl;
+        return;
+    }
+    m_backupStats.completed++;
+    std::cout << "DbManager::stepBackup: Backup '" << m_backupStats.fileName << "' done, " << m_backupStats.copiedPages << " pages in "
+        << m_backupStats.elapsedMs << " ms, max stall " << m_backupStats.maxStallMs << " ms." << std::endl;
+}
+
+void DbManager::_startWriter()
+{
+    if (m_isWriterRunning.exchange(true))
+    {
+        return;
+    }
+    m_writerThread = std::thread(&DbManager::_writerLoop, this);
+}
+
+// *** writer must be stopped, it saves through the store ***
+void DbManager::_closePlayerStore()
+{
+    if (m_pPlayerStore)
+    {
+        m_pPlayerStore->close();
+        m_pPlayerStore.reset();
+    }
+}
+
+// the first open of an empty sharded store copies player_battles of the game db into the shards,
+// the game db's rows are left as they are
+bool DbManager::_importPlayersIntoShards()
+{
+    ShardedPlayerStore* pShardedStore = dynamic_cast<ShardedPlayerStore*>(m_pPlayerStore.get());
+    if (!pShardedStore || pShardedStore->getMaxId() != 0)
+    {
+        return true;
+    }
+    // runs before ensureTableSchema: a fresh install has no player_battles yet, so nothing to import
+    if (!isTableExists("player_battles"))
+    {
+        return true;
+    }
+    SqlitePlayerStore sqliteStore(*this);
+    std::vector<PlayerSnapshot> vecRows;
+    size_t importedCount = 0;
+    bool isOk = true;
+    const bool isScanned = sqliteStore.forEachPlayer(0, [&](const PlayerSnapshot& row)
+        {
+            vecRows.emplace_back(row);
+            if (vecRows.size() >= db_constant::SAVE_BATCH_MAX_ROWS * pShardedStore->getShardCount())
+            {
+                isOk = isOk && (pShardedStore->savePlayers(vecRows) == vecRows.size());
+                importedCount += vecRows.size();
+                vecRows.clear();
+            }
+        });
+    isOk = isOk && isScanned && (pShardedStore->savePlayers(vecRows) == vecRows.size());
+    importedCount += vecRows.size();
+    if (!isOk)
+    {
+        std::cerr << "DbManager::connect: Failed to import players into the shards." << std::endl;
         return false;
     }
+    if (importedCount > 0)
+    {
+        std::cout << "DbManager::connect imported " << importedCount << " players into " << pShardedStore->getShardCount() << " shards." << std::endl;
+    }
+    return true;
+}
 
-    const char* sql = "SELECT score, wins, updated_time FROM player_battles WHERE id = ?;";
+void DbManager::_stopWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        m_isWriterRunning = false;
+    }
+    m_writerCv.notify_one();
+    if (m_writerThread.joinable())
+    {
+        m_writerThread.join();
+    }
+    // a request that raced with the stop is written on this thread
+    _drainWrites();
+}
 
-    sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(m_dbHandler, sql, -1, &stmt, nullptr);
+// drains the request stack until stopped; requests still queued at stop are written before the thread exits
+void DbManager::_writerLoop()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_writerMutex);
+            m_writerCv.wait(lock, [this]() { return m_pWriteHead.load() != nullptr || !m_isWriterRunning.load(); });
+        }
+        if (!_drainWrites())
+        {
+            return;
+        }
+    }
+}
 
-    if (rc != SQLITE_OK)
+// detaches the request stack and runs it in submit order on the calling thread, false when it was empty
+bool DbManager::_drainWrites()
+{
+    WriteRequest* pRequest = m_pWriteHead.exchange(nullptr);
+    if (!pRequest)
     {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_dbHandler) << std::endl;
         return false;
     }
+    // the stack is newest first, restore submit order
+    std::vector<WriteRequest*> vecRequests;
+    for (; pRequest; pRequest = pRequest->pNext)
+    {
+        vecRequests.emplace_back(pRequest);
+    }
+    std::reverse(vecRequests.begin(), vecRequests.end());
+    for (WriteRequest* pWriteRequest : vecRequests)
+    {
+        _runWriteRequest(pWriteRequest);
+    }
+    return true;
+}
+
+// every request commits its own savepoint, m_mutex is only held per statement group inside it,
+// so reads (and backup steps) get in between and never join an open writer transaction
+void DbManager::_runWriteRequest(WriteRequest* pRequest)
+{
+    bool isOk = false;
+    {
+        DbStats::Scope scope(m_dbStats, DbStats::writeRequest);
+        isOk = pRequest->work();
+    }
+    if (pRequest->callback)
+    {
+        pRequest->callback(isOk);
+    }
+    delete pRequest;
+}
 
-    sqlite3_bind_int64(stmt, 1, id);
+// statements are prepared once per connection and reused (reset + rebind), keyed by their sql text.
+// returns nullptr when the sql doesn't compile
+sqlite3_stmt* DbManager::_prepareStatementNoLock(const char* sql)
+{
+    return _prepareStatementNoLock(m_dbHandler, m_mapStatements, sql);
+}
 
-    rc = sqlite3_step(stmt);
+// same, for any connection with its own statement cache (the pooled readers)
+sqlite3_stmt* DbManager::_prepareStatementNoLock(sqlite3* handler, std::unordered_map<std::string, sqlite3_stmt*>& mapStatements, const char* sql)
+{
+    if (m_isStatementCacheEnabled)
+    {
+        auto itStmt = mapStatements.find(sql);
+        if (itStmt != mapStatements.end())
+        {
+            return itStmt->second;
+        }
+    }
+    sqlite3_stmt* stmt = nullptr;
+    if (m_dbStats.sqlitePrepare(handler, sql, &stmt) != SQLITE_OK)
+    {
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+    if (m_isStatementCacheEnabled)
+    {
+        mapStatements[sql] = stmt;
+    }
+    return stmt;
+}
 
-    if (rc == SQLITE_ROW)
+// hand a statement back after use: ready for the next bind, or finalized when the cache is off
+void DbManager::_releaseStatementNoLock(sqlite3_stmt* stmt)
+{
+    if (!stmt)
+    {
+        return;
+    }
+    if (!m_isStatementCacheEnabled)
     {
-        score = sqlite3_column_int(stmt, 0);
-        wins = sqlite3_column_int(stmt, 1);
-        updateTime = sqlite3_column_int64(stmt, 2);
         sqlite3_finalize(stmt);
-        return true;
+        return;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+// must run before the connection is closed and after any schema change
+void DbManager::_finalizeStatementsNoLock()
+{
+    _finalizeStatementsNoLock(m_mapStatements);
+}
+
+void DbManager::_finalizeStatementsNoLock(std::unordered_map<std::string, sqlite3_stmt*>& mapStatements)
+{
+    for (auto& itStmt : mapStatements)
+    {
+        sqlite3_finalize(itStmt.second);
     }
-    return false;
+    mapStatements.clear();
 }
\ No newline at end of file
@@ -2,14 +2,42 @@
 #ifndef DB_MANAGER_H
 #define DB_MANAGER_H
 
+#include "objects/player.h"
+#include "playerStore.h"
+#include "objects/matchRecord.h"
+#include "dbStats.h"
+#include "../include/globalDefine.h"
 #include <functional>
 #include <string>
 #include <vector>
 #include <memory>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <condition_variable>
+#include <chrono>
 
 struct sqlite3;
+struct sqlite3_stmt;
+struct sqlite3_backup;
+
+// progress of the running online backup, or of the last one when none runs
+struct DbBackupStats
+{
+    bool isRunning = false;
+    std::string fileName = "";
+    uint64_t totalPages = 0;
+    uint64_t copiedPages = 0;
+    uint64_t pageSize = 0;          // bytes
+    uint64_t steps = 0;
+    uint64_t busySteps = 0;         // skipped, the writer's transaction was open
+    double elapsedMs = 0;           // since start
+    double maxStallMs = 0;          // longest hold of DbManager's lock by one step
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+};
 
 class DbManager
 {
@@ -18,6 +46,16 @@ public:
 
     bool initialize();
     bool connect();
+    // the same on other files: dbName is the game db, storeFileName the player store's file (log) or shard prefix (sharded)
+    bool connect(const std::string& dbName, const std::string& storeFileName);
+    bool applyStorageProfile(db_constant::StorageProfile profile);
+    db_constant::StorageProfile getStorageProfile();
+    static const char* getStorageProfileName(db_constant::StorageProfile profile);
+    std::unique_ptr<IPlayerStore> createPlayerStore(db_constant::PlayerStoreBackend backend, const std::string& fileName);
+    static std::string getStorageProfileSql(db_constant::StorageProfile profile);
+    static bool syncCommittedNoLock(const std::string& dbFileName, db_constant::StorageProfile profile);
+    static bool syncFile(const std::string& path);
+    static bool replaceFile(const std::string& fromPath, const std::string& toPath);
     void release();
     void loadTableData();
     bool ensureTableSchema();
@@ -25,12 +63,47 @@ public:
     bool createTable(const std::string tableName);
 
     void syncAllPlayerBattles();
-    uint64_t insertPlayerBattles();
+    void syncAllPlayerIds();
+    bool syncPlayersFromSnapshot();
+    bool writePlayerSnapshot(const std::string& path, uint64_t highWaterTime);
+    bool loadPlayerBattles(uint64_t id, PlayerSnapshot& snapshot);
+    size_t loadPlayerBattlesBatch(const std::vector<uint64_t>& vecIds, std::vector<PlayerSnapshot>& vecRows);
+    bool reservePlayerIdBlock(uint64_t count, uint64_t& firstId);
     bool updatePlayerBattles(uint64_t id, uint32_t score, uint32_t wins);
+    size_t updatePlayerBattlesBatch(const std::vector<PlayerSnapshot>& vecSnapshots);
+    bool syncPlayerBattles();
     bool queryPlayerBattles(uint64_t id, uint32_t& score, uint32_t& wins, uint64_t& updateTime);
+    bool insertMatchHistory(const std::vector<MatchRecord>& vecMatches);
+    bool queryMatchHistory(uint64_t playerId, uint32_t count, std::vector<MatchRecord>& vecMatches);
+
+    // asynchronous writes: queued lock-free and executed in order by the db writer thread, each
+    // request commits on its own. work calls the synchronous methods above,
+    // callback runs on the writer thread after the commit (isOk: work succeeded and was committed).
+    // *** callbacks must not block or submit and wait on another write ***
+    void submitWrite(std::function<bool()> work, std::function<void(bool)> callback);
+    std::future<bool> submitWrite(std::function<bool()> work);
+    void updatePlayerBattlesAsync(std::vector<PlayerSnapshot> vecSnapshots, std::function<void(size_t)> callback);
+    void reservePlayerIdBlockAsync(uint64_t count, std::function<void(uint64_t)> callback);
+
+    void waitForWrites();
 
+    // online backup into fileName (written to fileName.tmp, renamed when complete), stepped by stepBackup
+    bool startBackup(const std::string& fileName);
+    void stepBackup();
+    DbBackupStats getBackupStats();
+
+    // latency histograms and slow operation log of the sqlite calls above
+    DbStats& getDbStats() { return m_dbStats; }
+
+    // benchmark helpers
+    void setStatementCacheEnabled(bool isEnabled);
+    void setReadPoolEnabled(bool isEnabled);
+    bool deleteMatchHistoryRange(uint64_t firstId, uint64_t lastId);
 
 private:
+    // the sqlite player store works on this connection, its read pool and statement cache
+    friend class SqlitePlayerStore;
+
     DbManager();
     ~DbManager();
 
@@ -39,11 +112,83 @@ private:
     DbManager(DbManager&&) = delete;
     DbManager& operator=(DbManager&&) = delete;
 
+    struct WriteRequest
+    {
+        std::function<bool()> work;
+        std::function<void(bool)> callback;
+        WriteRequest* pNext = nullptr;
+    };
+
+    // a pooled read-only connection, used by one thread at a time
+    struct ReadConnection
+    {
+        sqlite3* handler = nullptr;
+        std::unordered_map<std::string, sqlite3_stmt*> mapStatements{};
+    };
+
+    bool _applyStorageProfileNoLock(db_constant::StorageProfile profile);
+    void _openReadPool(db_constant::StorageProfile profile);
+    void _closeReadPool();
+    ReadConnection* _acquireReader();
+    void _releaseReader(ReadConnection* pReader);
+
+
+    void _startWriter();
+    void _stopWriter();
+    void _closePlayerStore();
+    bool _importPlayersIntoShards();
+    void _abortBackup();
+    void _finishBackupNoLock(bool isOk);
+    void _writerLoop();
+    bool _drainWrites();
+    void _runWriteRequest(WriteRequest* pRequest);
+
+    sqlite3_stmt* _prepareStatementNoLock(const char* sql);
+    sqlite3_stmt* _prepareStatementNoLock(sqlite3* handler, std::unordered_map<std::string, sqlite3_stmt*>& mapStatements, const char* sql);
+    void _releaseStatementNoLock(sqlite3_stmt* stmt);
+    bool _insertRowsNoLock(size_t count, size_t chunkRows, const std::string& sqlChunk, const std::string& sqlOne,
+        const std::function<void(sqlite3_stmt*, size_t, int)>& bindRow);
+    bool _isMatchStoredNoLock(const MatchRecord& match);
+    bool _queryMatchHistoryNoLock(sqlite3* handler, std::unordered_map<std::string, sqlite3_stmt*>& mapStatements,
+        uint64_t playerId, uint32_t count, std::vector<MatchRecord>& vecMatches);
+    void _finalizeStatementsNoLock();
+    static void _finalizeStatementsNoLock(std::unordered_map<std::string, sqlite3_stmt*>& mapStatements);
+
     sqlite3* m_dbHandler = nullptr;
     std::string m_dbName = "";
     std::unordered_map<std::string, std::function<void()>> m_mapFuncSyncData{};
+    // prepared statements of this connection, keyed by sql text
+    std::unordered_map<std::string, sqlite3_stmt*> m_mapStatements{};
+    bool m_isStatementCacheEnabled = true;
+    db_constant::StorageProfile m_storageProfile = db_constant::STORAGE_PROFILE;
+    // player rows, sqlite, log or sharded store (db_constant::PLAYER_STORE_BACKEND)
+    std::unique_ptr<IPlayerStore> m_pPlayerStore;
 
     std::mutex m_mutex;
+    DbStats m_dbStats{};
+
+    // read router: point reads go to an idle pooled connection, or to m_dbHandler when the pool is closed
+    std::vector<std::unique_ptr<ReadConnection>> m_vecReadConnections{};
+    std::vector<ReadConnection*> m_vecIdleReaders{};
+    bool m_isReadPoolOpen = false;
+    bool m_isReadPoolEnabled = true;
+    std::mutex m_readPoolMutex;             // never held across a query
+    std::condition_variable m_readPoolCv;
+
+    // write requests, newest first (Treiber stack), the writer thread detaches the whole stack at once
+    std::atomic<WriteRequest*> m_pWriteHead{ nullptr };
+    std::atomic<bool> m_isWriterRunning{ false };
+    std::thread m_writerThread;
+    std::mutex m_writerMutex;               // only to park the idle writer
+    std::condition_variable m_writerCv;
+
+    // online backup, source is m_dbHandler so the writer's commits never restart it.
+    // lock order: m_backupMutex, then m_mutex
+    sqlite3_backup* m_pBackup = nullptr;
+    sqlite3* m_pBackupDest = nullptr;
+    std::chrono::steady_clock::time_point m_backupBeginTime{};
+    DbBackupStats m_backupStats{};
+    std::mutex m_backupMutex;
 };
 
 #endif // DB_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,184 @@
+// @file  : dbStats.cpp
+// @brief : DbManager latency histograms and slow operation log
+// @author: August
+// @date  : 2026-10-19
+#include "dbStats.h"
+#include "../include/globalDefine.h"
+#include "../sqlite/sqlite3.h"
+#include "../utils/utils.h"
+#include <algorithm>
+
+namespace
+{
+    const char* const OPERATION_NAMES[DbStats::OperationMax] = {
+        "schema", "scanPlayers", "loadPlayer", "loadPlayers", "savePlayers", "reserveIds",
+        "insertMatches", "queryMatches", "writeRequest", "backupStep", "admin",
+    };
+    const char* const PHASE_NAMES[DbStats::PhaseMax] = { "lock wait", "prepare", "step", "commit" };
+
+    // the operation the calling thread is in and the phase time spent in it so far
+    struct ThreadOperation
+    {
+        int operation = -1;
+        uint64_t phaseNs[DbStats::PhaseMax]{};
+    };
+    thread_local ThreadOperation t_operation;
+
+    uint64_t getElapsedNs(std::chrono::steady_clock::time_point beginTime, std::chrono::steady_clock::time_point endTime)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - beginTime).count());
+    }
+}
+
+DbStats::DbStats()
+    : m_slowThresholdNs(static_cast<uint64_t>(db_constant::DB_SLOW_OPERATION_MS * 1000000.0))
+{
+}
+
+DbStats::Scope::Scope(DbStats& stats, Operation operation, std::mutex* pMutex)
+    : m_stats(stats), m_beginTime(std::chrono::steady_clock::now()), m_prevOperation(t_operation.operation)
+{
+    std::copy(t_operation.phaseNs, t_operation.phaseNs + PhaseMax, m_prevPhaseNs);
+    std::fill(t_operation.phaseNs, t_operation.phaseNs + PhaseMax, 0);
+    t_operation.operation = operation;
+    if (pMutex)
+    {
+        lock(*pMutex);
+    }
+}
+
+void DbStats::Scope::lock(std::mutex& mutex)
+{
+    const auto beginTime = std::chrono::steady_clock::now();
+    m_lock = std::unique_lock<std::mutex>(mutex);
+    m_stats._record(Phase::lockWait, beginTime);
+}
+
+// the lock is released after the end time is taken, so the total is wait + time under the lock
+DbStats::Scope::~Scope()
+{
+    const auto endTime = std::chrono::steady_clock::now();
+    if (m_lock.owns_lock())
+    {
+        m_lock.unlock();
+    }
+    const uint64_t totalNs = getElapsedNs(m_beginTime, endTime);
+    const Operation operation = static_cast<Operation>(t_operation.operation);
+    m_stats.m_totalHistograms[operation].record(totalNs);
+    const uint64_t slowThresholdNs = m_stats.m_slowThresholdNs.load(std::memory_order_relaxed);
+    if (slowThresholdNs > 0 && totalNs >= slowThresholdNs)
+    {
+        DbSlowOperation slowOperation;
+        slowOperation.timestamp = time_utils::getTimestampMS();
+        slowOperation.operation = getOperationName(operation);
+        slowOperation.totalMs = totalNs / 1000000.0;
+        slowOperation.lockWaitMs = t_operation.phaseNs[Phase::lockWait] / 1000000.0;
+        slowOperation.prepareMs = t_operation.phaseNs[Phase::prepare] / 1000000.0;
+        slowOperation.stepMs = t_operation.phaseNs[Phase::step] / 1000000.0;
+        slowOperation.commitMs = t_operation.phaseNs[Phase::commit] / 1000000.0;
+        m_stats._recordSlow(slowOperation);
+    }
+
+    // an outer operation's phases include this one's
+    for (int phase = 0; phase < PhaseMax; phase++)
+    {
+        t_operation.phaseNs[phase] += m_prevPhaseNs[phase];
+    }
+    t_operation.operation = m_prevOperation;
+}
+
+const char* DbStats::getOperationName(Operation operation)
+{
+    return (operation < OperationMax) ? OPERATION_NAMES[operation] : "unknown";
+}
+
+const char* DbStats::getPhaseName(Phase phase)
+{
+    return (phase < PhaseMax) ? PHASE_NAMES[phase] : "unknown";
+}
+
+int DbStats::sqliteStep(sqlite3_stmt* stmt)
+{
+    const auto beginTime = std::chrono::steady_clock::now();
+    const int rc = sqlite3_step(stmt);
+    _record(Phase::step, beginTime);
+    return rc;
+}
+
+int DbStats::sqlitePrepare(sqlite3* handler, const char* sql, sqlite3_stmt** pStmt)
+{
+    const auto beginTime = std::chrono::steady_clock::now();
+    const int rc = sqlite3_prepare_v2(handler, sql, -1, pStmt, nullptr);
+    _record(Phase::prepare, beginTime);
+    return rc;
+}
+
+int DbStats::sqliteCommit(sqlite3* handler, const char* sql)
+{
+    const auto beginTime = std::chrono::steady_clock::now();
+    const int rc = sqlite3_exec(handler, sql, nullptr, nullptr, nullptr);
+    _record(Phase::commit, beginTime);
+    return rc;
+}
+
+void DbStats::setSlowThresholdMs(double thresholdMs)
+{
+    m_slowThresholdNs.store(static_cast<uint64_t>(std::max(0.0, thresholdMs) * 1000000.0), std::memory_order_relaxed);
+}
+
+double DbStats::getSlowThresholdMs() const
+{
+    return m_slowThresholdNs.load(std::memory_order_relaxed) / 1000000.0;
+}
+
+// oldest first
+std::vector<DbSlowOperation> DbStats::getSlowOperations()
+{
+    std::lock_guard<std::mutex> lock(m_slowOperationsMutex);
+
+    std::vector<DbSlowOperation> vecSlowOperations(m_vecSlowOperations.begin() + m_slowOperationHead, m_vecSlowOperations.end());
+    vecSlowOperations.insert(vecSlowOperations.end(), m_vecSlowOperations.begin(), m_vecSlowOperations.begin() + m_slowOperationHead);
+    return vecSlowOperations;
+}
+
+void DbStats::reset()
+{
+    for (int operation = 0; operation < OperationMax; operation++)
+    {
+        for (LatencyHistogram& histogram : m_histograms[operation])
+        {
+            histogram.reset();
+        }
+        m_totalHistograms[operation].reset();
+    }
+    std::lock_guard<std::mutex> lock(m_slowOperationsMutex);
+
+    m_vecSlowOperations.clear();
+    m_slowOperationHead = 0;
+    m_slowOperationCount.store(0, std::memory_order_relaxed);
+}
+
+void DbStats::_record(Phase phase, std::chrono::steady_clock::time_point beginTime)
+{
+    if (t_operation.operation < 0)
+    {
+        return;
+    }
+    const uint64_t ns = getElapsedNs(beginTime, std::chrono::steady_clock::now());
+    t_operation.phaseNs[phase] += ns;
+    m_histograms[t_operation.operation][phase].record(ns);
+}
+
+void DbStats::_recordSlow(const DbSlowOperation& slowOperation)
+{
+    std::lock_guard<std::mutex> lock(m_slowOperationsMutex);
+
+    m_slowOperationCount.fetch_add(1, std::memory_order_relaxed);
+    if (m_vecSlowOperations.size() < db_constant::DB_SLOW_LOG_SIZE)
+    {
+        m_vecSlowOperations.emplace_back(slowOperation);
+        return;
+    }
+    m_vecSlowOperations[m_slowOperationHead] = slowOperation;
+    m_slowOperationHead = (m_slowOperationHead + 1) % m_vecSlowOperations.size();
+}
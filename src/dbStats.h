@@ -0,0 +1,113 @@
+// dbStats.h
+#ifndef DB_STATS_H
+#define DB_STATS_H
+
+#include "latencyHistogram.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// one DbManager call that took at least the slow threshold, times in ms
+struct DbSlowOperation
+{
+    uint64_t timestamp = 0;         // ms, when it finished
+    const char* operation = "";
+    double totalMs = 0;
+    double lockWaitMs = 0;
+    double prepareMs = 0;
+    double stepMs = 0;
+    double commitMs = 0;
+};
+
+// DbManager instrumentation: per operation, separate histograms of the wait for DbManager's lock and of the
+// prepare / step / commit time spent under it. an operation is a Scope on the calling thread, the sqlite
+// calls made inside it (prepare, step, commit wrappers below) are counted under that operation.
+// scopes nest: the inner one counts its own phases, the outer one the total
+class DbStats
+{
+public:
+    enum Operation : uint8_t
+    {
+        schema,
+        scanPlayers,
+        loadPlayer,
+        loadPlayers,
+        savePlayers,
+        reservePlayerIds,
+        insertMatches,
+        queryMatches,
+        writeRequest,
+        backupStep,
+        admin,
+        OperationMax
+    };
+    enum Phase : uint8_t
+    {
+        lockWait,
+        prepare,
+        step,
+        commit,
+        PhaseMax
+    };
+
+    // times the calling thread's operation; with pMutex the lock is taken (and its wait timed) here and held
+    // until the scope ends. lock() does the same later, for paths that only sometimes need DbManager's lock
+    class Scope
+    {
+    public:
+        Scope(DbStats& stats, Operation operation, std::mutex* pMutex = nullptr);
+        ~Scope();
+
+        void lock(std::mutex& mutex);
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        DbStats& m_stats;
+        std::unique_lock<std::mutex> m_lock;
+        std::chrono::steady_clock::time_point m_beginTime;
+        int m_prevOperation;
+        uint64_t m_prevPhaseNs[PhaseMax];
+    };
+
+    DbStats();
+
+    static const char* getOperationName(Operation operation);
+    static const char* getPhaseName(Phase phase);
+
+    // sqlite calls counted under the calling thread's operation (not counted outside a Scope)
+    int sqliteStep(sqlite3_stmt* stmt);
+    int sqlitePrepare(sqlite3* handler, const char* sql, sqlite3_stmt** pStmt);
+    int sqliteCommit(sqlite3* handler, const char* sql);
+
+    const LatencyHistogram& getHistogram(Operation operation, Phase phase) const { return m_histograms[operation][phase]; }
+    const LatencyHistogram& getTotalHistogram(Operation operation) const { return m_totalHistograms[operation]; }
+    void setSlowThresholdMs(double thresholdMs);
+    double getSlowThresholdMs() const;
+    std::vector<DbSlowOperation> getSlowOperations();
+    uint64_t getSlowOperationCount() const { return m_slowOperationCount.load(std::memory_order_relaxed); }
+    void reset();
+
+private:
+    void _record(Phase phase, std::chrono::steady_clock::time_point beginTime);
+    void _recordSlow(const DbSlowOperation& slowOperation);
+
+    LatencyHistogram m_histograms[OperationMax][PhaseMax];
+    LatencyHistogram m_totalHistograms[OperationMax];
+    std::atomic<uint64_t> m_slowThresholdNs{ 0 };
+
+    // ring of the last DB_SLOW_LOG_SIZE slow operations, only touched on the slow path
+    std::vector<DbSlowOperation> m_vecSlowOperations{};
+    size_t m_slowOperationHead = 0;
+    std::atomic<uint64_t> m_slowOperationCount{ 0 };
+    std::mutex m_slowOperationsMutex;
+};
+
+#endif // DB_STATS_H
@@ -0,0 +1,66 @@
+// @file  : latencyHistogram.cpp
+// @brief : lock free power-of-two latency histogram
+// @author: August
+// @date  : 2026-10-19
+#include "latencyHistogram.h"
+#include <algorithm>
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    uint64_t us = ns / 1000;
+    uint32_t bucket = 0;
+    while (us > 1 && bucket < BUCKET_COUNT - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sumNs.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t maxNs = m_maxNs.load(std::memory_order_relaxed);
+    while (ns > maxNs && !m_maxNs.compare_exchange_weak(maxNs, ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (std::atomic<uint64_t>& bucket : m_buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sumNs.store(0, std::memory_order_relaxed);
+    m_maxNs.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::getAverageUs() const
+{
+    const uint64_t count = getCount();
+    return (count > 0) ? m_sumNs.load(std::memory_order_relaxed) / 1000.0 / count : 0;
+}
+
+double LatencyHistogram::getMaxUs() const
+{
+    return m_maxNs.load(std::memory_order_relaxed) / 1000.0;
+}
+
+double LatencyHistogram::getPercentileUs(double percent) const
+{
+    const uint64_t count = getCount();
+    if (count == 0)
+    {
+        return 0;
+    }
+    const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(percent / 100.0 * count + 0.5));
+    uint64_t seen = 0;
+    for (uint32_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+    {
+        seen += m_buckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            return std::min(static_cast<double>(2ull << bucket), getMaxUs());
+        }
+    }
+    return getMaxUs();
+}
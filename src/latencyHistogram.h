@@ -0,0 +1,30 @@
+// latencyHistogram.h
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+
+// latency distribution in power-of-two microsecond buckets: bucket 0 is < 2 us, bucket i is [2^i, 2^(i+1)) us,
+// the last one also counts everything above. recording is a few relaxed atomic adds
+class LatencyHistogram
+{
+public:
+    static const uint32_t BUCKET_COUNT = 26;
+
+    void record(uint64_t ns);
+    void reset();
+    uint64_t getCount() const { return m_count.load(std::memory_order_relaxed); }
+    double getAverageUs() const;
+    double getMaxUs() const;
+    // upper bound of the bucket holding the percentile (0-100)
+    double getPercentileUs(double percent) const;
+
+private:
+    std::atomic<uint64_t> m_buckets[BUCKET_COUNT]{};
+    std::atomic<uint64_t> m_count{ 0 };
+    std::atomic<uint64_t> m_sumNs{ 0 };
+    std::atomic<uint64_t> m_maxNs{ 0 };
+};
+
+#endif // LATENCY_HISTOGRAM_H
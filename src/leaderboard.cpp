@@ -0,0 +1,395 @@
+// @file  : leaderboard.cpp
+// @brief : real-time leaderboard (rank / top N / page around player)
+// @author: August
+// @date  : 2026-10-19
+#include "leaderboard.h"
+#include <algorithm>
+
+namespace
+{
+    const size_t CHUNK_MAX_SIZE = 1024;         // a chunk is split in half above this size
+    const size_t CHUNK_BUILD_SIZE = 512;        // chunk size used when rebuilding from scratch
+    const size_t REBUILD_RATIO = 8;             // rebuild from scratch when a batch inserts >= 1/8 of the index
+}
+
+Leaderboard::Leaderboard()
+{
+}
+
+Leaderboard::~Leaderboard()
+{
+}
+
+void Leaderboard::addPlayer(uint64_t id, uint32_t score)
+{
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    m_vecPendingUpdates.push_back(PendingUpdate{ id, 0, score, true });
+    m_size++;
+}
+
+// bulk registration of new players (startup snapshot load), merged into the index right away.
+// keys already in KeyLess order skip the sort
+void Leaderboard::addSortedPlayers(std::vector<Key>&& vecSortedKeys)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    _applyPendingNoLock();
+
+    if (!std::is_sorted(vecSortedKeys.begin(), vecSortedKeys.end(), KeyLess()))
+    {
+        std::sort(vecSortedKeys.begin(), vecSortedKeys.end(), KeyLess());
+    }
+    m_size += vecSortedKeys.size();
+    _rebuildNoLock(std::vector<Key>(), vecSortedKeys);
+}
+
+// called on every battle result: only appends to the pending log
+void Leaderboard::updatePlayer(uint64_t id, uint32_t oldScore, uint32_t newScore)
+{
+    if (oldScore == newScore)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    m_vecPendingUpdates.push_back(PendingUpdate{ id, oldScore, newScore, false });
+}
+
+void Leaderboard::applyPending()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    _applyPendingNoLock();
+}
+
+void Leaderboard::clear()
+{
+    std::unique_lock<std::mutex> lockIndex(mutex, std::defer_lock);
+    std::unique_lock<std::mutex> lockPending(m_pendingMutex, std::defer_lock);
+    std::lock(lockIndex, lockPending);
+
+    m_vecChunks.clear();
+    m_vecChunkLast.clear();
+    m_vecFenwick.clear();
+    m_indexedKeys = 0;
+    m_vecPendingUpdates.clear();
+    m_size = 0;
+}
+
+uint64_t Leaderboard::getRankOfScore(uint32_t score)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    _applyPendingNoLock();
+    // id 0 is never used, so this key sorts before every player with the same score
+    return _positionNoLock(Key{ score, 0 }) + 1;
+}
+
+std::vector<LeaderboardEntry> Leaderboard::getTop(uint32_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    _applyPendingNoLock();
+
+    std::vector<LeaderboardEntry> vecEntries;
+    uint32_t lastScore = 0;
+    uint64_t lastRank = 0;
+    for (const auto& chunk : m_vecChunks)
+    {
+        for (const Key& key : chunk)
+        {
+            if (vecEntries.size() >= count)
+            {
+                return vecEntries;
+            }
+            vecEntries.emplace_back(_makeEntryNoLock(key, lastScore, lastRank));
+        }
+    }
+    return vecEntries;
+}
+
+std::vector<LeaderboardEntry> Leaderboard::getAround(uint64_t id, uint32_t score, uint32_t radius)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    _applyPendingNoLock();
+
+    std::vector<LeaderboardEntry> vecEntries;
+    if (m_vecChunks.empty())
+    {
+        return vecEntries;
+    }
+    const uint64_t position = _positionNoLock(Key{ score, id });
+    uint64_t offset = (position > radius) ? (position - radius) : 0;
+    const uint64_t count = (position - offset) + radius + 1;
+    if (offset >= m_indexedKeys)
+    {
+        return vecEntries;
+    }
+
+    size_t chunkIndex = _fenwickFindNoLock(offset);
+    uint32_t lastScore = 0;
+    uint64_t lastRank = 0;
+    for (; chunkIndex < m_vecChunks.size(); chunkIndex++, offset = 0)
+    {
+        const auto& chunk = m_vecChunks[chunkIndex];
+        for (size_t i = static_cast<size_t>(offset); i < chunk.size(); i++)
+        {
+            if (vecEntries.size() >= count)
+            {
+                return vecEntries;
+            }
+            vecEntries.emplace_back(_makeEntryNoLock(chunk[i], lastScore, lastRank));
+        }
+    }
+    return vecEntries;
+}
+
+// fold the pending log into the index.
+// updates of the same player are coalesced to (first old key, last new key), then erased and
+// inserted in key order so consecutive operations touch neighbouring chunks
+void Leaderboard::_applyPendingNoLock()
+{
+    std::vector<PendingUpdate> vecUpdates;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        if (m_vecPendingUpdates.empty())
+        {
+            return;
+        }
+        vecUpdates.swap(m_vecPendingUpdates);
+    }
+
+    std::vector<Key> vecEraseKeys;
+    std::vector<Key> vecInsertKeys;
+    const bool isOnlyAdds = std::all_of(vecUpdates.begin(), vecUpdates.end(),
+        [](const PendingUpdate& update) { return update.isNew; });
+    if (isOnlyAdds)
+    {
+        // ids are registered once, nothing to coalesce (startup load)
+        vecInsertKeys.reserve(vecUpdates.size());
+        for (const PendingUpdate& update : vecUpdates)
+        {
+            vecInsertKeys.push_back(Key{ update.newScore, update.id });
+        }
+    }
+    else
+    {
+        // stable sort by id keeps the per-player order of the log
+        std::stable_sort(vecUpdates.begin(), vecUpdates.end(),
+            [](const PendingUpdate& lhs, const PendingUpdate& rhs) { return lhs.id < rhs.id; });
+        for (size_t begin = 0; begin < vecUpdates.size(); )
+        {
+            size_t end = begin + 1;
+            while (end < vecUpdates.size() && vecUpdates[end].id == vecUpdates[begin].id)
+            {
+                end++;
+            }
+            const PendingUpdate& first = vecUpdates[begin];
+            const PendingUpdate& last = vecUpdates[end - 1];
+            if (!first.isNew)
+            {
+                vecEraseKeys.push_back(Key{ first.oldScore, first.id });
+            }
+            vecInsertKeys.push_back(Key{ last.newScore, last.id });
+            begin = end;
+        }
+    }
+    std::sort(vecEraseKeys.begin(), vecEraseKeys.end(), KeyLess());
+    std::sort(vecInsertKeys.begin(), vecInsertKeys.end(), KeyLess());
+
+    // large batches (startup load) are cheaper as one sorted rebuild
+    if (vecInsertKeys.size() * REBUILD_RATIO >= m_indexedKeys)
+    {
+        _rebuildNoLock(vecEraseKeys, vecInsertKeys);
+        return;
+    }
+    for (const Key& key : vecEraseKeys)
+    {
+        _eraseNoLock(key);
+    }
+    for (const Key& key : vecInsertKeys)
+    {
+        _insertNoLock(key);
+    }
+}
+
+void Leaderboard::_rebuildNoLock(const std::vector<Key>& vecEraseKeys, const std::vector<Key>& vecInsertKeys)
+{
+    // both inputs and every chunk are sorted: drop the erased keys, then merge the new ones
+    std::vector<Key> vecKeys;
+    vecKeys.reserve(m_indexedKeys + vecInsertKeys.size());
+    auto itErase = vecEraseKeys.begin();
+    for (const auto& chunk : m_vecChunks)
+    {
+        for (const Key& key : chunk)
+        {
+            while (itErase != vecEraseKeys.end() && KeyLess()(*itErase, key))
+            {
+                ++itErase;
+            }
+            if (itErase != vecEraseKeys.end() && itErase->score == key.score && itErase->id == key.id)
+            {
+                ++itErase;
+                continue;
+            }
+            vecKeys.push_back(key);
+        }
+    }
+    const size_t middle = vecKeys.size();
+    vecKeys.insert(vecKeys.end(), vecInsertKeys.begin(), vecInsertKeys.end());
+    std::inplace_merge(vecKeys.begin(), vecKeys.begin() + middle, vecKeys.end(), KeyLess());
+
+    m_vecChunks.clear();
+    m_vecChunks.reserve(vecKeys.size() / CHUNK_BUILD_SIZE + 1);
+    for (size_t begin = 0; begin < vecKeys.size(); begin += CHUNK_BUILD_SIZE)
+    {
+        const size_t end = std::min(begin + CHUNK_BUILD_SIZE, vecKeys.size());
+        m_vecChunks.emplace_back(vecKeys.begin() + begin, vecKeys.begin() + end);
+    }
+    m_indexedKeys = vecKeys.size();
+    _rebuildFenwickNoLock();
+}
+
+void Leaderboard::_insertNoLock(const Key& key)
+{
+    m_indexedKeys++;
+    if (m_vecChunks.empty())
+    {
+        m_vecChunks.emplace_back(1, key);
+        _rebuildFenwickNoLock();
+        return;
+    }
+    const size_t chunkIndex = _findChunkNoLock(key);
+    auto& chunk = m_vecChunks[chunkIndex];
+    chunk.insert(std::lower_bound(chunk.begin(), chunk.end(), key, KeyLess()), key);
+    m_vecChunkLast[chunkIndex] = chunk.back();
+    _fenwickAddNoLock(chunkIndex, 1);
+
+    if (chunk.size() > CHUNK_MAX_SIZE)
+    {
+        std::vector<Key> upperHalf(chunk.begin() + chunk.size() / 2, chunk.end());
+        chunk.resize(chunk.size() / 2);
+        m_vecChunks.insert(m_vecChunks.begin() + chunkIndex + 1, std::move(upperHalf));
+        _rebuildFenwickNoLock();
+    }
+}
+
+bool Leaderboard::_eraseNoLock(const Key& key)
+{
+    if (m_vecChunks.empty())
+    {
+        return false;
+    }
+    const size_t chunkIndex = _findChunkNoLock(key);
+    auto& chunk = m_vecChunks[chunkIndex];
+    auto it = std::lower_bound(chunk.begin(), chunk.end(), key, KeyLess());
+    if (it == chunk.end() || it->score != key.score || it->id != key.id)
+    {
+        return false;
+    }
+    chunk.erase(it);
+    m_indexedKeys--;
+    _fenwickAddNoLock(chunkIndex, -1);
+
+    if (chunk.empty())
+    {
+        m_vecChunks.erase(m_vecChunks.begin() + chunkIndex);
+        _rebuildFenwickNoLock();
+    }
+    else
+    {
+        m_vecChunkLast[chunkIndex] = chunk.back();
+    }
+    return true;
+}
+
+// first chunk whose last key is not before the key, or the last chunk
+size_t Leaderboard::_findChunkNoLock(const Key& key) const
+{
+    auto it = std::lower_bound(m_vecChunkLast.begin(), m_vecChunkLast.end(), key, KeyLess());
+    if (it == m_vecChunkLast.end())
+    {
+        return m_vecChunks.size() - 1;
+    }
+    return static_cast<size_t>(it - m_vecChunkLast.begin());
+}
+
+// number of keys ordered before the key
+uint64_t Leaderboard::_positionNoLock(const Key& key) const
+{
+    if (m_vecChunks.empty())
+    {
+        return 0;
+    }
+    const size_t chunkIndex = _findChunkNoLock(key);
+    const auto& chunk = m_vecChunks[chunkIndex];
+    const auto it = std::lower_bound(chunk.begin(), chunk.end(), key, KeyLess());
+    return _fenwickPrefixNoLock(chunkIndex) + static_cast<uint64_t>(it - chunk.begin());
+}
+
+// also refreshes m_vecChunkLast, called whenever chunks are added or removed
+void Leaderboard::_rebuildFenwickNoLock()
+{
+    m_vecChunkLast.resize(m_vecChunks.size());
+    m_vecFenwick.assign(m_vecChunks.size() + 1, 0);
+    for (size_t i = 1; i <= m_vecChunks.size(); i++)
+    {
+        m_vecChunkLast[i - 1] = m_vecChunks[i - 1].back();
+        m_vecFenwick[i] += m_vecChunks[i - 1].size();
+        const size_t parent = i + (i & (~i + 1));
+        if (parent <= m_vecChunks.size())
+        {
+            m_vecFenwick[parent] += m_vecFenwick[i];
+        }
+    }
+}
+
+void Leaderboard::_fenwickAddNoLock(size_t chunkIndex, int64_t delta)
+{
+    for (size_t i = chunkIndex + 1; i < m_vecFenwick.size(); i += (i & (~i + 1)))
+    {
+        m_vecFenwick[i] = static_cast<uint64_t>(static_cast<int64_t>(m_vecFenwick[i]) + delta);
+    }
+}
+
+// total size of the first chunkCount chunks
+uint64_t Leaderboard::_fenwickPrefixNoLock(size_t chunkCount) const
+{
+    uint64_t sum = 0;
+    for (size_t i = chunkCount; i > 0; i -= (i & (~i + 1)))
+    {
+        sum += m_vecFenwick[i];
+    }
+    return sum;
+}
+
+// chunk holding the 0-based position, position becomes the offset inside that chunk
+size_t Leaderboard::_fenwickFindNoLock(uint64_t& position) const
+{
+    size_t index = 0;
+    size_t step = 1;
+    while ((step << 1) < m_vecFenwick.size())
+    {
+        step <<= 1;
+    }
+    for (; step > 0; step >>= 1)
+    {
+        const size_t next = index + step;
+        if (next < m_vecFenwick.size() && m_vecFenwick[next] <= position)
+        {
+            index = next;
+            position -= m_vecFenwick[next];
+        }
+    }
+    return index;
+}
+
+LeaderboardEntry Leaderboard::_makeEntryNoLock(const Key& key, uint32_t& lastScore, uint64_t& lastRank) const
+{
+    // ranks only change between scores, look them up once per distinct score
+    if (lastRank == 0 || key.score != lastScore)
+    {
+        lastScore = key.score;
+        lastRank = _positionNoLock(Key{ key.score, 0 }) + 1;
+    }
+    LeaderboardEntry entry;
+    entry.rank = lastRank;
+    entry.id = key.id;
+    entry.score = key.score;
+    return entry;
+}
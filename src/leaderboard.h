@@ -0,0 +1,89 @@
+// leaderboard.h
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+struct LeaderboardEntry
+{
+    uint64_t rank = 0;      // 1 + number of players with a higher score (ties share a rank)
+    uint64_t id = 0;
+    uint32_t score = 0;
+};
+
+// order statistic index of every registered player, sorted by (score desc, id asc).
+// keys live in a list of small sorted chunks with a fenwick tree over the chunk sizes,
+// so rank / position lookups are O(log n) and memory is ~16 bytes per player.
+// writers only append to a pending log (O(1)), the log is folded into the index in sorted
+// batches by applyPending() and before every query, so queries always see every update
+class Leaderboard
+{
+public:
+    struct Key
+    {
+        uint32_t score;
+        uint64_t id;
+    };
+    struct KeyLess
+    {
+        bool operator()(const Key& lhs, const Key& rhs) const
+        {
+            if (lhs.score != rhs.score)
+            {
+                return lhs.score > rhs.score;
+            }
+            return lhs.id < rhs.id;
+        }
+    };
+
+    Leaderboard();
+    ~Leaderboard();
+
+    void addPlayer(uint64_t id, uint32_t score);
+    void addSortedPlayers(std::vector<Key>&& vecSortedKeys);
+    void updatePlayer(uint64_t id, uint32_t oldScore, uint32_t newScore);
+    void applyPending();
+    void clear();
+
+    uint64_t size() const { return m_size.load(); }
+    uint64_t getRankOfScore(uint32_t score);
+    std::vector<LeaderboardEntry> getTop(uint32_t count);
+    std::vector<LeaderboardEntry> getAround(uint64_t id, uint32_t score, uint32_t radius);
+
+    mutable std::mutex mutex;   // guards the index (chunks / fenwick)
+
+private:
+    struct PendingUpdate
+    {
+        uint64_t id;
+        uint32_t oldScore;
+        uint32_t newScore;
+        bool isNew;
+    };
+
+    void _applyPendingNoLock();
+    void _rebuildNoLock(const std::vector<Key>& vecEraseKeys, const std::vector<Key>& vecInsertKeys);
+    void _insertNoLock(const Key& key);
+    bool _eraseNoLock(const Key& key);
+    size_t _findChunkNoLock(const Key& key) const;
+    uint64_t _positionNoLock(const Key& key) const;
+    void _rebuildFenwickNoLock();
+    void _fenwickAddNoLock(size_t chunkIndex, int64_t delta);
+    uint64_t _fenwickPrefixNoLock(size_t chunkCount) const;
+    size_t _fenwickFindNoLock(uint64_t& position) const;
+    LeaderboardEntry _makeEntryNoLock(const Key& key, uint32_t& lastScore, uint64_t& lastRank) const;
+
+    std::vector<std::vector<Key>> m_vecChunks{};
+    std::vector<Key> m_vecChunkLast{};          // last key of every chunk, contiguous for the chunk search
+    std::vector<uint64_t> m_vecFenwick{};       // fenwick tree over m_vecChunks sizes
+    uint64_t m_indexedKeys = 0;
+
+    std::vector<PendingUpdate> m_vecPendingUpdates{};
+    std::mutex m_pendingMutex;                  // only guards m_vecPendingUpdates, never held while indexing
+    std::atomic<uint64_t> m_size{ 0 };
+};
+
+#endif // LEADERBOARD_H
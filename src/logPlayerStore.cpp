@@ -0,0 +1,512 @@
+// @file  : logPlayerStore.cpp
+// @brief : append-only player log with an in-memory index
+// @author: August
+// @date  : 2026-10-19
+#include "logPlayerStore.h"
+#include "dbManager.h"
+#include "../include/globalDefine.h"
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+namespace
+{
+    // not 0, so a zero-filled tail never passes as an entry
+    const uint32_t ENTRY_TYPE_PLAYER = 0x52594C50;
+    const uint32_t ENTRY_TYPE_NEXT_ID = 0x44494E58;
+    const size_t SCAN_CHUNK_ENTRIES = 32768;
+    const uint32_t FNV_OFFSET = 2166136261u;
+    const uint32_t FNV_PRIME = 16777619u;
+
+    bool isFileExists(const std::string& path)
+    {
+        return std::ifstream(path, std::ios::binary).good();
+    }
+}
+
+LogPlayerStore::LogPlayerStore(const std::string& fileName)
+    : m_fileName(fileName)
+{
+    static_assert(sizeof(LogEntry) == 32, "log entry must stay 32 bytes");
+}
+
+LogPlayerStore::~LogPlayerStore()
+{
+    close();
+}
+
+// rebuilds the index from the whole file; a torn tail is cut off by compacting before the first append
+bool LogPlayerStore::open()
+{
+    uint64_t fileSize = 0;
+    uint64_t validSize = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_isOpen)
+        {
+            return true;
+        }
+        // the log is replaced by the compacted file in one step, so next to a log the compacted file is
+        // an unfinished one. without a log it is complete (builds that removed the log before the rename)
+        const std::string compactPath = m_fileName + ".compact";
+        if (!isFileExists(m_fileName) && isFileExists(compactPath))
+        {
+            std::cerr << "LogPlayerStore::open: Recovering '" << m_fileName << "' from '" << compactPath << "'." << std::endl;
+            DbManager::replaceFile(compactPath, m_fileName);
+        }
+        std::remove(compactPath.c_str());
+        {
+            // creates the file when it doesn't exist yet
+            std::ofstream create(m_fileName, std::ios::binary | std::ios::app);
+            if (!create)
+            {
+                std::cerr << "LogPlayerStore::open: Can't create '" << m_fileName << "'." << std::endl;
+                return false;
+            }
+        }
+        std::ifstream source(m_fileName, std::ios::binary | std::ios::ate);
+        fileSize = static_cast<uint64_t>(source.tellg());
+        m_mapOffsets.clear();
+        m_nextId = 1;
+        validSize = _scanEntries(source, 0, fileSize, [this](uint64_t offset, const LogEntry& entry)
+            {
+                if (entry.type == ENTRY_TYPE_PLAYER)
+                {
+                    m_mapOffsets[entry.id] = offset;
+                    m_nextId = std::max(m_nextId, entry.id + 1);
+                }
+                else
+                {
+                    m_nextId = std::max(m_nextId, entry.id);
+                }
+            });
+
+        m_file.open(m_fileName, std::ios::binary | std::ios::in | std::ios::out);
+        if (!m_file)
+        {
+            std::cerr << "LogPlayerStore::open: Can't open '" << m_fileName << "'." << std::endl;
+            m_mapOffsets.clear();
+            return false;
+        }
+        m_fileSize = validSize;
+        m_isOpen = true;
+        m_isStopping = false;
+    }
+    if (validSize < fileSize)
+    {
+        std::cerr << "LogPlayerStore::open: Dropping " << (fileSize - validSize) << " bytes of torn tail from '" << m_fileName << "'." << std::endl;
+        compact();
+    }
+    m_compactThread = std::thread(&LogPlayerStore::_compactLoop, this);
+    return true;
+}
+
+void LogPlayerStore::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_isStopping = true;
+    }
+    m_compactCondition.notify_all();
+    if (m_compactThread.joinable())
+    {
+        m_compactThread.join();
+    }
+
+    std::lock_guard<std::mutex> compactLock(m_compactMutex);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_file.is_open())
+    {
+        m_file.close();
+    }
+    m_mapOffsets.clear();
+    m_fileSize = 0;
+    m_isOpen = false;
+    m_isCompactRequested = false;
+}
+
+// a sequential pass over the file that picks the newest entry of every player.
+// holds off compaction, not saves: entries appended meanwhile are not visited
+bool LogPlayerStore::forEachPlayer(uint64_t minUpdatedTime, const std::function<void(const PlayerSnapshot&)>& func)
+{
+    std::lock_guard<std::mutex> compactLock(m_compactMutex);
+
+    std::vector<uint64_t> vecOffsets;
+    uint64_t endOffset = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_isOpen)
+        {
+            std::cerr << "LogPlayerStore::forEachPlayer: Store not open." << std::endl;
+            return false;
+        }
+        m_file.flush();
+        vecOffsets.reserve(m_mapOffsets.size());
+        for (const auto& itOffset : m_mapOffsets)
+        {
+            vecOffsets.push_back(itOffset.second);
+        }
+        endOffset = m_fileSize;
+    }
+    std::sort(vecOffsets.begin(), vecOffsets.end());
+
+    std::ifstream source(m_fileName, std::ios::binary);
+    size_t index = 0;
+    PlayerSnapshot row;
+    _scanEntries(source, 0, endOffset, [&](uint64_t offset, const LogEntry& entry)
+        {
+            if (index < vecOffsets.size() && offset == vecOffsets[index])
+            {
+                index++;
+                if (entry.updatedTime >= minUpdatedTime)
+                {
+                    row.id = entry.id;
+                    row.score = entry.score;
+                    row.wins = entry.wins;
+                    row.updatedTime = entry.updatedTime;
+                    func(row);
+                }
+            }
+        });
+    if (index != vecOffsets.size())
+    {
+        std::cerr << "LogPlayerStore::forEachPlayer: '" << m_fileName << "' ended after " << index << " of " << vecOffsets.size() << " players." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool LogPlayerStore::loadPlayer(uint64_t id, PlayerSnapshot& snapshot)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto itOffset = m_mapOffsets.find(id);
+    LogEntry entry = {};
+    if (itOffset == m_mapOffsets.end() || !_readEntryNoLock(itOffset->second, entry))
+    {
+        return false;
+    }
+    snapshot.id = id;
+    snapshot.score = entry.score;
+    snapshot.wins = entry.wins;
+    snapshot.updatedTime = entry.updatedTime;
+    return true;
+}
+
+size_t LogPlayerStore::loadPlayers(const std::vector<uint64_t>& vecIds, const std::function<void(const PlayerSnapshot&)>& func)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t loadedCount = 0;
+    PlayerSnapshot snapshot;
+    LogEntry entry = {};
+    for (const uint64_t id : vecIds)
+    {
+        auto itOffset = m_mapOffsets.find(id);
+        if (itOffset != m_mapOffsets.end() && _readEntryNoLock(itOffset->second, entry))
+        {
+            snapshot.id = id;
+            snapshot.score = entry.score;
+            snapshot.wins = entry.wins;
+            snapshot.updatedTime = entry.updatedTime;
+            func(snapshot);
+            loadedCount++;
+        }
+    }
+    return loadedCount;
+}
+
+// one append for the whole batch, all or nothing
+size_t LogPlayerStore::savePlayers(const std::vector<PlayerSnapshot>& vecSnapshots)
+{
+    std::vector<LogEntry> vecEntries(vecSnapshots.size());
+    for (size_t i = 0; i < vecSnapshots.size(); i++)
+    {
+        LogEntry& entry = vecEntries[i];
+        entry.type = ENTRY_TYPE_PLAYER;
+        entry.id = vecSnapshots[i].id;
+        entry.score = vecSnapshots[i].score;
+        entry.wins = vecSnapshots[i].wins;
+        entry.updatedTime = vecSnapshots[i].updatedTime;
+        _sealEntry(entry);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint64_t firstOffset = m_fileSize;
+    if (!_appendNoLock(vecEntries))
+    {
+        std::cerr << "LogPlayerStore::savePlayers: Failed to append to '" << m_fileName << "'." << std::endl;
+        return 0;
+    }
+    for (size_t i = 0; i < vecEntries.size(); i++)
+    {
+        m_mapOffsets[vecEntries[i].id] = firstOffset + i * sizeof(LogEntry);
+        m_nextId = std::max(m_nextId, vecEntries[i].id + 1);
+    }
+    if (_isCompactionDueNoLock())
+    {
+        m_isCompactRequested = true;
+        m_compactCondition.notify_one();
+    }
+    return vecSnapshots.size();
+}
+
+// the new next id is logged before the block is handed out
+bool LogPlayerStore::reservePlayerIds(uint64_t count, uint64_t& firstId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<LogEntry> vecEntries(1);
+    LogEntry& entry = vecEntries[0];
+    entry.type = ENTRY_TYPE_NEXT_ID;
+    entry.id = m_nextId + count;
+    _sealEntry(entry);
+    if (!_appendNoLock(vecEntries))
+    {
+        std::cerr << "LogPlayerStore::reservePlayerIds: Failed to append to '" << m_fileName << "'." << std::endl;
+        return false;
+    }
+    firstId = m_nextId;
+    m_nextId += count;
+    return true;
+}
+
+// appends are only flushed to the os, this is the fsync behind them
+bool LogPlayerStore::sync()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_isOpen && DbManager::syncFile(m_fileName);
+}
+
+// live entries are copied in file order without blocking saves; entries appended meanwhile are
+// copied under the lock right before the new file replaces the old one
+bool LogPlayerStore::compact()
+{
+    std::lock_guard<std::mutex> compactLock(m_compactMutex);
+
+    std::vector<uint64_t> vecOffsets;
+    uint64_t endOffset = 0;
+    uint64_t nextId = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_isOpen)
+        {
+            return false;
+        }
+        m_file.flush();
+        vecOffsets.reserve(m_mapOffsets.size());
+        for (const auto& itOffset : m_mapOffsets)
+        {
+            vecOffsets.push_back(itOffset.second);
+        }
+        endOffset = m_fileSize;
+        nextId = m_nextId;
+    }
+    std::sort(vecOffsets.begin(), vecOffsets.end());
+
+    const std::string tempPath = m_fileName + ".compact";
+    std::ifstream source(m_fileName, std::ios::binary);
+    std::ofstream target(tempPath, std::ios::binary | std::ios::trunc);
+    std::unordered_map<uint64_t, uint64_t> mapOffsets;
+    mapOffsets.reserve(vecOffsets.size());
+
+    LogEntry nextIdEntry = {};
+    nextIdEntry.type = ENTRY_TYPE_NEXT_ID;
+    nextIdEntry.id = nextId;
+    _sealEntry(nextIdEntry);
+    target.write(reinterpret_cast<const char*>(&nextIdEntry), sizeof(nextIdEntry));
+    uint64_t targetOffset = sizeof(nextIdEntry);
+
+    size_t index = 0;
+    _scanEntries(source, 0, endOffset, [&](uint64_t offset, const LogEntry& entry)
+        {
+            if (index < vecOffsets.size() && offset == vecOffsets[index])
+            {
+                index++;
+                target.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+                mapOffsets[entry.id] = targetOffset;
+                targetOffset += sizeof(entry);
+            }
+        });
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_isOpen)
+    {
+        target.close();
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    m_file.flush();
+    source.clear();
+    _scanEntries(source, endOffset, m_fileSize, [&](uint64_t, const LogEntry& entry)
+        {
+            target.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+            if (entry.type == ENTRY_TYPE_PLAYER)
+            {
+                mapOffsets[entry.id] = targetOffset;
+            }
+            targetOffset += sizeof(entry);
+        });
+    target.flush();
+    if (index != vecOffsets.size() || !target)
+    {
+        std::cerr << "LogPlayerStore::compact: Failed to write '" << tempPath << "'." << std::endl;
+        target.close();
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    target.close();
+    // the old log may already be synced (sync() returned), the rows must stay on disk across the swap
+    if (!DbManager::syncFile(tempPath))
+    {
+        std::cerr << "LogPlayerStore::compact: Failed to sync '" << tempPath << "'." << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    source.close();
+    m_file.close();
+
+    if (!DbManager::replaceFile(tempPath, m_fileName))
+    {
+        std::cerr << "LogPlayerStore::compact: Failed to replace '" << m_fileName << "' with '" << tempPath << "', the store is closed." << std::endl;
+        m_isOpen = false;
+        return false;
+    }
+    m_file.open(m_fileName, std::ios::binary | std::ios::in | std::ios::out);
+    if (!m_file)
+    {
+        std::cerr << "LogPlayerStore::compact: Can't reopen '" << m_fileName << "', the store is closed." << std::endl;
+        m_isOpen = false;
+        return false;
+    }
+    m_mapOffsets.swap(mapOffsets);
+    m_fileSize = targetOffset;
+    return true;
+}
+
+uint64_t LogPlayerStore::getFileSize()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_fileSize;
+}
+
+uint64_t LogPlayerStore::getLiveSize()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return (m_mapOffsets.size() + 1) * sizeof(LogEntry);
+}
+
+void LogPlayerStore::_sealEntry(LogEntry& entry)
+{
+    entry.checksum = 0;
+    const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(&entry);
+    uint32_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < sizeof(entry); i++)
+    {
+        hash = (hash ^ pBytes[i]) * FNV_PRIME;
+    }
+    entry.checksum = hash;
+}
+
+bool LogPlayerStore::_isValidEntry(const LogEntry& entry)
+{
+    if (entry.type != ENTRY_TYPE_PLAYER && entry.type != ENTRY_TYPE_NEXT_ID)
+    {
+        return false;
+    }
+    LogEntry sealed = entry;
+    _sealEntry(sealed);
+    return sealed.checksum == entry.checksum;
+}
+
+// reads in chunks and stops at the first entry that is incomplete or fails its checksum
+uint64_t LogPlayerStore::_scanEntries(std::istream& stream, uint64_t beginOffset, uint64_t endOffset,
+    const std::function<void(uint64_t, const LogEntry&)>& func)
+{
+    std::vector<LogEntry> vecChunk(SCAN_CHUNK_ENTRIES);
+    uint64_t offset = beginOffset;
+    stream.seekg(static_cast<std::streamoff>(beginOffset));
+    while (stream && offset + sizeof(LogEntry) <= endOffset)
+    {
+        const uint64_t chunkEntries = std::min<uint64_t>(SCAN_CHUNK_ENTRIES, (endOffset - offset) / sizeof(LogEntry));
+        stream.read(reinterpret_cast<char*>(vecChunk.data()), static_cast<std::streamsize>(chunkEntries * sizeof(LogEntry)));
+        const uint64_t readEntries = static_cast<uint64_t>(stream.gcount()) / sizeof(LogEntry);
+        for (uint64_t i = 0; i < readEntries; i++)
+        {
+            if (!_isValidEntry(vecChunk[i]))
+            {
+                return offset;
+            }
+            func(offset, vecChunk[i]);
+            offset += sizeof(LogEntry);
+        }
+        if (readEntries < chunkEntries)
+        {
+            break;
+        }
+    }
+    return offset;
+}
+
+bool LogPlayerStore::_readEntryNoLock(uint64_t offset, LogEntry& entry)
+{
+    m_file.clear();
+    m_file.seekg(static_cast<std::streamoff>(offset));
+    return m_file.read(reinterpret_cast<char*>(&entry), sizeof(entry)) && _isValidEntry(entry);
+}
+
+// writes at m_fileSize, so a failed append is overwritten by the next one
+bool LogPlayerStore::_appendNoLock(const std::vector<LogEntry>& vecEntries)
+{
+    if (!m_isOpen)
+    {
+        return false;
+    }
+    m_file.clear();
+    m_file.seekp(static_cast<std::streamoff>(m_fileSize));
+    m_file.write(reinterpret_cast<const char*>(vecEntries.data()), static_cast<std::streamsize>(vecEntries.size() * sizeof(LogEntry)));
+    m_file.flush();
+    if (!m_file)
+    {
+        return false;
+    }
+    m_fileSize += vecEntries.size() * sizeof(LogEntry);
+    return true;
+}
+
+// at least PLAYER_LOG_COMPACT_MIN_BYTES and no more than half of it live
+bool LogPlayerStore::_isCompactionDueNoLock() const
+{
+    const uint64_t liveSize = (m_mapOffsets.size() + 1) * sizeof(LogEntry);
+    return !m_isCompactRequested
+        && m_fileSize >= db_constant::PLAYER_LOG_COMPACT_MIN_BYTES
+        && m_fileSize - liveSize >= liveSize;
+}
+
+void LogPlayerStore::_compactLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_compactCondition.wait(lock, [this]() { return m_isCompactRequested || m_isStopping; });
+        if (m_isStopping)
+        {
+            break;
+        }
+        lock.unlock();
+        compact();
+        lock.lock();
+        m_isCompactRequested = false;
+    }
+}
@@ -0,0 +1,80 @@
+// logPlayerStore.h
+#ifndef LOG_PLAYER_STORE_H
+#define LOG_PLAYER_STORE_H
+
+#include "playerStore.h"
+#include <string>
+#include <fstream>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// player rows in an append-only file of fixed-size checksummed entries: a save appends, it never
+// rewrites. an in-memory index points at the newest entry of every player, so a read is one seek.
+// stale entries are dropped by compaction on a background thread, which rewrites the live entries
+// into a new file while saves go on and swaps it in when it has caught up with them.
+// a torn tail (crash during an append) is cut off on open.
+// *** saves are flushed to the os, sync() puts them on disk ***
+class LogPlayerStore : public IPlayerStore
+{
+public:
+    explicit LogPlayerStore(const std::string& fileName);
+    ~LogPlayerStore();
+
+    bool open() override;
+    void close() override;
+    const char* getName() const override { return "log"; }
+
+    bool forEachPlayer(uint64_t minUpdatedTime, const std::function<void(const PlayerSnapshot&)>& func) override;
+    bool loadPlayer(uint64_t id, PlayerSnapshot& snapshot) override;
+    size_t loadPlayers(const std::vector<uint64_t>& vecIds, const std::function<void(const PlayerSnapshot&)>& func) override;
+    size_t savePlayers(const std::vector<PlayerSnapshot>& vecSnapshots) override;
+    bool reservePlayerIds(uint64_t count, uint64_t& firstId) override;
+    bool sync() override;
+
+    // rewrites the log with live entries only, on the caller's thread
+    bool compact();
+    uint64_t getFileSize();
+    uint64_t getLiveSize();
+
+private:
+    struct LogEntry
+    {
+        uint32_t type;
+        uint32_t checksum;      // fnv-1a of the entry with checksum = 0
+        uint64_t id;            // player id, or the next free id of a next-id entry
+        uint32_t score;
+        uint32_t wins;
+        uint64_t updatedTime;
+    };
+
+    static void _sealEntry(LogEntry& entry);
+    static bool _isValidEntry(const LogEntry& entry);
+    // calls func(offset, entry) for the entries in [beginOffset, endOffset), returns where the valid ones end
+    static uint64_t _scanEntries(std::istream& stream, uint64_t beginOffset, uint64_t endOffset,
+        const std::function<void(uint64_t, const LogEntry&)>& func);
+    bool _readEntryNoLock(uint64_t offset, LogEntry& entry);
+    bool _appendNoLock(const std::vector<LogEntry>& vecEntries);
+    bool _isCompactionDueNoLock() const;
+    void _compactLoop();
+
+    std::string m_fileName;
+    // guards the stream, the index and the sizes below
+    std::mutex m_mutex;
+    std::fstream m_file;
+    bool m_isOpen = false;
+    std::unordered_map<uint64_t, uint64_t> m_mapOffsets{};  // id -> offset of its newest entry
+    uint64_t m_fileSize = 0;
+    uint64_t m_nextId = 1;
+
+    // one compaction at a time; scans hold it too so the file isn't swapped under them.
+    // lock order: m_compactMutex before m_mutex
+    std::mutex m_compactMutex;
+    std::thread m_compactThread;
+    std::condition_variable m_compactCondition;
+    bool m_isCompactRequested = false;
+    bool m_isStopping = false;
+};
+
+#endif // LOG_PLAYER_STORE_H
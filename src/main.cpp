@@ -17,17 +17,40 @@
 #include "playerManager.h"
 #include "scheduleManager.h"
 #include "dbManager.h"
+#include "benchmark.h"
 #include "../utils/utils.h"
 
 std::atomic<bool> isRunning = true; // ROBzB檬A
 
 void commandThread();
 void listAllPlayers();
+void printLeaderboard(const std::vector<LeaderboardEntry>& vecEntries);
+void printPlayerDistribution(bool isByScore);
+void printDbStats();
 void simulatePlayers(uint32_t counts);
+void runBenchmark(const std::string& target, const std::string& argCount);
 void exitGame();
+static const std::string getStatusToString(common::PlayerStatus status);
 
-int main()
+int main(int argc, char* argv[])
 {
+    // player store conformance tests on temp files, the game is not started
+    if (argc > 1 && std::string(argv[1]) == "--test-stores")
+    {
+        return benchmark::testPlayerStores() ? 0 : 1;
+    }
+    // one benchmark on an empty game in temp files, the live db is not opened
+    if (argc > 1 && std::string(argv[1]) == "--bench")
+    {
+        if (!benchmark::openTempGame())
+        {
+            return 1;
+        }
+        runBenchmark((argc > 2) ? argv[2] : "", (argc > 3) ? argv[3] : "");
+        benchmark::closeTempGame();
+        return 0;
+    }
+
     std::srand(static_cast<unsigned int>(std::time(nullptr)));
 
     std::cout << "--- Game Match Demo Starting (Multithreaded Server) ---\n";
@@ -51,12 +74,6 @@ int main()
         return 1;
     }
 
-    if (!ScheduleManager::instance().initialize())
-    {
-        std::cerr << "Error: Failed to initialize ScheduleManager!\n";
-        return 1;
-    }
-
 	// connect to database
     if (DbManager::instance().connect() == false)
     {
@@ -71,6 +88,19 @@ int main()
     }
 	
     DbManager::instance().loadTableData();
+    // results after the last save, on top of the loaded players
+    if (PlayerManager::instance().openBattleJournal() == false)
+    {
+        std::cerr << "Error: Failed to open the battle journal!\n";
+        return 1;
+    }
+
+    // the save task checkpoints the journal, so it starts only once the replay is done
+    if (!ScheduleManager::instance().initialize())
+    {
+        std::cerr << "Error: Failed to initialize ScheduleManager!\n";
+        return 1;
+    }
 
 	BattleManager::instance().startMatchmaking(); // Ұʤǰt
 
@@ -97,17 +127,16 @@ void simulatePlayers(uint32_t counts)
 
     std::vector<uint64_t> vecLoggedInIds;
 
-    // Ҧaob
-    auto pMapAllPlayers = PlayerManager::instance().getAllPlayers();
-
     // @Ho@Ӥbuaid
-    uint64_t maxId = static_cast<uint64_t>(pMapAllPlayers->size());
+    // players may not be resident yet (lazy loading), pick out of the registered id set
+    std::vector<uint64_t> vecLoginIds = PlayerManager::instance().getRandomRegisteredPlayerIds(counts);
+    vecLoginIds.resize(counts, 0);
+    // the whole batch logs in under one player lock / one db pass
+    const std::vector<Player*> vecPlayers = PlayerManager::instance().playerLoginBatch(vecLoginIds);
     for (uint32_t i = 0; i < counts; i++)
     {
-        // o@H(1~maxID)
-        uint64_t playerId = random_utils::getRandom(maxId);
-        Player* pPlayer = nullptr;
-        pPlayer = PlayerManager::instance().playerLogin(playerId);
+        uint64_t playerId = vecLoginIds[i];
+        Player* pPlayer = vecPlayers[i];
         if (pPlayer)
         {
             if (pPlayer->isInLobby())
@@ -187,8 +216,38 @@ void commandThread()
             std::cout << "  <help>           : Display this help message.\n";
             std::cout << "  <list>           : List all players with their current status, score, tier, wins, and last update time.\n";
             std::cout << "  <queue>          : Display the current status of the team matchmaking queue and battle matchmaking queue.\n";
-            std::cout << "  <query ID>       : Query battle statistics for a specific player by their ID.\n";
+            std::cout << "  <query ID>       : Query battle statistics for a specific player by their ID (from memory when resident, else db).\n";
+            std::cout << "  <history ID [n]> : Display the last n matches of a player (default: 10).\n";
             std::cout << "  <start [count]>  : Simulate player logins and add them to the matchmaking queue. 'count' is optional (default: 1).\n";
+            std::cout << "  <cache [limit]>  : Display resident player cache stats. 'limit' sets the resident player budget.\n";
+            std::cout << "  <savestats>      : Display dirty player flush stats (avoided writes, rows per second, flush duration per tick).\n";
+            std::cout << "  <schedstats>     : Display scheduler task runs, skipped overlapping runs, lateness and execution time.\n";
+            std::cout << "  <snapshot>       : Write the binary player snapshot loaded at startup now.\n";
+            std::cout << "  <journal>        : Display battle journal stats (records per group commit, sync time, checkpoint).\n";
+            std::cout << "  <backup [file]>  : Start an online backup of the game db, copied in small steps on the scheduler.\n";
+            std::cout << "  <backupstats>    : Display online backup progress, throughput and the longest writer stall.\n";
+            std::cout << "  <dbstats [slow ms|reset]>: Display db lock wait / prepare / step / commit latency per operation and the slow operation log.\n";
+            std::cout << "                     'slow ms' sets the slow operation threshold (0: off), 'reset' clears the stats.\n";
+            std::cout << "  <rank ID>        : Display the global rank of a player.\n";
+            std::cout << "  <top [count]>    : Display the top players by score. 'count' is optional (default: 10).\n";
+            std::cout << "  <around ID [n]>  : Display the leaderboard page around a player, n ranks above and below (default: 5).\n";
+            std::cout << "  <dist [score]>   : Display player counts per tier and status. 'score' shows score buckets instead of tiers.\n";
+            std::cout << "  <bench login [count]> : Compare one-by-one and batch login of 'count' new and existing players (default: 1000).\n";
+            std::cout << "                          Runs on a temp game only: start the server with '--bench login [count]'.\n";
+            std::cout << "  <bench logout [count]>: Player saves written and avoided over login / battle / logout rounds of 'count' new players (default: 10000).\n";
+            std::cout << "                          Runs on a temp game only: start the server with '--bench logout [count]'.\n";
+            std::cout << "  <bench layout [count]>: Compare packed player records with the current player map on 'count' synthetic players (default: 100000000).\n";
+            std::cout << "  <bench stmt [count]>  : Per-row query / save cost without and with the prepared statement cache (default: 100000).\n";
+            std::cout << "                          Runs on a temp game only: start the server with '--bench stmt [count]'.\n";
+            std::cout << "  <bench storage [count]>: Save throughput and query latency under every storage profile (default: 100000 rows).\n";
+            std::cout << "                          Runs on a temp game only: start the server with '--bench storage [count]'.\n";
+            std::cout << "  <bench reads [count]> : Query latency during a 'count'-row flush, without and with the read pool (default: 100000 rows).\n";
+            std::cout << "                          Runs on a temp game only: start the server with '--bench reads [count]'.\n";
+            std::cout << "  <bench store [count]> : Save / load cost and conformance checks of every player store backend on 'count' synthetic players (default: 100000).\n";
+            std::cout << "                          Runs on a temp game only: start the server with '--bench store [count]'.\n";
+            std::cout << "  <bench journal [count]>: Durable battle results with one sync per battle and with group commit across rooms (default: 2000).\n";
+            std::cout << "  <bench history [count]>: Match history ingestion rate and last-matches query latency on 'count' synthetic matches (default: 100000).\n";
+            std::cout << "  <bench query [count]>  : Player query latency from memory and from db on 'count' resident players (default: 10000).\n";
             std::cout << "  <exit>           : Shut down the game demo.\n";
             std::cout << "--------------------------\n";
         }
@@ -280,21 +339,26 @@ void commandThread()
 
             try {
                 uint64_t playerId = std::stoull(arg);
-                uint32_t score = 0;
-                uint32_t wins = 0;
-                uint64_t updatedTime = 0;
+                PlayerSnapshot snapshot;
 
-                if (DbManager::instance().queryPlayerBattles(playerId, score, wins, updatedTime))
+                const auto beginTime = std::chrono::steady_clock::now();
+                const player_constant::PlayerQuerySource source = PlayerManager::instance().queryPlayer(playerId, snapshot);
+                const double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - beginTime).count();
+                if (source != player_constant::PlayerQuerySource::notFound)
                 {
                     std::cout << "\n----- Player Data (ID: " << playerId << ") -----\n";
                     std::cout << std::left << std::setw(10) << "Score"
                         << std::setw(10) << "Wins"
+                        << std::setw(15) << "Status"
                         << std::setw(25) << "Updated Time" << "\n";
                     std::cout << "---------------------------------------------------\n";
-                    std::cout << std::left << std::setw(10) << score
-                        << std::setw(10) << wins
-                        << std::setw(25) << time_utils::formatTimestampMs(updatedTime) << "\n";
+                    std::cout << std::left << std::setw(10) << snapshot.score
+                        << std::setw(10) << snapshot.wins
+                        << std::setw(15) << getStatusToString(snapshot.status)
+                        << std::setw(25) << time_utils::formatTimestampMs(snapshot.updatedTime) << "\n";
                     std::cout << "---------------------------------------------------\n";
+                    std::cout << "(from " << (source == player_constant::PlayerQuerySource::memory ? "memory" : "db") << ", "
+                        << std::fixed << std::setprecision(1) << elapsedUs << " us)\n" << std::defaultfloat << std::setprecision(6);
                 }
                 else
                 {
@@ -308,6 +372,64 @@ void commandThread()
                 std::cout << "Player ID '" << arg << "' is out of range.\n";
             }
         }
+        else if (command_name == "history")
+        {
+            std::string arg;
+            if (!(iss >> arg))
+            {
+                std::cout << "Usage: history <player_id> [count]\n";
+                continue;
+            }
+            uint32_t count = 10;
+            iss >> count;
+
+            try {
+                uint64_t playerId = std::stoull(arg);
+                std::vector<MatchRecord> vecMatches;
+                if (!DbManager::instance().queryMatchHistory(playerId, count, vecMatches) || vecMatches.empty())
+                {
+                    std::cout << "Player ID " << arg << " has no match history.\n";
+                    continue;
+                }
+                std::cout << "\n----- Match History (ID: " << playerId << ") -----\n";
+                std::cout << std::left << std::setw(10) << "Match"
+                    << std::setw(10) << "Room"
+                    << std::setw(6) << "Tier"
+                    << std::setw(25) << "Battle Time"
+                    << std::setw(8) << "Result"
+                    << "Red / Blue\n";
+                for (const MatchRecord& match : vecMatches)
+                {
+                    bool isWin = false;
+                    std::string rosters;
+                    for (uint8_t team = 0; team < battle_constant::TeamColor::Max; team++)
+                    {
+                        for (const uint64_t memberId : match.vecRosters[team])
+                        {
+                            isWin = isWin || (memberId == playerId && team == match.winnerTeam);
+                            rosters += std::to_string(memberId) + " ";
+                        }
+                        if (team + 1 < battle_constant::TeamColor::Max)
+                        {
+                            rosters += "/ ";
+                        }
+                    }
+                    std::cout << std::left << std::setw(10) << match.matchId
+                        << std::setw(10) << match.roomId
+                        << std::setw(6) << match.tier
+                        << std::setw(25) << time_utils::formatTimestampMs(match.battleTime)
+                        << std::setw(8) << (isWin ? "WIN" : "LOSE")
+                        << rosters << "\n";
+                }
+                std::cout << "---------------------------------------------------\n";
+            }
+            catch (const std::invalid_argument&) {
+                std::cout << "Invalid player ID format: '" << arg << "'. Please enter a valid number.\n";
+            }
+            catch (const std::out_of_range&) {
+                std::cout << "Player ID '" << arg << "' is out of range.\n";
+            }
+        }
         else if (command_name == "start")
         {
             int count = 1;
@@ -332,6 +454,219 @@ void commandThread()
             }
             simulatePlayers(count);
         }
+        else if (command_name == "cache")
+        {
+            std::string arg;
+            if (iss >> arg)
+            {
+                try {
+                    PlayerManager::instance().setResidentPlayerLimit(std::stoull(arg));
+                }
+                catch (const std::invalid_argument&) {
+                    std::cout << "Invalid limit format: '" << arg << "'. Please enter a valid number.\n";
+                    continue;
+                }
+                catch (const std::out_of_range&) {
+                    std::cout << "Limit '" << arg << "' is out of range.\n";
+                    continue;
+                }
+            }
+            const PlayerCacheStats stats = PlayerManager::instance().getPlayerCacheStats();
+            std::cout << "\n----- Player Cache -----\n";
+            std::cout << "  resident : " << stats.residentPlayers << " / " << stats.residentLimit << "\n";
+            std::cout << "  offline  : " << stats.offlinePlayers << "\n";
+            std::cout << "  hits     : " << stats.hits << "\n";
+            std::cout << "  misses   : " << stats.misses << "\n";
+            std::cout << "  evictions: " << stats.evictions << "\n";
+            std::cout << "------------------------\n";
+        }
+        else if (command_name == "snapshot")
+        {
+            const auto beginTime = std::chrono::steady_clock::now();
+            if (PlayerManager::instance().savePlayerSnapshot())
+            {
+                const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - beginTime).count();
+                std::cout << "Player snapshot '" << db_constant::PLAYER_SNAPSHOT_FILE << "' written in " << elapsedMs << " ms.\n";
+            }
+            else
+            {
+                std::cout << "Failed to write the player snapshot.\n";
+            }
+        }
+        else if (command_name == "backup")
+        {
+            std::string fileName = db_constant::BACKUP_FILE;
+            iss >> fileName;
+            if (DbManager::instance().startBackup(fileName))
+            {
+                std::cout << "Online backup into '" << fileName << "' started, see 'backupstats'.\n";
+            }
+            else
+            {
+                std::cout << "Failed to start the online backup.\n";
+            }
+        }
+        else if (command_name == "backupstats")
+        {
+            const DbBackupStats stats = DbManager::instance().getBackupStats();
+            const double copiedMb = stats.copiedPages * stats.pageSize / (1024.0 * 1024.0);
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << "\n----- Online Backup -----\n";
+            std::cout << "  file        : " << (stats.fileName.empty() ? "-" : stats.fileName) << (stats.isRunning ? " (running)" : "") << "\n";
+            std::cout << "  progress    : " << stats.copiedPages << " / " << stats.totalPages << " pages ("
+                << (stats.totalPages > 0 ? stats.copiedPages * 100.0 / stats.totalPages : 0) << "%)\n";
+            std::cout << "  throughput  : " << copiedMb << " MB in " << stats.elapsedMs << " ms ("
+                << (stats.elapsedMs > 0 ? copiedMb * 1000.0 / stats.elapsedMs : 0) << " MB/s)\n";
+            std::cout << "  steps       : " << stats.steps << " (" << stats.busySteps << " waited for the writer)\n";
+            std::cout << "  max stall   : " << stats.maxStallMs << " ms\n";
+            std::cout << "  backups     : " << stats.completed << " completed, " << stats.failed << " failed\n";
+            std::cout << "-------------------------\n";
+            std::cout << std::defaultfloat << std::setprecision(6);
+        }
+        else if (command_name == "journal")
+        {
+            const BattleJournalStats stats = PlayerManager::instance().getBattleJournalStats();
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << "\n----- Battle Journal -----\n";
+            std::cout << "  records     : " << stats.records << " in " << stats.syncs << " syncs ("
+                << (stats.syncs > 0 ? static_cast<double>(stats.records) / stats.syncs : 0) << " per sync)\n";
+            std::cout << "  seq         : last " << stats.lastSeq << ", durable " << stats.durableSeq << ", checkpoint " << stats.checkpointSeq << "\n";
+            std::cout << "  sync        : last " << stats.lastSyncMs << " ms, max " << stats.maxSyncMs << " ms\n";
+            std::cout << "  file        : " << stats.fileBytes << " bytes\n";
+            std::cout << "--------------------------\n";
+            std::cout << std::defaultfloat << std::setprecision(6);
+        }
+        else if (command_name == "schedstats")
+        {
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << "\n----- Scheduler Tasks (ms) -----\n";
+            std::cout << "  " << std::left << std::setw(14) << "task"
+                << std::setw(10) << "interval"
+                << std::setw(8) << "runs"
+                << std::setw(9) << "skipped"
+                << std::setw(26) << "late avg / p99 / max"
+                << "exec avg / p99 / max\n";
+            for (const ScheduleTaskStats& stats : ScheduleManager::instance().getTaskStats())
+            {
+                std::ostringstream late;
+                std::ostringstream exec;
+                late << std::fixed << std::setprecision(2) << stats.latenessAvgMs << " / " << stats.latenessP99Ms << " / " << stats.latenessMaxMs;
+                exec << std::fixed << std::setprecision(2) << stats.executionAvgMs << " / " << stats.executionP99Ms << " / " << stats.executionMaxMs;
+                std::cout << "  " << std::left << std::setw(14) << stats.name
+                    << std::setw(10) << (std::to_string(stats.intervalSeconds) + " s")
+                    << std::setw(8) << stats.runs
+                    << std::setw(9) << stats.skippedRuns
+                    << std::setw(26) << late.str()
+                    << exec.str() << (stats.isRunning ? "  (running)" : "") << "\n";
+            }
+            std::cout << "--------------------------------\n";
+            std::cout << std::defaultfloat << std::setprecision(6);
+        }
+        else if (command_name == "savestats")
+        {
+            const PlayerSaveStats stats = PlayerManager::instance().getPlayerSaveStats();
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << "\n----- Player Save -----\n";
+            std::cout << "  requests    : " << stats.requests << " (coalesced " << stats.coalescedRequests
+                << ", skipped unchanged " << stats.skippedRows << ", "
+                << (stats.requests > 0 ? (stats.coalescedRequests + stats.skippedRows) * 100.0 / stats.requests : 0) << "% avoided)\n";
+            std::cout << "  flushes     : " << stats.flushes << "\n";
+            std::cout << "  saved rows  : " << stats.savedRows << " (failed " << stats.failedRows << ")\n";
+            std::cout << "  last flush  : " << stats.lastRows << " rows in " << stats.lastDurationMs << " ms ("
+                << static_cast<uint64_t>(stats.lastRowsPerSecond) << " rows/s)\n";
+            std::cout << "  max flush   : " << stats.maxDurationMs << " ms\n";
+            std::cout << "-----------------------\n";
+            std::cout << std::defaultfloat << std::setprecision(6);
+        }
+        else if (command_name == "rank" || command_name == "top" || command_name == "around")
+        {
+            std::string arg;
+            std::string argCount;
+            const bool hasId = (command_name != "top");
+            if (hasId && !(iss >> arg))
+            {
+                std::cout << "Usage: " << command_name << " <player_id>" << (command_name == "around" ? " [n]" : "") << "\n";
+                continue;
+            }
+            iss >> argCount;
+
+            try {
+                const uint64_t playerId = hasId ? std::stoull(arg) : 0;
+                const uint32_t count = argCount.empty() ? (command_name == "top" ? 10 : 5) : static_cast<uint32_t>(std::stoul(argCount));
+                if (command_name == "rank")
+                {
+                    LeaderboardEntry entry;
+                    if (PlayerManager::instance().getPlayerRank(playerId, entry))
+                    {
+                        printLeaderboard(std::vector<LeaderboardEntry>{ entry });
+                    }
+                    else
+                    {
+                        std::cout << "Player ID " << arg << " not found.\n";
+                    }
+                }
+                else if (command_name == "top")
+                {
+                    printLeaderboard(PlayerManager::instance().getTopPlayers(count));
+                }
+                else
+                {
+                    printLeaderboard(PlayerManager::instance().getPlayersAroundPlayer(playerId, count));
+                }
+            }
+            catch (const std::invalid_argument&) {
+                std::cout << "Invalid number format. Please enter a valid number.\n";
+            }
+            catch (const std::out_of_range&) {
+                std::cout << "Number is out of range.\n";
+            }
+        }
+        else if (command_name == "bench")
+        {
+            std::string target;
+            std::string argCount;
+            iss >> target >> argCount;
+            // these create players or rewrite player rows, never on the live db
+            if (target == "login" || target == "logout" || target == "store" || target == "stmt"
+                || target == "storage" || target == "reads")
+            {
+                std::cout << "bench " << target << " runs on a temp game: start the server with --bench " << target << " [count]\n";
+                continue;
+            }
+            runBenchmark(target, argCount);
+        }
+        else if (command_name == "dbstats")
+        {
+            std::string arg;
+            iss >> arg;
+            DbStats& dbStats = DbManager::instance().getDbStats();
+            if (arg == "reset")
+            {
+                dbStats.reset();
+                std::cout << "DB stats cleared.\n";
+            }
+            else if (arg == "slow")
+            {
+                double thresholdMs = 0;
+                if (!(iss >> thresholdMs))
+                {
+                    std::cout << "Usage: dbstats slow <ms>\n";
+                    continue;
+                }
+                dbStats.setSlowThresholdMs(thresholdMs);
+                std::cout << "Slow operation threshold set to " << dbStats.getSlowThresholdMs() << " ms.\n";
+            }
+            else
+            {
+                printDbStats();
+            }
+        }
+        else if (command_name == "dist")
+        {
+            std::string arg;
+            iss >> arg;
+            printPlayerDistribution(arg == "score");
+        }
         else if (command_name == "exit")
         {
             exitGame();
@@ -345,6 +680,63 @@ void commandThread()
     std::cout << "Command thread ended.\n";
 }
 
+// runs one "bench" target, counts default per target
+void runBenchmark(const std::string& target, const std::string& argCount)
+{
+    try {
+        if (target == "login")
+        {
+            benchmark::runLogin(argCount.empty() ? 1000 : static_cast<uint32_t>(std::stoul(argCount)));
+        }
+        else if (target == "layout")
+        {
+            benchmark::runLayout(argCount.empty() ? 100000000 : std::stoull(argCount));
+        }
+        else if (target == "stmt")
+        {
+            benchmark::runStatementCache(argCount.empty() ? 100000 : static_cast<uint32_t>(std::stoul(argCount)));
+        }
+        else if (target == "storage")
+        {
+            benchmark::runStorageProfiles(argCount.empty() ? 100000 : static_cast<uint32_t>(std::stoul(argCount)));
+        }
+        else if (target == "reads")
+        {
+            benchmark::runReadPool(argCount.empty() ? 100000 : static_cast<uint32_t>(std::stoul(argCount)));
+        }
+        else if (target == "journal")
+        {
+            benchmark::runBattleJournal(argCount.empty() ? 2000 : static_cast<uint32_t>(std::stoul(argCount)));
+        }
+        else if (target == "history")
+        {
+            benchmark::runMatchHistory(argCount.empty() ? 100000 : static_cast<uint32_t>(std::stoul(argCount)));
+        }
+        else if (target == "query")
+        {
+            benchmark::runPlayerQuery(argCount.empty() ? 10000 : static_cast<uint32_t>(std::stoul(argCount)));
+        }
+        else if (target == "store")
+        {
+            benchmark::runPlayerStores(argCount.empty() ? 100000 : static_cast<uint32_t>(std::stoul(argCount)));
+        }
+        else if (target == "logout")
+        {
+            benchmark::runSaveAvoidance(argCount.empty() ? 10000 : static_cast<uint32_t>(std::stoul(argCount)));
+        }
+        else
+        {
+            std::cout << "Usage: bench <login|logout|layout|stmt|storage|reads|store|journal|history|query> [count]\n";
+        }
+    }
+    catch (const std::invalid_argument&) {
+        std::cout << "Invalid number format. Please enter a valid number.\n";
+    }
+    catch (const std::out_of_range&) {
+        std::cout << "Number is out of range.\n";
+    }
+}
+
 static const std::string getStatusToString(common::PlayerStatus status)
  {
     switch (status) 
@@ -370,37 +762,169 @@ static const std::string getStatusToString(common::PlayerStatus status)
 // CXҦaT
 void listAllPlayers()
 {
-    auto pMapPlayers = PlayerManager::instance().getAllPlayers();
-    if (pMapPlayers->empty())
+    bool isHeaderPrinted = false;
+    // snapshots are read without the player lock, battles keep running while we print
+    PlayerManager::instance().forEachPlayerSnapshot([&isHeaderPrinted](const PlayerSnapshot& snapshot)
+        {
+            if (!isHeaderPrinted)
+            {
+                isHeaderPrinted = true;
+                std::cout << "\n----- PLAYERS LIST -----\n";
+                std::cout << std::left << std::setw(10) << "ID"
+                    << std::setw(10) << "Score"
+                    << std::setw(10) << "Tier"
+                    << std::setw(10) << "Wins"
+                    << std::setw(15) << "Status" 
+                    << std::setw(25) << "Updated Time" << "\n"; 
+                std::cout << "------------------------------------------------------------------------------\n";
+            }
+            std::cout << std::left << std::setw(10) << snapshot.id
+                << std::setw(10) << snapshot.score
+                << std::setw(10) << Player::calcTier(snapshot.score)
+                << std::setw(10) << snapshot.wins
+                << std::setw(15) << getStatusToString(snapshot.status)
+                << std::setw(25) << time_utils::formatTimestampMs(snapshot.updatedTime) << "\n";
+        });
+
+    if (!isHeaderPrinted)
     {
         std::cout << "No players currently.\n";
         return;
     }
+    std::cout << "------------------------------------------------------------------------------\n";
+}
 
-    std::cout << "\n----- PLAYERS LIST -----\n";
-    std::cout << std::left << std::setw(10) << "ID"
+void printLeaderboard(const std::vector<LeaderboardEntry>& vecEntries)
+{
+    if (vecEntries.empty())
+    {
+        std::cout << "No players on the leaderboard.\n";
+        return;
+    }
+    std::cout << "\n----- LEADERBOARD -----\n";
+    std::cout << std::left << std::setw(10) << "Rank"
+        << std::setw(10) << "ID"
         << std::setw(10) << "Score"
-        << std::setw(10) << "Tier"
-        << std::setw(10) << "Wins"
-        << std::setw(15) << "Status" 
-        << std::setw(25) << "Updated Time" << "\n"; 
-    std::cout << "------------------------------------------------------------------------------\n";
+        << std::setw(10) << "Tier" << "\n";
+    std::cout << "----------------------------------------\n";
+    for (const auto& entry : vecEntries)
+    {
+        std::cout << std::left << std::setw(10) << entry.rank
+            << std::setw(10) << entry.id
+            << std::setw(10) << entry.score
+            << std::setw(10) << Player::calcTier(entry.score) << "\n";
+    }
+    std::cout << "----------------------------------------\n";
+}
 
-    for (const auto& itPlayer : *pMapPlayers)
+// one row per operation (total = lock wait + time under the lock), then its phases
+void printDbStats()
+{
+    DbStats& dbStats = DbManager::instance().getDbStats();
+    auto printRow = [](const char* operation, const char* phase, const LatencyHistogram& histogram)
     {
-        Player* pPlayer = itPlayer.second.get();
-        if (pPlayer)
+        std::cout << "  " << std::left << std::setw(15) << operation
+            << std::setw(11) << phase
+            << std::setw(10) << histogram.getCount()
+            << std::setw(11) << histogram.getAverageUs()
+            << std::setw(11) << histogram.getPercentileUs(50)
+            << std::setw(11) << histogram.getPercentileUs(99)
+            << histogram.getMaxUs() << "\n";
+    };
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "\n----- DB STATS (percentiles are bucket upper bounds) -----\n";
+    std::cout << "  " << std::left << std::setw(15) << "operation"
+        << std::setw(11) << "phase"
+        << std::setw(10) << "calls"
+        << std::setw(11) << "avg us"
+        << std::setw(11) << "p50 us"
+        << std::setw(11) << "p99 us"
+        << "max us\n";
+    for (int operation = 0; operation < DbStats::OperationMax; operation++)
+    {
+        const DbStats::Operation op = static_cast<DbStats::Operation>(operation);
+        if (dbStats.getTotalHistogram(op).getCount() == 0)
         {
-            std::cout << std::left << std::setw(10) << pPlayer->getId()
-                << std::setw(10) << pPlayer->getScore()
-                << std::setw(10) << pPlayer->getTier()
-                << std::setw(10) << pPlayer->getWins()
-                << std::setw(15) << getStatusToString(pPlayer->getStatus())
-                << std::setw(25) << time_utils::formatTimestampMs(pPlayer->getUpdatedTime()) << "\n";
+            continue;
+        }
+        printRow(DbStats::getOperationName(op), "total", dbStats.getTotalHistogram(op));
+        for (int phase = 0; phase < DbStats::PhaseMax; phase++)
+        {
+            const DbStats::Phase ph = static_cast<DbStats::Phase>(phase);
+            if (dbStats.getHistogram(op, ph).getCount() > 0)
+            {
+                printRow("", DbStats::getPhaseName(ph), dbStats.getHistogram(op, ph));
+            }
         }
     }
 
-    std::cout << "------------------------------------------------------------------------------\n";
+    const std::vector<DbSlowOperation> vecSlowOperations = dbStats.getSlowOperations();
+    std::cout << "\n  slow operations (>= " << dbStats.getSlowThresholdMs() << " ms): " << dbStats.getSlowOperationCount()
+        << ", last " << vecSlowOperations.size() << "\n";
+    for (const DbSlowOperation& slowOperation : vecSlowOperations)
+    {
+        std::cout << "  " << time_utils::formatTimestampMs(slowOperation.timestamp) << "  " << std::left << std::setw(15) << slowOperation.operation
+            << slowOperation.totalMs << " ms (lock wait " << slowOperation.lockWaitMs << ", prepare " << slowOperation.prepareMs
+            << ", step " << slowOperation.stepMs << ", commit " << slowOperation.commitMs << ")\n";
+    }
+    std::cout << "----------------------------------------------------------\n";
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// only tiers / buckets with players are printed
+void printPlayerDistribution(bool isByScore)
+{
+    const PlayerDistributionSnapshot snapshot = PlayerManager::instance().getPlayerDistribution();
+    const std::vector<StatusCounts>& vecRows = isByScore ? snapshot.vecScoreBuckets : snapshot.vecTiers;
+
+    std::cout << "\n----- PLAYER DISTRIBUTION -----\n";
+    std::cout << std::left << std::setw(12) << (isByScore ? "Score" : "Tier")
+        << std::setw(10) << "Offline"
+        << std::setw(10) << "Lobby"
+        << std::setw(10) << "Matching"
+        << std::setw(10) << "Fighting"
+        << std::setw(10) << "Total" << "\n";
+    std::cout << "--------------------------------------------------------------\n";
+    StatusCounts totals{};
+    for (size_t i = 0; i < vecRows.size(); i++)
+    {
+        const StatusCounts& counts = vecRows[i];
+        int64_t rowTotal = 0;
+        for (size_t status = 0; status < counts.size(); status++)
+        {
+            rowTotal += counts[status];
+            totals[status] += counts[status];
+        }
+        if (rowTotal == 0)
+        {
+            continue;
+        }
+        std::string label;
+        if (isByScore)
+        {
+            label = std::to_string(i * player_constant::DISTRIBUTION_SCORE_BUCKET_WIDTH) + ((i + 1 == vecRows.size()) ? "+" : "");
+        }
+        else
+        {
+            label = std::to_string(i + 1) + ((i + 1 == vecRows.size()) ? "+" : "");
+        }
+        std::cout << std::left << std::setw(12) << label;
+        for (const int64_t count : counts)
+        {
+            std::cout << std::setw(10) << count;
+        }
+        std::cout << std::setw(10) << rowTotal << "\n";
+    }
+    std::cout << "--------------------------------------------------------------\n";
+    std::cout << std::left << std::setw(12) << "Total";
+    int64_t total = 0;
+    for (const int64_t count : totals)
+    {
+        std::cout << std::setw(10) << count;
+        total += count;
+    }
+    std::cout << std::setw(10) << total << "\n";
 }
 
 // hXCAMzާ@
@@ -0,0 +1,20 @@
+// matchRecord.h
+#ifndef MATCH_RECORD_H
+#define MATCH_RECORD_H
+#include "../../include/globalDefine.h"
+#include <cstdint>
+#include <vector>
+
+// one finished battle as kept in match_history
+struct MatchRecord
+{
+    uint64_t matchId = 0;       // assigned by DbManager::insertMatchHistory, above every match_id in match_history
+    uint64_t roomId = 0;
+    uint64_t battleTime = 0;    // ms
+    uint32_t tier = 0;
+    uint8_t winnerTeam = 0;     // battle_constant::TeamColor
+    std::vector<uint64_t> vecRosters[battle_constant::TeamColor::Max];
+    bool isReplayed = false;    // queued again by a battle journal replay, may already be in match_history
+};
+
+#endif // MATCH_RECORD_H
@@ -18,33 +18,121 @@ Player::~Player()
 
 uint32_t Player::getTier() const
 {
-    return (m_score / 200) + 1; // hidden tier
+    return calcTier(getScore());
+}
+
+uint32_t Player::calcTier(uint32_t score)
+{
+    return (score / 200) + 1; // hidden tier
+}
+
+PlayerSnapshot Player::getSnapshot(uint32_t* pVersion) const
+{
+    PlayerSnapshot snapshot;
+    snapshot.id = m_id;
+    uint32_t seqBegin = 0;
+    uint32_t seqEnd = 0;
+    do
+    {
+        // seq_cst pairs with the seq_cst store in _endWrite and the dirty flag (see Player::markDirty)
+        seqBegin = m_seq.load();
+        if (seqBegin & 1)
+        {
+            continue;
+        }
+        snapshot.score = m_score.load(std::memory_order_relaxed);
+        snapshot.wins = m_wins.load(std::memory_order_relaxed);
+        snapshot.updatedTime = m_updatedTime.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        seqEnd = m_seq.load(std::memory_order_relaxed);
+    } while ((seqBegin & 1) || seqBegin != seqEnd);
+    snapshot.status = getStatus();
+    if (pVersion)
+    {
+        *pVersion = seqBegin / 2;
+    }
+    return snapshot;
+}
+
+void Player::applyBattleResult(uint32_t scoreDelta, bool isWin, uint64_t updatedTime)
+{
+    _beginWrite();
+    const uint32_t score = getScore();
+    if (isWin)
+    {
+        m_wins.store(getWins() + 1, std::memory_order_relaxed);
+        m_score.store(score + scoreDelta, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_score.store((score >= scoreDelta) ? (score - scoreDelta) : 0, std::memory_order_relaxed);
+    }
+    m_updatedTime.store(updatedTime, std::memory_order_relaxed);
+    _endWrite();
 }
 
 void Player::addScore(uint32_t scoreDelta)
 {
-    m_score += scoreDelta;
+    _beginWrite();
+    m_score.store(getScore() + scoreDelta, std::memory_order_relaxed);
+    _endWrite();
 }
 
 void Player::subScore(uint32_t scoreDelta)
 {
-    if (m_score >= scoreDelta)
+    _beginWrite();
+    const uint32_t score = getScore();
+    if (score >= scoreDelta)
     {
-        m_score -= scoreDelta;
+        m_score.store(score - scoreDelta, std::memory_order_relaxed);
     }
     else
     {
-        m_score = 0;
+        m_score.store(0, std::memory_order_relaxed);
 	}
+    _endWrite();
 }
 
 void Player::addWins()
 {
-    m_wins++;
+    _beginWrite();
+    m_wins.store(getWins() + 1, std::memory_order_relaxed);
+    _endWrite();
+}
+
+common::PlayerStatus Player::_exchangeStatus(common::PlayerStatus status)
+{
+    return m_status.exchange(status, std::memory_order_relaxed);
+}
+
+// wait-free: a writer never waits for readers, readers retry instead
+void Player::_beginWrite()
+{
+    m_seq.store(m_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void Player::_endWrite()
+{
+    m_seq.store(m_seq.load(std::memory_order_relaxed) + 1);
+}
+
+// returns true only for the clean -> dirty transition
+bool Player::markDirty()
+{
+    // already waiting for the flusher: a single atomic load.
+    // the flusher clears the flag before taking a snapshot, and both sides use seq_cst
+    // (_endWrite / this load, clearDirty / getSnapshot), so a change that sees the flag
+    // still set is always visible to that flusher's snapshot
+    if (m_isDirty.load())
+    {
+        return false;
+    }
+    return !m_isDirty.exchange(true);
 }
 
-void Player::setStatus(common::PlayerStatus status)
+void Player::clearDirty()
 {
-    m_status = status;
+    m_isDirty.store(false);
 }
 
@@ -3,6 +3,17 @@
 #define PLAYER_H
 #include "../../include/globalDefine.h"
 #include <cstdint>
+#include <atomic>
+
+// consistent copy of the persisted player state, read without any lock
+struct PlayerSnapshot
+{
+    uint64_t id = 0;
+    uint32_t score = 0;
+    uint32_t wins = 0;
+    uint64_t updatedTime = 0;
+    common::PlayerStatus status = common::PlayerStatus::offline;
+};
 
 class Player
 {
@@ -11,24 +22,67 @@ public:
     ~Player();
 
     uint64_t getId() const { return m_id; };
-    uint32_t getScore() const { return m_score; };
-    uint32_t getWins() const { return m_wins; };
+    uint32_t getScore() const { return m_score.load(std::memory_order_relaxed); };
+    uint32_t getWins() const { return m_wins.load(std::memory_order_relaxed); };
 	uint32_t getTier() const;
-    uint64_t getUpdatedTime() const { return m_updatedTime; };
-    common::PlayerStatus getStatus() const { return m_status; }
-    bool isInLobby() const { return (m_status == common::PlayerStatus::lobby); }
+    static uint32_t calcTier(uint32_t score);
+    uint64_t getUpdatedTime() const { return m_updatedTime.load(std::memory_order_relaxed); };
+    common::PlayerStatus getStatus() const { return m_status.load(std::memory_order_relaxed); }
+    bool isInLobby() const { return (getStatus() == common::PlayerStatus::lobby); }
+    // pVersion gets the mutation version the snapshot was taken at
+    PlayerSnapshot getSnapshot(uint32_t* pVersion = nullptr) const;
 
+    // *** writers of score / wins / updatedTime must be serialized (PlayerManager's player lock) ***
+    void applyBattleResult(uint32_t scoreDelta, bool isWin, uint64_t updatedTime);
     void addScore(uint32_t scoreDelta);
     void subScore(uint32_t scoreDelta);
     void addWins();
-    void setStatus(common::PlayerStatus status);
+
+    bool isDirty() const { return m_isDirty.load(); }
+    bool markDirty();
+    void clearDirty();
+    // a snapshot of the player is queued on / being written by the db writer thread
+    bool isSaving() const { return m_pendingSaves.load() > 0; }
+
+    // mutation version: bumped by every write of score / wins / updatedTime (half the seqlock counter).
+    // the persisted version is the one of the last row handed to the db, a save of an unchanged player is skipped
+    uint32_t getVersion() const { return m_seq.load() / 2; }
+    bool isPersisted(uint32_t version) const { return m_persistedVersion.load() == version; }
+    void setPersistedVersion(uint32_t version) { m_persistedVersion.store(version); }
+    // the row isn't in the db (new player) or its last write failed, the next save writes it
+    void clearPersistedVersion() { m_persistedVersion.store(NOT_PERSISTED); }
 
 private:
+    friend class PlayerManager;
+
+    // never a mutation version, those stay below 2^31
+    static const uint32_t NOT_PERSISTED = 0xFFFFFFFF;
+
+    // status changes go through PlayerManager::setPlayerStatus to keep the distribution counters in sync
+    common::PlayerStatus _exchangeStatus(common::PlayerStatus status);
+    void _beginWrite();
+    void _endWrite();
+
     uint64_t m_id = 0;
-    uint32_t m_score = 0;
-    uint32_t m_wins = 0;
-    uint64_t m_updatedTime = 0;
-    common::PlayerStatus m_status = common::PlayerStatus::offline;
+    // seqlock: odd while a write is in progress, readers retry until they see the same even value twice
+    std::atomic<uint32_t> m_seq{ 0 };
+    std::atomic<uint32_t> m_score{ 0 };
+    std::atomic<uint32_t> m_wins{ 0 };
+    std::atomic<uint64_t> m_updatedTime{ 0 };
+    std::atomic<common::PlayerStatus> m_status{ common::PlayerStatus::offline };
+
+    // intrusive links of PlayerManager's offline LRU list (guarded by the player map lock)
+    Player* m_pPrevOffline = nullptr;
+    Player* m_pNextOffline = nullptr;
+    bool m_isInOfflineLru = false;
+
+    // set once per flush cycle, the clean -> dirty transition links the player into PlayerManager's dirty list
+    std::atomic<bool> m_isDirty{ false };
+    Player* m_pNextDirty = nullptr;
+    // saves submitted but not yet committed, the player must stay resident until it drops to 0
+    std::atomic<uint16_t> m_pendingSaves{ 0 };
+    // a player is built from its db row, so it starts persisted at version 0
+    std::atomic<uint32_t> m_persistedVersion{ 0 };
 };
 
 #endif // !PLAYER_H
\ No newline at end of file
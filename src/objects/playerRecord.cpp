@@ -0,0 +1,47 @@
+// @file  : playerRecord.cpp
+// @brief : packed player record
+// @author: August
+// @date  : 2026-10-19
+#include "playerRecord.h"
+#include "../../include/globalDefine.h"
+
+PlayerRecord PlayerRecord::pack(const PlayerSnapshot& snapshot, bool isDirty, bool isOnline)
+{
+    PlayerRecord record;
+    record.score = snapshot.score;
+    record.wins = snapshot.wins;
+    // times before the epoch are clamped to it
+    const uint64_t relativeMs = (snapshot.updatedTime > player_constant::PLAYER_RECORD_EPOCH_MS) ? (snapshot.updatedTime - player_constant::PLAYER_RECORD_EPOCH_MS) : 0;
+    record.updatedSeconds = static_cast<uint32_t>(relativeMs / 1000);
+    record.updatedMilliseconds = static_cast<uint16_t>(relativeMs % 1000);
+    record.flags = static_cast<uint8_t>(snapshot.status & FLAG_STATUS_MASK);
+    if (isDirty)
+    {
+        record.flags |= FLAG_DIRTY;
+    }
+    if (isOnline)
+    {
+        record.flags |= FLAG_ONLINE;
+    }
+    return record;
+}
+
+PlayerSnapshot PlayerRecord::unpack(uint64_t id) const
+{
+    PlayerSnapshot snapshot;
+    snapshot.id = id;
+    snapshot.score = score;
+    snapshot.wins = wins;
+    snapshot.updatedTime = getUpdatedTime();
+    snapshot.status = getStatus();
+    return snapshot;
+}
+
+uint64_t PlayerRecord::getUpdatedTime() const
+{
+    if (updatedSeconds == 0 && updatedMilliseconds == 0)
+    {
+        return 0;
+    }
+    return player_constant::PLAYER_RECORD_EPOCH_MS + static_cast<uint64_t>(updatedSeconds) * 1000 + updatedMilliseconds;
+}
@@ -0,0 +1,34 @@
+// playerRecord.h
+#ifndef PLAYER_RECORD_H
+#define PLAYER_RECORD_H
+#include "player.h"
+#include <cstdint>
+
+// packed persisted state of one player: 16 bytes, 4 records per cache line.
+// the id is not stored, records live in tables indexed by player id.
+// updatedTime is kept as seconds + milliseconds since PLAYER_RECORD_EPOCH_MS (exact until 2156)
+struct alignas(16) PlayerRecord
+{
+    uint32_t score = 0;
+    uint32_t wins = 0;
+    uint32_t updatedSeconds = 0;
+    uint16_t updatedMilliseconds = 0;
+    uint8_t flags = 0;      // bit 0-1: common::PlayerStatus, bit 2: dirty, bit 3: online
+    uint8_t reserved = 0;
+
+    static const uint8_t FLAG_STATUS_MASK = 0x03;
+    static const uint8_t FLAG_DIRTY = 0x04;
+    static const uint8_t FLAG_ONLINE = 0x08;
+
+    static PlayerRecord pack(const PlayerSnapshot& snapshot, bool isDirty, bool isOnline);
+    PlayerSnapshot unpack(uint64_t id) const;
+
+    uint64_t getUpdatedTime() const;
+    common::PlayerStatus getStatus() const { return static_cast<common::PlayerStatus>(flags & FLAG_STATUS_MASK); }
+    bool isDirty() const { return (flags & FLAG_DIRTY) != 0; }
+    bool isOnline() const { return (flags & FLAG_ONLINE) != 0; }
+};
+
+static_assert(sizeof(PlayerRecord) == 16, "PlayerRecord must stay 16 bytes");
+
+#endif // PLAYER_RECORD_H
@@ -0,0 +1,97 @@
+// @file  : playerDistribution.cpp
+// @brief : live tier / score distribution of the registered players
+// @author: August
+// @date  : 2026-10-19
+#include "playerDistribution.h"
+#include "objects/player.h"
+#include <algorithm>
+
+PlayerDistribution::PlayerDistribution()
+{
+}
+
+PlayerDistribution::~PlayerDistribution()
+{
+}
+
+void PlayerDistribution::addPlayer(uint32_t score, common::PlayerStatus status)
+{
+    m_tierCounters[_tierIndex(score)][status].value.fetch_add(1, std::memory_order_relaxed);
+    m_scoreBucketCounters[_scoreBucketIndex(score)][status].value.fetch_add(1, std::memory_order_relaxed);
+}
+
+// bulk registration of count players with the same score
+void PlayerDistribution::addPlayers(uint32_t score, common::PlayerStatus status, int64_t count)
+{
+    m_tierCounters[_tierIndex(score)][status].value.fetch_add(count, std::memory_order_relaxed);
+    m_scoreBucketCounters[_scoreBucketIndex(score)][status].value.fetch_add(count, std::memory_order_relaxed);
+}
+
+void PlayerDistribution::movePlayer(uint32_t oldScore, common::PlayerStatus oldStatus, uint32_t newScore, common::PlayerStatus newStatus)
+{
+    const uint32_t oldTier = _tierIndex(oldScore);
+    const uint32_t newTier = _tierIndex(newScore);
+    if (oldTier != newTier || oldStatus != newStatus)
+    {
+        m_tierCounters[oldTier][oldStatus].value.fetch_sub(1, std::memory_order_relaxed);
+        m_tierCounters[newTier][newStatus].value.fetch_add(1, std::memory_order_relaxed);
+    }
+    const uint32_t oldBucket = _scoreBucketIndex(oldScore);
+    const uint32_t newBucket = _scoreBucketIndex(newScore);
+    if (oldBucket != newBucket || oldStatus != newStatus)
+    {
+        m_scoreBucketCounters[oldBucket][oldStatus].value.fetch_sub(1, std::memory_order_relaxed);
+        m_scoreBucketCounters[newBucket][newStatus].value.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void PlayerDistribution::clear()
+{
+    for (auto& counters : m_tierCounters)
+    {
+        for (auto& counter : counters)
+        {
+            counter.value = 0;
+        }
+    }
+    for (auto& counters : m_scoreBucketCounters)
+    {
+        for (auto& counter : counters)
+        {
+            counter.value = 0;
+        }
+    }
+}
+
+// counters are read one by one: a player moving during the read may be seen in both or neither cell
+PlayerDistributionSnapshot PlayerDistribution::getSnapshot() const
+{
+    PlayerDistributionSnapshot snapshot;
+    snapshot.vecTiers.resize(player_constant::DISTRIBUTION_TIER_COUNT);
+    for (uint32_t tier = 0; tier < player_constant::DISTRIBUTION_TIER_COUNT; tier++)
+    {
+        for (uint32_t status = 0; status < common::PLAYER_STATUS_COUNT; status++)
+        {
+            snapshot.vecTiers[tier][status] = m_tierCounters[tier][status].value.load(std::memory_order_relaxed);
+        }
+    }
+    snapshot.vecScoreBuckets.resize(player_constant::DISTRIBUTION_SCORE_BUCKET_COUNT);
+    for (uint32_t bucket = 0; bucket < player_constant::DISTRIBUTION_SCORE_BUCKET_COUNT; bucket++)
+    {
+        for (uint32_t status = 0; status < common::PLAYER_STATUS_COUNT; status++)
+        {
+            snapshot.vecScoreBuckets[bucket][status] = m_scoreBucketCounters[bucket][status].value.load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+uint32_t PlayerDistribution::_tierIndex(uint32_t score)
+{
+    return std::min(Player::calcTier(score), player_constant::DISTRIBUTION_TIER_COUNT) - 1;
+}
+
+uint32_t PlayerDistribution::_scoreBucketIndex(uint32_t score)
+{
+    return std::min(score / player_constant::DISTRIBUTION_SCORE_BUCKET_WIDTH, player_constant::DISTRIBUTION_SCORE_BUCKET_COUNT - 1);
+}
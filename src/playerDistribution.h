@@ -0,0 +1,48 @@
+// playerDistribution.h
+#ifndef PLAYER_DISTRIBUTION_H
+#define PLAYER_DISTRIBUTION_H
+
+#include "../include/globalDefine.h"
+#include <vector>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// player counts of one tier / score bucket, indexed by common::PlayerStatus
+typedef std::array<int64_t, common::PLAYER_STATUS_COUNT> StatusCounts;
+
+struct PlayerDistributionSnapshot
+{
+    std::vector<StatusCounts> vecTiers{};           // [tier - 1]
+    std::vector<StatusCounts> vecScoreBuckets{};    // [score / DISTRIBUTION_SCORE_BUCKET_WIDTH]
+};
+
+// live count of registered players per (tier, status) and (score bucket, status).
+// kept incrementally on every registration / status / score transition, reading it never walks the players.
+// every counter sits on its own cache line so threads moving players in different cells don't contend
+class PlayerDistribution
+{
+public:
+    PlayerDistribution();
+    ~PlayerDistribution();
+
+    void addPlayer(uint32_t score, common::PlayerStatus status);
+    void addPlayers(uint32_t score, common::PlayerStatus status, int64_t count);
+    void movePlayer(uint32_t oldScore, common::PlayerStatus oldStatus, uint32_t newScore, common::PlayerStatus newStatus);
+    void clear();
+    PlayerDistributionSnapshot getSnapshot() const;
+
+private:
+    struct alignas(64) PaddedCounter
+    {
+        std::atomic<int64_t> value{ 0 };
+    };
+
+    static uint32_t _tierIndex(uint32_t score);
+    static uint32_t _scoreBucketIndex(uint32_t score);
+
+    PaddedCounter m_tierCounters[player_constant::DISTRIBUTION_TIER_COUNT][common::PLAYER_STATUS_COUNT];
+    PaddedCounter m_scoreBucketCounters[player_constant::DISTRIBUTION_SCORE_BUCKET_COUNT][common::PLAYER_STATUS_COUNT];
+};
+
+#endif // PLAYER_DISTRIBUTION_H
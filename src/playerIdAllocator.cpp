@@ -0,0 +1,142 @@
+// @file  : playerIdAllocator.cpp
+// @brief : block based player id allocator
+// @author: August
+// @date  : 2026-10-19
+#include "playerIdAllocator.h"
+#include "dbManager.h"
+#include "../include/globalDefine.h"
+#include <iostream>
+#include <future>
+#include <memory>
+#include <vector>
+
+PlayerIdAllocator::PlayerIdAllocator()
+{
+}
+
+PlayerIdAllocator::~PlayerIdAllocator()
+{
+}
+
+// memory only, never waits for the db: returns 0 when the blocks ran dry (a refill is queued then),
+// callers that must not fail call waitForIds() first, outside of their own locks
+uint64_t PlayerIdAllocator::allocate()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        while (!m_dequeBlocks.empty())
+        {
+            IdBlock& block = m_dequeBlocks.front();
+            if (block.nextId < block.endId)
+            {
+                m_availableIdCount--;
+                return block.nextId++;
+            }
+            m_dequeBlocks.pop_front();
+        }
+    }
+    refill();
+    return 0;
+}
+
+// blocks until at least count ids are available (once per missing block, not per player).
+// returns false when a reservation failed
+bool PlayerIdAllocator::waitForIds(uint64_t count)
+{
+    while (true)
+    {
+        uint64_t missingIdCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (m_availableIdCount >= count)
+            {
+                return true;
+            }
+            missingIdCount = count - m_availableIdCount;
+        }
+        // background refill fell behind, wait for enough reservations of our own
+        const uint64_t blockCount = (missingIdCount + db_constant::PLAYER_ID_BLOCK_SIZE - 1) / db_constant::PLAYER_ID_BLOCK_SIZE;
+        std::vector<std::future<bool>> vecReserved;
+        for (uint64_t i = 0; i < blockCount; i++)
+        {
+            std::shared_ptr<std::promise<bool>> pPromise = std::make_shared<std::promise<bool>>();
+            vecReserved.emplace_back(pPromise->get_future());
+            _reserveBlockAsync([pPromise](bool isOk) { pPromise->set_value(isOk); });
+        }
+        for (std::future<bool>& reserved : vecReserved)
+        {
+            if (!reserved.get())
+            {
+                return false;
+            }
+        }
+    }
+}
+
+// background task: keep at least half a block plus a spare block available, counting queued reservations
+void PlayerIdAllocator::refill()
+{
+    const uint64_t targetIdCount = db_constant::PLAYER_ID_BLOCK_SIZE + db_constant::PLAYER_ID_BLOCK_SIZE / 2;
+    uint64_t blockCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const uint64_t expectedIdCount = m_availableIdCount + m_pendingBlockCount * db_constant::PLAYER_ID_BLOCK_SIZE;
+        if (expectedIdCount < targetIdCount)
+        {
+            blockCount = (targetIdCount - expectedIdCount + db_constant::PLAYER_ID_BLOCK_SIZE - 1) / db_constant::PLAYER_ID_BLOCK_SIZE;
+        }
+    }
+    for (uint64_t i = 0; i < blockCount; i++)
+    {
+        _reserveBlockAsync(nullptr);
+    }
+}
+
+void PlayerIdAllocator::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_dequeBlocks.clear();
+    m_availableIdCount = 0;
+}
+
+uint64_t PlayerIdAllocator::getAvailableIdCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_availableIdCount;
+}
+
+// the block is handed out only once its reservation is committed, callback runs on the db writer thread
+void PlayerIdAllocator::_reserveBlockAsync(std::function<void(bool)> callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingBlockCount++;
+    }
+    DbManager::instance().reservePlayerIdBlockAsync(db_constant::PLAYER_ID_BLOCK_SIZE,
+        [this, callback](uint64_t firstId)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_pendingBlockCount--;
+                if (firstId != 0)
+                {
+                    m_dequeBlocks.push_back(IdBlock{ firstId, firstId + db_constant::PLAYER_ID_BLOCK_SIZE });
+                    m_availableIdCount += db_constant::PLAYER_ID_BLOCK_SIZE;
+                }
+            }
+            if (firstId == 0)
+            {
+                std::cerr << "PlayerIdAllocator: Failed to reserve a player id block." << std::endl;
+            }
+            if (callback)
+            {
+                callback(firstId != 0);
+            }
+        });
+}
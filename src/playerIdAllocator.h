@@ -0,0 +1,42 @@
+// playerIdAllocator.h
+#ifndef PLAYER_ID_ALLOCATOR_H
+#define PLAYER_ID_ALLOCATOR_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+
+// hands out new player ids from ranges reserved in db (DbManager::reservePlayerIdBlockAsync).
+// refill() queues reservations on the db writer thread and keeps one spare block, so allocate() is
+// a memory-only operation that fails (returns 0) when the blocks run dry; waitForIds() is the only
+// call that waits for a reservation, it runs before the caller takes the player lock.
+// ids of a reserved block that are never used (crash / shutdown) are simply skipped
+class PlayerIdAllocator
+{
+public:
+    PlayerIdAllocator();
+    ~PlayerIdAllocator();
+
+    uint64_t allocate();
+    bool waitForIds(uint64_t count);
+    void refill();
+    void clear();
+    uint64_t getAvailableIdCount();
+
+private:
+    struct IdBlock
+    {
+        uint64_t nextId;
+        uint64_t endId;     // exclusive
+    };
+
+    void _reserveBlockAsync(std::function<void(bool)> callback);
+
+    std::deque<IdBlock> m_dequeBlocks{};
+    uint64_t m_availableIdCount = 0;
+    uint32_t m_pendingBlockCount = 0;   // reservations queued on the db writer
+    std::mutex m_mutex;     // never held across a db call
+};
+
+#endif // PLAYER_ID_ALLOCATOR_H
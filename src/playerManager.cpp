@@ -31,49 +31,196 @@ bool PlayerManager::initialize()
 {
     m_mapPlayers.clear();
     m_setOnlinePlayerIds.clear();
-    m_setDirtyPlayerIds.clear();
+    m_pDirtyHead = nullptr;
+    m_vecPlayerIdBits.clear();
+    m_setHighPlayerIds.clear();
+    m_registeredPlayerCount = 0;
+    m_leaderboard.clear();
+    m_playerDistribution.clear();
+    m_playerIdAllocator.clear();
+    m_pOfflineLruHead = nullptr;
+    m_pOfflineLruTail = nullptr;
+    m_offlineLruSize = 0;
     return true;
 }
 
 void PlayerManager::release()
 {
-    std::unique_lock<std::mutex> lockMapPlayers(m_mapPlayersMutex, std::defer_lock);
-    std::unique_lock<std::mutex> lockSetdirtyPlayerIds(m_setdirtyPlayerIdsMutex, std::defer_lock);
-    std::lock(lockMapPlayers, lockSetdirtyPlayerIds);
+    // flush what is dirty so the journal is not the only copy of the latest results,
+    // the save callbacks hold player pointers and checkpoint the journal, wait for them first
+    saveDirtyPlayers();
+    DbManager::instance().waitForWrites();
+    // results whose save failed stay in the journal and are replayed on the next start
+    m_battleJournal.close();
+
+    std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
 
     m_setOnlinePlayerIds.clear();
+    m_pDirtyHead = nullptr;
     m_mapPlayers.clear();
-	m_setDirtyPlayerIds.clear();
+    m_vecPlayerIdBits.clear();
+    m_setHighPlayerIds.clear();
+    m_registeredPlayerCount = 0;
+    m_leaderboard.clear();
+    m_playerDistribution.clear();
+    m_playerIdAllocator.clear();
+    m_pOfflineLruHead = nullptr;
+    m_pOfflineLruTail = nullptr;
+    m_offlineLruSize = 0;
 }
 
 Player* PlayerManager::playerLogin(uint64_t id)
 {
-    std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
+    // a dry id allocator is refilled here, never under the player lock
+    if (id == 0 && !m_playerIdAllocator.waitForIds(1))
+    {
+        std::cerr << "Failed to reserve a new player id." << std::endl;
+        return nullptr;
+    }
+    std::unique_lock<std::mutex> lock(m_mapPlayersMutex);
 
     if (id == 0)
     {
-		// insert new player
-        id = DbManager::instance().insertPlayerBattles();
-        if (id == 0)
+		// new player, created in memory and persisted by the dirty-save path
+        Player* pNewPlayer = _createPlayerNoLock();
+        if (!pNewPlayer)
         {
-            std::cerr << "Failed to create player in database for ID: " << id << std::endl;
+            std::cerr << "Failed to create new player." << std::endl;
             return nullptr;
         }
-        std::cout << "New player created with ID: " << id << std::endl;
+        std::cout << "New player created with ID: " << pNewPlayer->getId() << std::endl;
+        _setPlayerLoggedInNoLock(pNewPlayer);
+        return pNewPlayer;
     }
 
     Player* pPlayer = _getPlayerNoLock(id);
+    if (pPlayer)
+    {
+        m_cacheHits++;
+    }
+    else
+    {
+        m_cacheMisses++;
+        if (_isPlayerIdRegisteredNoLock(id))
+        {
+            // the row is read without the player lock, as queryPlayer does
+            std::vector<PlayerSnapshot> vecRows;
+            lock.unlock();
+            _readPlayerRows(std::vector<uint64_t>(1, id), vecRows);
+            lock.lock();
+            _insertPlayerRowsNoLock(vecRows);
+            pPlayer = _getPlayerNoLock(id);
+        }
+    }
     if (!pPlayer)
     {
         std::cout << "Player " << id << " not found." << std::endl;
         return nullptr;
     }
     //std::cout << "Player " << id << " login." << std::endl;
-    _setPlayerOnlineNoLock(id, true);
-    pPlayer->setStatus(common::PlayerStatus::lobby);
+    _setPlayerLoggedInNoLock(pPlayer);
     return pPlayer;
 }
 
+// log many players in under the player lock, id 0 creates a new player.
+// new players are created in memory and missing residents are loaded from db in one batch, read while
+// the player lock is released. result[i] is the player of vecIds[i] or nullptr when it could not be resolved
+std::vector<Player*> PlayerManager::playerLoginBatch(const std::vector<uint64_t>& vecIds)
+{
+    std::vector<Player*> vecPlayers(vecIds.size(), nullptr);
+    // ids for the new players are reserved before the player lock is taken
+    const uint64_t newPlayerCount = static_cast<uint64_t>(std::count(vecIds.begin(), vecIds.end(), 0ull));
+    if (newPlayerCount > 0 && !m_playerIdAllocator.waitForIds(newPlayerCount))
+    {
+        std::cerr << "Failed to reserve new player ids." << std::endl;
+    }
+    std::unique_lock<std::mutex> lock(m_mapPlayersMutex);
+
+    // first pass: resident players, and what has to come from db
+    std::vector<uint64_t> vecLoadIds;
+    for (size_t i = 0; i < vecIds.size(); i++)
+    {
+        const uint64_t id = vecIds[i];
+        if (id == 0)
+        {
+            continue;
+        }
+        if (_getPlayerNoLock(id))
+        {
+            m_cacheHits++;
+        }
+        else if (_isPlayerIdRegisteredNoLock(id))
+        {
+            m_cacheMisses++;
+            vecLoadIds.emplace_back(id);
+        }
+    }
+
+    if (!vecLoadIds.empty())
+    {
+        // the same id may appear twice in a batch, load it once
+        std::sort(vecLoadIds.begin(), vecLoadIds.end());
+        vecLoadIds.erase(std::unique(vecLoadIds.begin(), vecLoadIds.end()), vecLoadIds.end());
+        std::vector<PlayerSnapshot> vecRows;
+        lock.unlock();
+        _readPlayerRows(vecLoadIds, vecRows);
+        lock.lock();
+        _insertPlayerRowsNoLock(vecRows);
+    }
+
+    // second pass: resolve everybody again (a resident may have been evicted while the lock was released)
+    // and log them in
+    for (size_t i = 0; i < vecIds.size(); i++)
+    {
+        if (vecIds[i] == 0)
+        {
+            vecPlayers[i] = _createPlayerNoLock();
+        }
+        else
+        {
+            vecPlayers[i] = _getPlayerNoLock(vecIds[i]);
+        }
+        if (vecPlayers[i])
+        {
+            _setPlayerLoggedInNoLock(vecPlayers[i]);
+        }
+    }
+    return vecPlayers;
+}
+
+// new player with an id from the block allocator, never touches the db (nullptr when the blocks ran dry).
+// the player starts dirty and unpersisted, its row is inserted by the next saveDirtyPlayers (upsert)
+// and it can't be evicted before that
+Player* PlayerManager::_createPlayerNoLock()
+{
+    const uint64_t id = m_playerIdAllocator.allocate();
+    if (id == 0)
+    {
+        return nullptr;
+    }
+    _syncPlayerNoLock(id, 0, 0, time_utils::getTimestampMS());
+    Player* pPlayer = _getPlayerNoLock(id);
+    if (pPlayer)
+    {
+        pPlayer->clearPersistedVersion();
+    }
+    enqueuePlayerSave(pPlayer);
+    return pPlayer;
+}
+
+// background task: keep a spare block of new player ids reserved
+void PlayerManager::refillPlayerIds()
+{
+    m_playerIdAllocator.refill();
+}
+
+void PlayerManager::_setPlayerLoggedInNoLock(Player* pPlayer)
+{
+    _removeOfflineLruNoLock(pPlayer);
+    _setPlayerOnlineNoLock(pPlayer->getId(), true);
+    setPlayerStatus(pPlayer, common::PlayerStatus::lobby);
+}
+
 bool PlayerManager::playerLogout(uint64_t id)
 {
     std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
@@ -87,9 +234,15 @@ bool PlayerManager::playerLogout(uint64_t id)
 
     //std::cout << "Player " << id << " logout." << std::endl;
     _setPlayerOnlineNoLock(id, false);
-    pPlayer->setStatus(common::PlayerStatus::offline);
-	// Save player data to database
-	enqueuePlayerSave(id);
+    // players still referenced by the match queues or a battle room must stay resident
+    const common::PlayerStatus prevStatus = pPlayer->getStatus();
+    if (prevStatus == common::PlayerStatus::lobby || prevStatus == common::PlayerStatus::offline)
+    {
+        _pushOfflineLruNoLock(pPlayer);
+    }
+    setPlayerStatus(pPlayer, common::PlayerStatus::offline);
+	// Save player data to database (skipped at the flush if nothing changed)
+	enqueuePlayerSave(pPlayer);
     return true;
 }
 
@@ -117,12 +270,277 @@ std::vector<Player*> PlayerManager::getOnlinePlayers()
     return tmpVecPlayers;
 }
 
+// visit a consistent snapshot of every resident player.
+// the player lock is only held to copy the pointers, snapshots are read lock-free afterwards
+// and eviction is paused until the scan is done
+size_t PlayerManager::forEachPlayerSnapshot(const std::function<void(const PlayerSnapshot&)>& func)
+{
+    std::vector<const Player*> tmpVecPlayers;
+    {
+        std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
+        tmpVecPlayers.reserve(m_mapPlayers.size());
+        for (const auto& itPlayer : m_mapPlayers)
+        {
+            tmpVecPlayers.emplace_back(itPlayer.second.get());
+        }
+        m_activeScans++;
+    }
+    for (const Player* pPlayer : tmpVecPlayers)
+    {
+        func(pPlayer->getSnapshot());
+    }
+    m_activeScans--;
+    return tmpVecPlayers.size();
+}
+
 // *** only for dbManager to sync player data from db ***
 void PlayerManager::syncPlayerFromDbNoLock(uint64_t id, uint32_t score, uint32_t wins, uint64_t updatedTime)
 {
 	_syncPlayerNoLock(id, score, wins, updatedTime);
 }
 
+// *** only for dbManager to register the player ids that exist in db ***
+void PlayerManager::registerPlayerIdNoLock(uint64_t id, uint32_t score)
+{
+    if (_setPlayerIdBitNoLock(id))
+    {
+        m_leaderboard.addPlayer(id, score);
+        // not resident yet, counted as offline until the player logs in
+        m_playerDistribution.addPlayer(score, common::PlayerStatus::offline);
+    }
+}
+
+// startup bulk load into an empty PlayerManager. replayed rows changed after the snapshot was taken and
+// replace its record of the same player. the snapshot is in leaderboard order, so the index is built
+// without sorting and the distribution is counted per run of equal scores
+void PlayerManager::loadPlayerSnapshot(const PlayerSnapshotData& data, const std::vector<PlayerSnapshot>& vecReplayRows)
+{
+    std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
+
+    std::unordered_set<uint64_t> setReplayIds;
+    for (const PlayerSnapshot& row : vecReplayRows)
+    {
+        setReplayIds.insert(row.id);
+    }
+
+    // keys and distribution runs per range in parallel, a replaced record keeps id 0 and is dropped below
+    const size_t count = data.vecIds.size();
+    std::vector<Leaderboard::Key> vecKeys(count);
+    thread_utils::parallelFor(count, 1 << 16, [&](size_t begin, size_t end)
+        {
+            size_t runBegin = begin;
+            for (size_t i = begin; i < end; i++)
+            {
+                const uint64_t id = data.vecIds[i];
+                const bool isReplaced = !setReplayIds.empty() && setReplayIds.count(id) != 0;
+                vecKeys[i] = Leaderboard::Key{ data.vecRecords[i].score, isReplaced ? 0 : id };
+                if (isReplaced)
+                {
+                    m_playerDistribution.addPlayers(data.vecRecords[i].score, common::PlayerStatus::offline, -1);
+                }
+                if (i + 1 == end || data.vecRecords[i + 1].score != data.vecRecords[runBegin].score)
+                {
+                    m_playerDistribution.addPlayers(data.vecRecords[runBegin].score, common::PlayerStatus::offline, static_cast<int64_t>(i + 1 - runBegin));
+                    runBegin = i + 1;
+                }
+            }
+        });
+    vecKeys.erase(std::remove_if(vecKeys.begin(), vecKeys.end(), [](const Leaderboard::Key& key) { return key.id == 0; }), vecKeys.end());
+
+    for (const Leaderboard::Key& key : vecKeys)
+    {
+        _setPlayerIdBitNoLock(key.id);
+    }
+    if (!db_constant::LAZY_PLAYER_LOADING)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const PlayerSnapshot snapshot = data.vecRecords[i].unpack(data.vecIds[i]);
+            if (_isPlayerIdRegisteredNoLock(snapshot.id) && m_mapPlayers.find(snapshot.id) == m_mapPlayers.end())
+            {
+                _insertPlayerNoLock(snapshot.id, snapshot.score, snapshot.wins, snapshot.updatedTime);
+            }
+        }
+    }
+    m_leaderboard.addSortedPlayers(std::move(vecKeys));
+
+    for (const PlayerSnapshot& row : vecReplayRows)
+    {
+        if (db_constant::LAZY_PLAYER_LOADING)
+        {
+            registerPlayerIdNoLock(row.id, row.score);
+        }
+        else
+        {
+            _syncPlayerNoLock(row.id, row.score, row.wins, row.updatedTime);
+        }
+    }
+}
+
+// every change stamped before the cutoff is flushed and committed first, so the snapshot plus the rows
+// with updated_time >= cutoff always rebuild the current state
+bool PlayerManager::savePlayerSnapshot()
+{
+    uint64_t cutoffTime = 0;
+    {
+        // battle results are stamped and queued for saving under this lock
+        std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
+        cutoffTime = time_utils::getTimestampMS();
+    }
+    const uint64_t failedRows = getPlayerSaveStats().failedRows;
+    saveDirtyPlayers();
+    DbManager::instance().waitForWrites();
+    if (getPlayerSaveStats().failedRows != failedRows)
+    {
+        std::cerr << "PlayerManager::savePlayerSnapshot: Dirty players were not saved, snapshot skipped." << std::endl;
+        return false;
+    }
+    return DbManager::instance().writePlayerSnapshot(db_constant::PLAYER_SNAPSHOT_FILE, cutoffTime);
+}
+
+uint64_t PlayerManager::getRegisteredPlayerCount()
+{
+    std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
+
+    return m_registeredPlayerCount;
+}
+
+// random ids out of the registered id set, ids may repeat.
+// a random bit position is scanned forward (wrapping) to the next registered id
+std::vector<uint64_t> PlayerManager::getRandomRegisteredPlayerIds(uint32_t count)
+{
+    std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
+
+    std::vector<uint64_t> vecIds;
+    if (m_registeredPlayerCount == 0)
+    {
+        return vecIds;
+    }
+    const uint64_t highCount = m_setHighPlayerIds.size();
+    const uint64_t bitCount = static_cast<uint64_t>(m_vecPlayerIdBits.size()) * 64;
+    vecIds.reserve(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint64_t pick = random_utils::getRandom(m_registeredPlayerCount);
+        if (pick < highCount)
+        {
+            vecIds.emplace_back(*std::next(m_setHighPlayerIds.begin(), static_cast<std::ptrdiff_t>(pick)));
+            continue;
+        }
+        uint64_t id = random_utils::getRandom(bitCount);
+        for (uint64_t step = 0; step < bitCount && !_isPlayerIdRegisteredNoLock(id); step++)
+        {
+            id = (id + 1 < bitCount) ? (id + 1) : 0;
+        }
+        vecIds.emplace_back(id);
+    }
+    return vecIds;
+}
+
+bool PlayerManager::_isPlayerIdRegisteredNoLock(uint64_t id) const
+{
+    if (id >= player_constant::PLAYER_ID_BITSET_LIMIT)
+    {
+        return m_setHighPlayerIds.count(id) != 0;
+    }
+    const size_t wordIndex = static_cast<size_t>(id >> 6);
+    if (wordIndex >= m_vecPlayerIdBits.size())
+    {
+        return false;
+    }
+    return (m_vecPlayerIdBits[wordIndex] & (1ull << (id & 63))) != 0;
+}
+
+// reads the rows of registered players that are not resident yet, for _insertPlayerRowsNoLock.
+// *** the player lock must not be held, the db read would stall every login and battle result ***
+void PlayerManager::_readPlayerRows(const std::vector<uint64_t>& vecIds, std::vector<PlayerSnapshot>& vecRows)
+{
+    if (vecIds.size() == 1)
+    {
+        PlayerSnapshot snapshot;
+        if (DbManager::instance().loadPlayerBattles(vecIds.front(), snapshot))
+        {
+            vecRows.emplace_back(snapshot);
+        }
+        return;
+    }
+    DbManager::instance().loadPlayerBattlesBatch(vecIds, vecRows);
+}
+
+// makes the rows read by _readPlayerRows resident, except the players that became resident while the
+// lock was released (a concurrent login loaded them): their memory state is newer than the row
+void PlayerManager::_insertPlayerRowsNoLock(const std::vector<PlayerSnapshot>& vecRows)
+{
+    for (const PlayerSnapshot& row : vecRows)
+    {
+        if (!_getPlayerNoLock(row.id))
+        {
+            _syncPlayerNoLock(row.id, row.score, row.wins, row.updatedTime);
+        }
+    }
+}
+
+// resident players answer from memory with a consistent snapshot (Player's seqlock), the others from a
+// prepared db read without being loaded (they were flushed before eviction). unknown ids never reach db
+player_constant::PlayerQuerySource PlayerManager::queryPlayer(uint64_t id, PlayerSnapshot& snapshot)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
+
+        Player* pPlayer = _getPlayerNoLock(id);
+        if (pPlayer)
+        {
+            snapshot = pPlayer->getSnapshot();
+            return player_constant::PlayerQuerySource::memory;
+        }
+        if (!_isPlayerIdRegisteredNoLock(id))
+        {
+            return player_constant::PlayerQuerySource::notFound;
+        }
+    }
+    snapshot = PlayerSnapshot();
+    snapshot.id = id;
+    if (!DbManager::instance().queryPlayerBattles(id, snapshot.score, snapshot.wins, snapshot.updatedTime))
+    {
+        return player_constant::PlayerQuerySource::notFound;
+    }
+    return player_constant::PlayerQuerySource::db;
+}
+
+bool PlayerManager::getPlayerRank(uint64_t id, LeaderboardEntry& entry)
+{
+    PlayerSnapshot snapshot;
+    if (queryPlayer(id, snapshot) == player_constant::PlayerQuerySource::notFound)
+    {
+        return false;
+    }
+    entry.rank = m_leaderboard.getRankOfScore(snapshot.score);
+    entry.id = id;
+    entry.score = snapshot.score;
+    return true;
+}
+
+std::vector<LeaderboardEntry> PlayerManager::getTopPlayers(uint32_t count)
+{
+    return m_leaderboard.getTop(count);
+}
+
+std::vector<LeaderboardEntry> PlayerManager::getPlayersAroundPlayer(uint64_t id, uint32_t radius)
+{
+    PlayerSnapshot snapshot;
+    if (queryPlayer(id, snapshot) == player_constant::PlayerQuerySource::notFound)
+    {
+        return std::vector<LeaderboardEntry>();
+    }
+    return m_leaderboard.getAround(id, snapshot.score, radius);
+}
+
+// fold the score changes logged since the last call into the leaderboard index (scheduler task)
+void PlayerManager::updateLeaderboard()
+{
+    m_leaderboard.applyPending();
+}
+
 Player* PlayerManager::_getPlayerNoLock(uint64_t id)
 {
     if (m_mapPlayers.empty())
@@ -156,59 +574,441 @@ void PlayerManager::_syncPlayerNoLock(uint64_t id, uint32_t score, uint32_t wins
         std::cerr << "Player " << id << " already exists." << std::endl;
         return;
     }
+    _insertPlayerNoLock(id, score, wins, updatedTime);
+    registerPlayerIdNoLock(id, score);
+}
+
+// resident, offline player object only, the id is registered by the caller
+bool PlayerManager::_insertPlayerNoLock(uint64_t id, uint32_t score, uint32_t wins, uint64_t updatedTime)
+{
     std::unique_ptr<Player> uPlayer = std::make_unique<Player>(id, score, wins, updatedTime);
-    m_mapPlayers[id] = std::move(uPlayer);
+    _pushOfflineLruNoLock(uPlayer.get());
+    return m_mapPlayers.emplace(id, std::move(uPlayer)).second;
+}
+
+// returns true when the id was not registered yet.
+// the bitset grows by doubling up to PLAYER_ID_BITSET_LIMIT bits, ids above it go to the hash set
+bool PlayerManager::_setPlayerIdBitNoLock(uint64_t id)
+{
+    if (id >= player_constant::PLAYER_ID_BITSET_LIMIT)
+    {
+        if (!m_setHighPlayerIds.insert(id).second)
+        {
+            return false;
+        }
+        m_registeredPlayerCount++;
+        return true;
+    }
+    const size_t wordIndex = static_cast<size_t>(id >> 6);
+    if (wordIndex >= m_vecPlayerIdBits.size())
+    {
+        const size_t maxWords = static_cast<size_t>(player_constant::PLAYER_ID_BITSET_LIMIT >> 6);
+        m_vecPlayerIdBits.resize(std::min(maxWords, std::max(wordIndex + 1, m_vecPlayerIdBits.size() * 2)), 0);
+    }
+    const uint64_t bit = 1ull << (id & 63);
+    if ((m_vecPlayerIdBits[wordIndex] & bit) != 0)
+    {
+        return false;
+    }
+    m_vecPlayerIdBits[wordIndex] |= bit;
+    m_registeredPlayerCount++;
+    return true;
 }
 
 void PlayerManager::handlePlayerBattleResult(uint64_t playerId, uint32_t scoreDelta, bool isWin)
+{
+    BattleResult result;
+    result.playerId = playerId;
+    result.scoreDelta = scoreDelta;
+    result.isWin = isWin ? 1 : 0;
+    std::vector<BattleResult> vecResults(1, result);
+    applyBattleResults(0, 0, vecResults);
+}
+
+// applies the results under one lock and returns the seq of their journal record without waiting for its
+// group commit, 0 when it was not journaled. see notifyBattleResultsDurable for callers that need it on disk.
+// each result gets the player's new updatedTime, strictly increasing per player, so a saved row tells
+// which journaled results it already contains. results of unknown players are dropped.
+// a player who logged out while queued or in battle goes back to offline (and into the offline LRU,
+// which logout skipped while the room still referenced them), the others back to the lobby
+uint64_t PlayerManager::applyBattleResults(uint64_t roomId, uint32_t tier, std::vector<BattleResult>& vecResults)
 {
     {
-        std::lock_guard<std::mutex> lock(m_mapPlayersMutex); // O@ m_mapPlayers X
+        std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
 
-        Player* pPlayer = _getPlayerNoLock(playerId);
-        if (!pPlayer)
+        for (BattleResult& result : vecResults)
         {
-            return;
+            Player* pPlayer = _getPlayerNoLock(result.playerId);
+            if (!pPlayer)
+            {
+                result.updatedTime = 0;
+                continue;
+            }
+            result.updatedTime = std::max(time_utils::getTimestampMS(), pPlayer->getUpdatedTime() + 1);
+            const bool isOnline = (m_setOnlinePlayerIds.find(result.playerId) != m_setOnlinePlayerIds.end());
+            _applyBattleResultNoLock(pPlayer, result.scoreDelta, result.isWin != 0, result.updatedTime,
+                isOnline ? common::PlayerStatus::lobby : common::PlayerStatus::offline);
+            if (!isOnline)
+            {
+                _pushOfflineLruNoLock(pPlayer);
+            }
         }
-        if (isWin)
+    }
+    vecResults.erase(std::remove_if(vecResults.begin(), vecResults.end(),
+        [](const BattleResult& result) { return result.updatedTime == 0; }), vecResults.end());
+    if (vecResults.empty())
+    {
+        return 0;
+    }
+    // appended after the results are applied and queued for saving, saveDirtyPlayers' checkpoint relies on it
+    return m_battleJournal.append(roomId, tier, vecResults);
+}
+
+// callback(isDurable) once the journal record of applyBattleResults is on disk, false when it never will be
+// (0: not journaled). runs on the journal's flusher thread, see BattleJournal::notifyDurable
+void PlayerManager::notifyBattleResultsDurable(uint64_t journalSeq, std::function<void(bool)> callback)
+{
+    if (journalSeq == 0)
+    {
+        callback(false);
+        return;
+    }
+    m_battleJournal.notifyDurable(journalSeq, std::move(callback));
+}
+
+// replays the results journaled after the last checkpoint on top of the loaded players.
+// a result is applied only when it is newer than the player's row, so replay is idempotent.
+// room battles are queued for match_history again, the ones already stored are skipped
+bool PlayerManager::openBattleJournal()
+{
+    std::vector<BattleRecord> vecRecords;
+    if (!m_battleJournal.open(db_constant::BATTLE_JOURNAL_FILE, vecRecords))
+    {
+        std::cerr << "PlayerManager::openBattleJournal: Failed to open the battle journal." << std::endl;
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mapPlayersMutex);
+
+    // players of the results that are not resident (lazy mode), read in one batch without the lock
+    std::vector<uint64_t> vecLoadIds;
+    for (const BattleRecord& record : vecRecords)
+    {
+        for (const BattleResult& result : record.vecResults)
         {
-            pPlayer->addWins();
-            pPlayer->addScore(scoreDelta);
+            if (!_getPlayerNoLock(result.playerId) && _isPlayerIdRegisteredNoLock(result.playerId))
+            {
+                vecLoadIds.emplace_back(result.playerId);
+            }
         }
-        else
+    }
+    if (!vecLoadIds.empty())
+    {
+        std::sort(vecLoadIds.begin(), vecLoadIds.end());
+        vecLoadIds.erase(std::unique(vecLoadIds.begin(), vecLoadIds.end()), vecLoadIds.end());
+        std::vector<PlayerSnapshot> vecRows;
+        lock.unlock();
+        _readPlayerRows(vecLoadIds, vecRows);
+        lock.lock();
+        _insertPlayerRowsNoLock(vecRows);
+    }
+
+    size_t replayedCount = 0;
+    for (const BattleRecord& record : vecRecords)
+    {
+        for (const BattleResult& result : record.vecResults)
+        {
+            Player* pPlayer = _getPlayerNoLock(result.playerId);
+            if (pPlayer && pPlayer->getUpdatedTime() < result.updatedTime)
+            {
+                _applyBattleResultNoLock(pPlayer, result.scoreDelta, result.isWin != 0, result.updatedTime, pPlayer->getStatus());
+                replayedCount++;
+            }
+        }
+        if (record.roomId != 0)
         {
-            pPlayer->subScore(scoreDelta);
+            BattleManager::instance().enqueueMatch(BattleManager::makeMatchRecord(record.roomId, record.tier, record.vecResults, true));
         }
-        pPlayer->setStatus(common::PlayerStatus::lobby);
     }
-    enqueuePlayerSave(playerId);
+    std::cout << "PlayerManager::openBattleJournal: " << replayedCount << " results of " << vecRecords.size() << " journaled battles replayed." << std::endl;
+    return true;
 }
 
-void PlayerManager::enqueuePlayerSave(uint64_t playerId)
+BattleJournalStats PlayerManager::getBattleJournalStats()
 {
-	std::lock_guard<std::mutex> lock(m_setdirtyPlayerIdsMutex);
-	m_setDirtyPlayerIds.emplace(playerId);
+    return m_battleJournal.getStats();
 }
 
+void PlayerManager::_applyBattleResultNoLock(Player* pPlayer, uint32_t scoreDelta, bool isWin, uint64_t updatedTime, common::PlayerStatus status)
+{
+    const uint32_t oldScore = pPlayer->getScore();
+    pPlayer->applyBattleResult(scoreDelta, isWin, updatedTime);
+    const uint32_t newScore = pPlayer->getScore();
+    m_leaderboard.updatePlayer(pPlayer->getId(), oldScore, newScore);
+    // score and status change are counted as a single move
+    const common::PlayerStatus oldStatus = pPlayer->_exchangeStatus(status);
+    m_playerDistribution.movePlayer(oldScore, oldStatus, newScore, status);
+    enqueuePlayerSave(pPlayer);
+}
+
+// the only way to change a player's status, keeps the distribution counters in sync
+void PlayerManager::setPlayerStatus(Player* pPlayer, common::PlayerStatus status)
+{
+    if (!pPlayer)
+    {
+        return;
+    }
+    const common::PlayerStatus oldStatus = pPlayer->_exchangeStatus(status);
+    if (oldStatus != status)
+    {
+        const uint32_t score = pPlayer->getScore();
+        m_playerDistribution.movePlayer(score, oldStatus, score, status);
+    }
+}
+
+PlayerDistributionSnapshot PlayerManager::getPlayerDistribution() const
+{
+    return m_playerDistribution.getSnapshot();
+}
+
+void PlayerManager::enqueuePlayerSave(Player* pPlayer)
+{
+    if (!pPlayer)
+    {
+        return;
+    }
+    m_saveRequests.fetch_add(1, std::memory_order_relaxed);
+    if (!_linkDirtyPlayer(pPlayer))
+    {
+        m_coalescedSaves.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// mark the player dirty, only the clean -> dirty transition links it into the lock-free dirty list
+bool PlayerManager::_linkDirtyPlayer(Player* pPlayer)
+{
+    if (!pPlayer->markDirty())
+    {
+        return false;
+    }
+    Player* pHead = m_pDirtyHead.load(std::memory_order_relaxed);
+    do
+    {
+        pPlayer->m_pNextDirty = pHead;
+    } while (!m_pDirtyHead.compare_exchange_weak(pHead, pPlayer, std::memory_order_release, std::memory_order_relaxed));
+    return true;
+}
+
+// the rows are written by the db writer thread, this only snapshots and queues them.
+// a player whose version is the one of its last written row is skipped, all changes since
+// that row go out as one row. the version counts as persisted once queued, a failed write clears it.
+// *** dirty and saving players are never evicted, so the drained pointers stay valid until the save callback ***
 void PlayerManager::saveDirtyPlayers()
 {
-    if (m_setDirtyPlayerIds.empty())
+    std::lock_guard<std::mutex> flushLock(m_flushMutex);
+
+    const auto beginTime = std::chrono::steady_clock::now();
+    // every result journaled up to here was applied and queued before the drain below,
+    // so it is in this flush or an earlier one, which the writer commits first
+    const uint64_t journalSeq = m_battleJournal.getLastSeq();
+    const uint64_t failedRows = getPlayerSaveStats().failedRows;
+
+    // detach the whole list, writers keep pushing onto the new empty head
+    std::vector<Player*> vecPlayers;
+    std::vector<PlayerSnapshot> vecSnapshots;
+    uint64_t skippedRows = 0;
+    Player* pPlayer = m_pDirtyHead.exchange(nullptr, std::memory_order_acquire);
+    while (pPlayer)
+    {
+        // read the link before clearing the flag, a writer may re-link the player right after
+        Player* pNext = pPlayer->m_pNextDirty;
+        pPlayer->m_pNextDirty = nullptr;
+        pPlayer->m_pendingSaves++;
+        pPlayer->clearDirty();
+        uint32_t version = 0;
+        const PlayerSnapshot snapshot = pPlayer->getSnapshot(&version);
+        if (pPlayer->isPersisted(version))
+        {
+            pPlayer->m_pendingSaves--;
+            skippedRows++;
+        }
+        else
+        {
+            pPlayer->setPersistedVersion(version);
+            vecPlayers.emplace_back(pPlayer);
+            vecSnapshots.emplace_back(snapshot);
+        }
+        pPlayer = pNext;
+    }
+    if (skippedRows > 0)
     {
+        std::lock_guard<std::mutex> lock(m_saveStatsMutex);
+        m_saveStats.skippedRows += skippedRows;
+    }
+    if (vecSnapshots.empty())
+    {
+        if (journalSeq > m_battleJournal.getStats().checkpointSeq)
+        {
+            // nothing dirty, the checkpoint waits for the flushes still queued
+            DbManager::instance().submitWrite([]() { return true; },
+                [this, journalSeq, failedRows](bool)
+                {
+                    _checkpointBattleJournal(journalSeq, failedRows);
+                });
+        }
         return;
     }
-    std::set<uint64_t> tmpSetSaveIds;
+
+    // chunked transactions instead of one autocommit (fsync) per row, duration is submit -> commit
+    DbManager::instance().updatePlayerBattlesAsync(std::move(vecSnapshots),
+        [this, vecPlayers, beginTime, journalSeq, failedRows](size_t savedCount)
+        {
+            if (savedCount == vecPlayers.size())
+            {
+                _checkpointBattleJournal(journalSeq, failedRows);
+            }
+            for (size_t i = savedCount; i < vecPlayers.size(); i++)
+            {
+                // not written, keep them dirty (and resident) for the next tick
+                vecPlayers[i]->clearPersistedVersion();
+                _linkDirtyPlayer(vecPlayers[i]);
+            }
+            for (Player* pSavedPlayer : vecPlayers)
+            {
+                pSavedPlayer->m_pendingSaves--;
+            }
+            _recordSave(vecPlayers.size(), savedCount, beginTime);
+        });
+}
+
+void PlayerManager::_recordSave(size_t rows, size_t savedCount, std::chrono::steady_clock::time_point beginTime)
+{
+    const double durationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - beginTime).count();
+    std::lock_guard<std::mutex> lock(m_saveStatsMutex);
+    m_saveStats.flushes++;
+    m_saveStats.savedRows += savedCount;
+    m_saveStats.failedRows += rows - savedCount;
+    m_saveStats.lastRows = savedCount;
+    m_saveStats.lastDurationMs = durationMs;
+    m_saveStats.lastRowsPerSecond = (durationMs > 0) ? savedCount * 1000.0 / durationMs : 0;
+    m_saveStats.maxDurationMs = std::max(m_saveStats.maxDurationMs, durationMs);
+}
+
+// *** runs on the db writer thread after the flush commit, earlier flushes have reported already ***
+void PlayerManager::_checkpointBattleJournal(uint64_t journalSeq, uint64_t failedRows)
+{
+    // a failed earlier flush leaves results of these records unsaved
+    if (getPlayerSaveStats().failedRows != failedRows)
     {
-		// lock m_setDirtyPlayerIds
-        std::lock_guard<std::mutex> lock(m_setdirtyPlayerIdsMutex);
-		tmpSetSaveIds.swap(m_setDirtyPlayerIds);    // save the ids to tmpSetSaveIds and clear m_setDirtyPlayerIds
+        return;
     }
-    for (auto& id : tmpSetSaveIds)
+    // committed is not durable under every storage profile / store, the records stay until the rows are on disk
+    if (!DbManager::instance().syncPlayerBattles())
     {
-		Player* pPlayer = _getPlayerNoLock(id);
-        if (!pPlayer)
+        std::cerr << "PlayerManager::saveDirtyPlayers: Saved players are not synced, journal checkpoint skipped." << std::endl;
+        return;
+    }
+    m_battleJournal.checkpoint(journalSeq);
+}
+
+PlayerSaveStats PlayerManager::getPlayerSaveStats()
+{
+    std::lock_guard<std::mutex> lock(m_saveStatsMutex);
+
+    PlayerSaveStats stats = m_saveStats;
+    stats.requests = m_saveRequests.load(std::memory_order_relaxed);
+    stats.coalescedRequests = m_coalescedSaves.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// evict offline, clean players in LRU order until the resident set fits m_residentPlayerLimit,
+// dirty players are kept until saveDirtyPlayers has flushed them and the write is committed
+void PlayerManager::evictOfflinePlayers()
+{
+    std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
+
+    if (m_activeScans.load() > 0)
+    {
+        // a forEachPlayerSnapshot scan still holds raw player pointers, evict on the next tick
+        return;
+    }
+    const uint64_t limit = m_residentPlayerLimit.load();
+    Player* pPlayer = m_pOfflineLruTail;
+    while (pPlayer && m_mapPlayers.size() > limit)
+    {
+        Player* pPrev = pPlayer->m_pPrevOffline;
+        const uint64_t id = pPlayer->getId();
+        if (!pPlayer->isDirty() && !pPlayer->isSaving())
         {
-            continue;
+            _removeOfflineLruNoLock(pPlayer);
+            m_mapPlayers.erase(id);
+            m_cacheEvictions++;
         }
-        DbManager::instance().updatePlayerBattles(pPlayer->getId(), pPlayer->getScore(), pPlayer->getWins());
+        pPlayer = pPrev;
     }
-}
\ No newline at end of file
+}
+
+void PlayerManager::setResidentPlayerLimit(uint64_t limit)
+{
+    m_residentPlayerLimit = limit;
+}
+
+PlayerCacheStats PlayerManager::getPlayerCacheStats()
+{
+    std::lock_guard<std::mutex> lock(m_mapPlayersMutex);
+
+    PlayerCacheStats stats;
+    stats.residentPlayers = m_mapPlayers.size();
+    stats.residentLimit = m_residentPlayerLimit.load();
+    stats.offlinePlayers = m_offlineLruSize;
+    stats.hits = m_cacheHits.load();
+    stats.misses = m_cacheMisses.load();
+    stats.evictions = m_cacheEvictions.load();
+    return stats;
+}
+
+void PlayerManager::_pushOfflineLruNoLock(Player* pPlayer)
+{
+    _removeOfflineLruNoLock(pPlayer);
+    pPlayer->m_pPrevOffline = nullptr;
+    pPlayer->m_pNextOffline = m_pOfflineLruHead;
+    if (m_pOfflineLruHead)
+    {
+        m_pOfflineLruHead->m_pPrevOffline = pPlayer;
+    }
+    m_pOfflineLruHead = pPlayer;
+    if (!m_pOfflineLruTail)
+    {
+        m_pOfflineLruTail = pPlayer;
+    }
+    pPlayer->m_isInOfflineLru = true;
+    m_offlineLruSize++;
+}
+
+void PlayerManager::_removeOfflineLruNoLock(Player* pPlayer)
+{
+    if (!pPlayer->m_isInOfflineLru)
+    {
+        return;
+    }
+    if (pPlayer->m_pPrevOffline)
+    {
+        pPlayer->m_pPrevOffline->m_pNextOffline = pPlayer->m_pNextOffline;
+    }
+    else
+    {
+        m_pOfflineLruHead = pPlayer->m_pNextOffline;
+    }
+    if (pPlayer->m_pNextOffline)
+    {
+        pPlayer->m_pNextOffline->m_pPrevOffline = pPlayer->m_pPrevOffline;
+    }
+    else
+    {
+        m_pOfflineLruTail = pPlayer->m_pPrevOffline;
+    }
+    pPlayer->m_pPrevOffline = nullptr;
+    pPlayer->m_pNextOffline = nullptr;
+    pPlayer->m_isInOfflineLru = false;
+    m_offlineLruSize--;
+}
@@ -2,11 +2,48 @@
 #ifndef PLAYER_MANAGER_H
 #define PLAYER_MANAGER_H
 #include "objects/player.h"
+#include "leaderboard.h"
+#include "playerDistribution.h"
+#include "playerIdAllocator.h"
+#include "playerSnapshotFile.h"
+#include "battleJournal.h"
 #include <unordered_map>
+#include <unordered_set>
 #include <set>
 #include <mutex>
+#include <atomic>
+#include <functional>
+#include <chrono>
 #include <cstdint>
 
+struct PlayerCacheStats
+{
+    uint64_t residentPlayers = 0;
+    uint64_t residentLimit = 0;
+    uint64_t offlinePlayers = 0;    // evictable candidates in the LRU list
+    uint64_t hits = 0;              // login found the player resident
+    uint64_t misses = 0;            // login had to load the player from db
+    uint64_t evictions = 0;
+};
+
+// saveDirtyPlayers flushes, only ticks that had dirty players are counted.
+// durations run from queueing the rows to their commit on the db writer thread.
+// a save request ends as a written row, or is avoided: coalesced into a save already pending, or skipped
+// at the flush because the player didn't change since its last written row
+struct PlayerSaveStats
+{
+    uint64_t requests = 0;          // enqueuePlayerSave calls
+    uint64_t coalescedRequests = 0; // the player was already dirty
+    uint64_t skippedRows = 0;       // unchanged since the last written row
+    uint64_t flushes = 0;
+    uint64_t savedRows = 0;
+    uint64_t failedRows = 0;        // left dirty and retried on the next tick
+    uint64_t lastRows = 0;
+    double lastDurationMs = 0;
+    double lastRowsPerSecond = 0;
+    double maxDurationMs = 0;
+};
+
 class PlayerManager
 {
 public:
@@ -16,17 +53,41 @@ public:
     bool initialize();
     void release();
     Player* playerLogin(uint64_t id);
+    std::vector<Player*> playerLoginBatch(const std::vector<uint64_t>& vecIds);
     bool playerLogout(uint64_t id);
     bool isPlayerOnline(uint64_t id);
     std::vector<Player*> getOnlinePlayers();
-	std::unordered_map<uint64_t, std::unique_ptr<Player>>* getAllPlayers() { return &m_mapPlayers; }
+    size_t forEachPlayerSnapshot(const std::function<void(const PlayerSnapshot&)>& func);
     std::set<uint64_t>* getOnlinePlayerIds() { return &m_setOnlinePlayerIds; }
     void syncPlayerFromDbNoLock(uint64_t id, uint32_t score, uint32_t wins, uint64_t updatedTime);
+    void registerPlayerIdNoLock(uint64_t id, uint32_t score);
+    void loadPlayerSnapshot(const PlayerSnapshotData& data, const std::vector<PlayerSnapshot>& vecReplayRows);
+    bool savePlayerSnapshot();
+    uint64_t getRegisteredPlayerCount();
+    std::vector<uint64_t> getRandomRegisteredPlayerIds(uint32_t count);
+    player_constant::PlayerQuerySource queryPlayer(uint64_t id, PlayerSnapshot& snapshot);
 
     void handlePlayerBattleResult(uint64_t playerId, uint32_t scoreDelta, bool isWin);
+    uint64_t applyBattleResults(uint64_t roomId, uint32_t tier, std::vector<BattleResult>& vecResults);
+    void notifyBattleResultsDurable(uint64_t journalSeq, std::function<void(bool)> callback);
+    bool openBattleJournal();
+    BattleJournalStats getBattleJournalStats();
+    void setPlayerStatus(Player* pPlayer, common::PlayerStatus status);
+    PlayerDistributionSnapshot getPlayerDistribution() const;
 
-    void enqueuePlayerSave(uint64_t playerId);
+    void enqueuePlayerSave(Player* pPlayer);
     void saveDirtyPlayers();
+    PlayerSaveStats getPlayerSaveStats();
+    void refillPlayerIds();
+
+    bool getPlayerRank(uint64_t id, LeaderboardEntry& entry);
+    std::vector<LeaderboardEntry> getTopPlayers(uint32_t count);
+    std::vector<LeaderboardEntry> getPlayersAroundPlayer(uint64_t id, uint32_t radius);
+    void updateLeaderboard();
+
+    void evictOfflinePlayers();
+    void setResidentPlayerLimit(uint64_t limit);
+    PlayerCacheStats getPlayerCacheStats();
 
 private:
 
@@ -41,13 +102,61 @@ private:
     Player* _getPlayerNoLock(uint64_t id);
     void _setPlayerOnlineNoLock(uint64_t id, bool isOnline);
     void _syncPlayerNoLock(uint64_t id, uint32_t score, uint32_t wins, uint64_t updatedTime);
+    bool _insertPlayerNoLock(uint64_t id, uint32_t score, uint32_t wins, uint64_t updatedTime);
+    bool _setPlayerIdBitNoLock(uint64_t id);
+    void _recordSave(size_t rows, size_t savedCount, std::chrono::steady_clock::time_point beginTime);
+    bool _linkDirtyPlayer(Player* pPlayer);
+    void _checkpointBattleJournal(uint64_t journalSeq, uint64_t failedRows);
+    void _applyBattleResultNoLock(Player* pPlayer, uint32_t scoreDelta, bool isWin, uint64_t updatedTime, common::PlayerStatus status);
+    bool _isPlayerIdRegisteredNoLock(uint64_t id) const;
+    void _readPlayerRows(const std::vector<uint64_t>& vecIds, std::vector<PlayerSnapshot>& vecRows);
+    void _insertPlayerRowsNoLock(const std::vector<PlayerSnapshot>& vecRows);
+    void _setPlayerLoggedInNoLock(Player* pPlayer);
+    Player* _createPlayerNoLock();
+
+    void _pushOfflineLruNoLock(Player* pPlayer);
+    void _removeOfflineLruNoLock(Player* pPlayer);
 
     std::unordered_map<uint64_t, std::unique_ptr<Player>> m_mapPlayers{};
 	std::set<uint64_t> m_setOnlinePlayerIds{};
 	std::mutex m_mapPlayersMutex;
 
-    std::set<uint64_t> m_setDirtyPlayerIds{};
-    std::mutex m_setdirtyPlayerIdsMutex;
+    // existence filter of every player id in the database (one bit per id below PLAYER_ID_BITSET_LIMIT,
+    // a hash set above it), unknown ids are rejected without a db round trip
+    std::vector<uint64_t> m_vecPlayerIdBits{};
+    std::unordered_set<uint64_t> m_setHighPlayerIds{};
+    uint64_t m_registeredPlayerCount = 0;
+
+    // every registered player (resident or not), updated on each battle result
+    Leaderboard m_leaderboard{};
+    // every registered player counted by (tier, status) and (score bucket, status), lock free
+    PlayerDistribution m_playerDistribution{};
+    // ids for new players, reserved from db in blocks
+    PlayerIdAllocator m_playerIdAllocator{};
+    // battle results since the last save, replayed at startup
+    BattleJournal m_battleJournal{};
+
+    // offline players ordered by last logout, head = most recent, tail = evicted first
+    Player* m_pOfflineLruHead = nullptr;
+    Player* m_pOfflineLruTail = nullptr;
+    uint64_t m_offlineLruSize = 0;
+    std::atomic<uint64_t> m_residentPlayerLimit{ player_constant::RESIDENT_PLAYER_LIMIT };
+    std::atomic<uint64_t> m_cacheHits{ 0 };
+    std::atomic<uint64_t> m_cacheMisses{ 0 };
+    std::atomic<uint64_t> m_cacheEvictions{ 0 };
+
+    PlayerSaveStats m_saveStats{};
+    std::atomic<uint64_t> m_saveRequests{ 0 };
+    std::atomic<uint64_t> m_coalescedSaves{ 0 };
+    std::mutex m_saveStatsMutex;
+    std::atomic<uint32_t> m_activeScans{ 0 };
+
+    // one saveDirtyPlayers at a time (scheduler executors, snapshot, benches): flushes are queued to the writer
+    // in the order their journal seq was taken, which the journal checkpoint relies on
+    std::mutex m_flushMutex;
+    // lock-free (Treiber) stack of dirty players linked through Player::m_pNextDirty,
+    // pushed by writers on the clean -> dirty transition and drained by saveDirtyPlayers
+    std::atomic<Player*> m_pDirtyHead{ nullptr };
 };
 
 #endif // !PLAYER_MANAGER_H
\ No newline at end of file
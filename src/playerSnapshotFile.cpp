@@ -0,0 +1,162 @@
+// @file  : playerSnapshotFile.cpp
+// @brief : binary player snapshot file
+// @author: August
+// @date  : 2026-10-19
+#include "playerSnapshotFile.h"
+#include "../utils/utils.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+namespace
+{
+    const char SNAPSHOT_MAGIC[8] = { 'G', 'M', 'P', 'S', 'N', 'A', 'P', '\0' };
+    const uint32_t SNAPSHOT_VERSION = 1;
+    // the checksum is a hash of per-block hashes, so blocks can be hashed on different threads
+    const size_t CHECKSUM_BLOCK_WORDS = 1 << 20;
+    const uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t recordSize;
+        uint64_t recordCount;
+        uint64_t highWaterTime;
+        uint64_t checksum;          // of the id and record sections
+        uint64_t reserved[3];
+    };
+    static_assert(sizeof(SnapshotHeader) == 64, "snapshot header must stay 64 bytes");
+
+    uint64_t getPaddedIdCount(uint64_t count)
+    {
+        return (count + 1) & ~1ull;
+    }
+
+    // fnv-1a over 64-bit words
+    uint64_t hashWords(const unsigned char* pBytes, size_t wordCount)
+    {
+        uint64_t hash = FNV_OFFSET;
+        for (size_t i = 0; i < wordCount; i++)
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, pBytes + i * sizeof(uint64_t), sizeof(uint64_t));
+            hash = (hash ^ word) * FNV_PRIME;
+        }
+        return hash;
+    }
+
+    uint64_t hashSection(const void* pData, size_t wordCount)
+    {
+        const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+        const size_t blockCount = (wordCount + CHECKSUM_BLOCK_WORDS - 1) / CHECKSUM_BLOCK_WORDS;
+        std::vector<uint64_t> vecBlockHashes(blockCount);
+        thread_utils::parallelFor(blockCount, 1, [&](size_t begin, size_t end)
+            {
+                for (size_t block = begin; block < end; block++)
+                {
+                    const size_t firstWord = block * CHECKSUM_BLOCK_WORDS;
+                    const size_t blockWords = std::min(CHECKSUM_BLOCK_WORDS, wordCount - firstWord);
+                    vecBlockHashes[block] = hashWords(pBytes + firstWord * sizeof(uint64_t), blockWords);
+                }
+            });
+        return hashWords(reinterpret_cast<const unsigned char*>(vecBlockHashes.data()), blockCount);
+    }
+
+    // ids must hold the padded id count
+    uint64_t getChecksum(const std::vector<uint64_t>& vecPaddedIds, const std::vector<PlayerRecord>& vecRecords)
+    {
+        const uint64_t idHash = hashSection(vecPaddedIds.data(), vecPaddedIds.size());
+        const uint64_t recordHash = hashSection(vecRecords.data(), vecRecords.size() * sizeof(PlayerRecord) / sizeof(uint64_t));
+        return (((FNV_OFFSET ^ idHash) * FNV_PRIME) ^ recordHash) * FNV_PRIME;
+    }
+}
+
+// written to a temporary file first, a crash never leaves a half written snapshot behind
+bool player_snapshot::writeFile(const std::string& path, const PlayerSnapshotData& data)
+{
+    if (data.vecIds.size() != data.vecRecords.size())
+    {
+        std::cerr << "player_snapshot::writeFile: ids and records don't match." << std::endl;
+        return false;
+    }
+    std::vector<uint64_t> vecPaddedIds(data.vecIds);
+    vecPaddedIds.resize(getPaddedIdCount(data.vecIds.size()), 0);
+
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.recordSize = sizeof(PlayerRecord);
+    header.recordCount = data.vecIds.size();
+    header.highWaterTime = data.highWaterTime;
+    header.checksum = getChecksum(vecPaddedIds, data.vecRecords);
+
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(vecPaddedIds.data()), vecPaddedIds.size() * sizeof(uint64_t));
+        file.write(reinterpret_cast<const char*>(data.vecRecords.data()), data.vecRecords.size() * sizeof(PlayerRecord));
+        file.flush();
+        if (!file)
+        {
+            std::cerr << "player_snapshot::writeFile: Failed to write '" << tempPath << "'." << std::endl;
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "player_snapshot::writeFile: Failed to rename '" << tempPath << "'." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// false when the file is missing (silently) or fails any check: magic, version, size or checksum
+bool player_snapshot::readFile(const std::string& path, PlayerSnapshotData& data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return false;
+    }
+    const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    SnapshotHeader header = {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+        || header.version != SNAPSHOT_VERSION
+        || header.recordSize != sizeof(PlayerRecord))
+    {
+        std::cerr << "player_snapshot::readFile: '" << path << "' is not a version " << SNAPSHOT_VERSION << " player snapshot." << std::endl;
+        return false;
+    }
+    const uint64_t paddedIdCount = getPaddedIdCount(header.recordCount);
+    if (fileSize != sizeof(header) + paddedIdCount * sizeof(uint64_t) + header.recordCount * sizeof(PlayerRecord))
+    {
+        std::cerr << "player_snapshot::readFile: '" << path << "' has a wrong size." << std::endl;
+        return false;
+    }
+
+    // one bulk read per section, no per-row decoding
+    data.vecIds.resize(static_cast<size_t>(paddedIdCount));
+    data.vecRecords.resize(static_cast<size_t>(header.recordCount));
+    file.read(reinterpret_cast<char*>(data.vecIds.data()), paddedIdCount * sizeof(uint64_t));
+    file.read(reinterpret_cast<char*>(data.vecRecords.data()), header.recordCount * sizeof(PlayerRecord));
+    if (!file || getChecksum(data.vecIds, data.vecRecords) != header.checksum)
+    {
+        std::cerr << "player_snapshot::readFile: '" << path << "' is corrupted (checksum mismatch)." << std::endl;
+        data.vecIds.clear();
+        data.vecRecords.clear();
+        return false;
+    }
+    data.vecIds.resize(static_cast<size_t>(header.recordCount));
+    data.highWaterTime = header.highWaterTime;
+    return true;
+}
@@ -0,0 +1,29 @@
+// playerSnapshotFile.h
+#ifndef PLAYER_SNAPSHOT_FILE_H
+#define PLAYER_SNAPSHOT_FILE_H
+
+#include "objects/playerRecord.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// every player of player_battles at one point in time, in leaderboard order (score desc, id asc)
+// so loading it never sorts. vecRecords[i] belongs to vecIds[i]
+struct PlayerSnapshotData
+{
+    uint64_t highWaterTime = 0;     // every change stamped before this time is in the snapshot
+    std::vector<uint64_t> vecIds{};
+    std::vector<PlayerRecord> vecRecords{};
+};
+
+// versioned, checksummed binary player snapshot:
+//   header (64 bytes) | ids (8 bytes each, padded to a multiple of 16) | PlayerRecord (16 bytes each)
+// every section is fixed-size and aligned, so it can be used in place from a memory map.
+// updated times before PLAYER_RECORD_EPOCH_MS are stored as 0 (PlayerRecord's range)
+namespace player_snapshot
+{
+    bool writeFile(const std::string& path, const PlayerSnapshotData& data);
+    bool readFile(const std::string& path, PlayerSnapshotData& data);
+}
+
+#endif // PLAYER_SNAPSHOT_FILE_H
@@ -0,0 +1,37 @@
+// playerStore.h
+#ifndef PLAYER_STORE_H
+#define PLAYER_STORE_H
+
+#include "objects/player.h"
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+// persistent storage of player rows (id, score, wins, updated time) and of the player id counter.
+// DbManager routes its player api through the store selected by db_constant::PLAYER_STORE_BACKEND.
+// implementations are thread safe; savePlayers / reservePlayerIds are called from the db writer thread
+class IPlayerStore
+{
+public:
+    virtual ~IPlayerStore() {}
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual const char* getName() const = 0;
+
+    // load-all: every player, or only those with updatedTime >= minUpdatedTime when it is not 0
+    virtual bool forEachPlayer(uint64_t minUpdatedTime, const std::function<void(const PlayerSnapshot&)>& func) = 0;
+    // load-one: false when the player doesn't exist
+    virtual bool loadPlayer(uint64_t id, PlayerSnapshot& snapshot) = 0;
+    // returns the number of players found, missing ids are skipped
+    virtual size_t loadPlayers(const std::vector<uint64_t>& vecIds, const std::function<void(const PlayerSnapshot&)>& func) = 0;
+    // batch upsert, returns the number of rows written: rows from that index on were not written
+    virtual size_t savePlayers(const std::vector<PlayerSnapshot>& vecSnapshots) = 0;
+    // reserve [firstId, firstId + count), never handed out again and above every stored id
+    virtual bool reservePlayerIds(uint64_t count, uint64_t& firstId) = 0;
+    // every save that returned so far survives a power loss once this returns true
+    // (the battle journal is checkpointed only after it)
+    virtual bool sync() = 0;
+};
+
+#endif // PLAYER_STORE_H
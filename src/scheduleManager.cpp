@@ -4,6 +4,9 @@
 // @date  : 2025-05-16
 #include "ScheduleManager.h"
 #include "PlayerManager.h" // ] PlayerManager wgsbå]t saveDirtyPlayers()
+#include "battleManager.h"
+#include "dbManager.h"
+#include <algorithm>
 
 // lƱƵ{AUҦw]gʥȨñҰʤu@
 bool ScheduleManager::initialize()
@@ -13,9 +16,45 @@ bool ScheduleManager::initialize()
         []()
         {
             PlayerManager::instance().saveDirtyPlayers();
+            // evict after the flush so offline players are clean when they leave memory
+            PlayerManager::instance().evictOfflinePlayers();
             //std::cout << "[ScheduleManager] Player data save triggered.\n";
         },
-        5 // jG5 
+        5, true, "save players" // jG5 
+    );
+
+    // leaderboard / player id upkeep (every 1 second)
+    scheduleTask(
+        []()
+        {
+            // fold battle score changes into the leaderboard index
+            PlayerManager::instance().updateLeaderboard();
+            // keep a spare block of new player ids, so creating players never waits on db
+            PlayerManager::instance().refillPlayerIds();
+            // finished matches into match_history, one batched write
+            BattleManager::instance().flushMatchHistory();
+            // a slice of the running online backup
+            DbManager::instance().stepBackup();
+        },
+        1, true, "upkeep"
+    );
+
+    // online backup of the game db, copied by the 1 second task above
+    scheduleTask(
+        []()
+        {
+            DbManager::instance().startBackup(db_constant::BACKUP_FILE);
+        },
+        static_cast<int>(db_constant::BACKUP_INTERVAL_SECONDS), true, "backup"
+    );
+
+    // binary player snapshot for fast startup
+    scheduleTask(
+        []()
+        {
+            PlayerManager::instance().savePlayerSnapshot();
+        },
+        static_cast<int>(db_constant::PLAYER_SNAPSHOT_INTERVAL_SECONDS), true, "snapshot"
     );
 
     // UC߸ (C 10 )
@@ -40,6 +79,11 @@ bool ScheduleManager::initialize()
     std::cout << "ScheduleManager initialized and tasks scheduled.\n";
 
     // ҰʿWߪu@
+    m_isExecutorStopping = false;
+    for (uint32_t i = 0; i < schedule_constant::SCHEDULE_EXECUTOR_COUNT; i++)
+    {
+        m_vecExecutorThreads.emplace_back(&ScheduleManager::executorLoop, this);
+    }
     m_running = true; // ]wBлx
     m_workerThread = std::thread(&ScheduleManager::workerLoop, this); // ҰʰA workerLoop
     return true;
@@ -50,25 +94,48 @@ void ScheduleManager::release()
 {
     if (m_running)
     {
-        m_running = false; // ]wлx
+        {
+            // under the lock, so the worker can't miss the wakeup between its check and its wait
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false; // ]wлx
+        }
+        m_condition.notify_all();
         if (m_workerThread.joinable())
         {
             m_workerThread.join(); // ݰu@õ
             std::cout << "[ScheduleManager] Worker thread joined.\n";
         }
+        // runs already queued still finish
+        {
+            std::lock_guard<std::mutex> lock(m_jobMutex);
+            m_isExecutorStopping = true;
+        }
+        m_jobCondition.notify_all();
+        for (std::thread& executorThread : m_vecExecutorThreads)
+        {
+            executorThread.join();
+        }
+        m_vecExecutorThreads.clear();
     }
     std::lock_guard<std::mutex> lock(m_mutex); // wqHwaMťȦC
     m_tasks.clear(); // MũҦƵ{
+    m_vecAllTasks.clear();
     std::cout << "ScheduleManager released.\n";
 }
 
 // U@ӷs
-void ScheduleManager::scheduleTask(std::function<void()> callback, int intervalSeconds, bool isRepeating)
+void ScheduleManager::scheduleTask(std::function<void()> callback, int intervalSeconds, bool isRepeating, const std::string& name)
 {
-    std::lock_guard<std::mutex> lock(m_mutex); // O@ m_tasks Vq
+    {
+        std::lock_guard<std::mutex> lock(m_mutex); // O@ m_tasks Vq
 
-    // ϥ int c std::chrono::secondsALݽഫ
-    m_tasks.emplace_back(callback, std::chrono::seconds(intervalSeconds), isRepeating);
+        // ϥ int c std::chrono::secondsALݽഫ
+        m_tasks.emplace_back(std::make_shared<ScheduledTask>(name, std::move(callback), std::chrono::seconds(intervalSeconds), isRepeating));
+        m_vecAllTasks.emplace_back(m_tasks.back());
+        std::push_heap(m_tasks.begin(), m_tasks.end(), isLaterDue);
+    }
+    // the new task may be due before the one the worker sleeps for
+    m_condition.notify_one();
 }
 
 // pcy禡@
@@ -80,47 +147,117 @@ ScheduleManager::~ScheduleManager()
 {
 }
 
+// std::*_heap keep the largest element first, so "later due" as less gives a min-heap on nextDueTime
+bool ScheduleManager::isLaterDue(const std::shared_ptr<ScheduledTask>& lhs, const std::shared_ptr<ScheduledTask>& rhs)
+{
+    return lhs->nextDueTime > rhs->nextDueTime;
+}
+
 // |檺֤߰j禡
+// sleeps until the earliest due time (or a new task / release) instead of polling, then hands the task to the executors.
+// a repeating task keeps its own cadence: the next run is one interval after the due time it ran for,
+// not after the moment it ran. runs missed by more than an interval are skipped, not caught up in a burst
 void ScheduleManager::workerLoop()
 {
     std::cout << "[ScheduleManager Thread] Worker loop started.\n";
-    while (m_running) // j|@B檽 m_running ܬ false
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running)
     {
-        std::lock_guard<std::mutex> lock(m_mutex); // wqHwaX m_tasks
+        if (m_tasks.empty())
+        {
+            m_condition.wait(lock, [this]() { return !m_running || !m_tasks.empty(); });
+            continue;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now < m_tasks.front()->nextDueTime)
+        {
+            // the front may change while waiting, so re-check after any wakeup
+            m_condition.wait_until(lock, m_tasks.front()->nextDueTime);
+            continue;
+        }
 
-        auto now = std::chrono::steady_clock::now(); // e׮ɶI
+        std::pop_heap(m_tasks.begin(), m_tasks.end(), isLaterDue);
+        std::shared_ptr<ScheduledTask> pTask = m_tasks.back();
+        dispatchTask(pTask, now);
+        if (!pTask->isRepeating)
+        {
+            m_tasks.pop_back();
+            continue;
+        }
+        pTask->nextDueTime += pTask->interval;
+        if (pTask->nextDueTime <= now)
+        {
+            pTask->nextDueTime = now + pTask->interval;
+        }
+        std::push_heap(m_tasks.begin(), m_tasks.end(), isLaterDue);
+    }
+    std::cout << "[ScheduleManager Thread] Worker loop stopped.\n";
+}
+
+// *** caller holds m_mutex ***
+void ScheduleManager::dispatchTask(const std::shared_ptr<ScheduledTask>& pTask, std::chrono::steady_clock::time_point now)
+{
+    if (pTask->isRunning.exchange(true))
+    {
+        pTask->skippedRuns++;
+        return;
+    }
+    pTask->runDueTime = pTask->nextDueTime;
+    pTask->lastExecutionTime = now;
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_jobQueue.emplace_back(pTask);
+    }
+    m_jobCondition.notify_one();
+}
 
-        // MҦƵ{
-        // ϥέN `it` Kbj餤wa@ʥ
-        for (auto it = m_tasks.begin(); it != m_tasks.end(); )
+// runs the dispatched callbacks without any scheduler lock, so a callback may schedule tasks itself
+void ScheduleManager::executorLoop()
+{
+    while (true)
+    {
+        std::shared_ptr<ScheduledTask> pTask;
         {
-            // ˬdȬO_ (eɶ - Wɶ >= ȶj)
-            if ((now - it->lastExecutionTime) >= it->interval)
-            {
-                it->callback(); // Ȫ^ը禡
-
-                // sWɶeɶI
-                it->lastExecutionTime = now;
-
-                if (!it->isRepeating)
-                {
-                    // pGOu@ȡANqC
-                    it = m_tasks.erase(it);
-                }
-                else
-                {
-                    // pGOư檺ȡAhʨU@ӥ
-                    ++it;
-                }
-            }
-            else
+            std::unique_lock<std::mutex> lock(m_jobMutex);
+
+            m_jobCondition.wait(lock, [this]() { return m_isExecutorStopping || !m_jobQueue.empty(); });
+            if (m_jobQueue.empty())
             {
-                // ȥAʨU@ӥ
-                ++it;
+                return;
             }
+            pTask = std::move(m_jobQueue.front());
+            m_jobQueue.pop_front();
         }
-        // WvAקK CPU APɽTOஷTĲo
-        std::this_thread::sleep_for(std::chrono::milliseconds(1)); // C 1 @ˬd@
+        // lateness includes the wait for a free executor
+        const auto beginTime = std::chrono::steady_clock::now();
+        pTask->lateness.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(beginTime - pTask->runDueTime).count()));
+        pTask->callback();
+        pTask->execution.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - beginTime).count()));
+        pTask->isRunning = false;
     }
-    std::cout << "[ScheduleManager Thread] Worker loop stopped.\n";
+}
+
+std::vector<ScheduleTaskStats> ScheduleManager::getTaskStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<ScheduleTaskStats> vecStats;
+    for (const std::shared_ptr<ScheduledTask>& pTask : m_vecAllTasks)
+    {
+        ScheduleTaskStats stats;
+        stats.name = pTask->name;
+        stats.intervalSeconds = pTask->interval.count();
+        stats.runs = pTask->execution.getCount();
+        stats.skippedRuns = pTask->skippedRuns.load();
+        stats.isRunning = pTask->isRunning.load();
+        stats.latenessAvgMs = pTask->lateness.getAverageUs() / 1000.0;
+        stats.latenessP99Ms = pTask->lateness.getPercentileUs(99) / 1000.0;
+        stats.latenessMaxMs = pTask->lateness.getMaxUs() / 1000.0;
+        stats.executionAvgMs = pTask->execution.getAverageUs() / 1000.0;
+        stats.executionP99Ms = pTask->execution.getPercentileUs(99) / 1000.0;
+        stats.executionMaxMs = pTask->execution.getMaxUs() / 1000.0;
+        vecStats.emplace_back(stats);
+    }
+    return vecStats;
 }
\ No newline at end of file
@@ -2,29 +2,60 @@
 #ifndef SCHEDULE_MANAGER_H
 #define SCHEDULE_MANAGER_H
 
+#include "latencyHistogram.h"
 #include <vector>
+#include <deque>
+#include <memory>
+#include <string>
 #include <functional>
 #include <chrono>        // For std::chrono::steady_clock, std::chrono::seconds, std::chrono::time_point
 #include <mutex>         // For std::mutex, std::lock_guard
 #include <thread>        // For std::thread, std::this_thread
 #include <atomic>        // For std::atomic<bool>
+#include <condition_variable> // For std::condition_variable
 #include <iostream>      // For std::cout (ܽdγ~AΫĳϥΤxw)
 
 // N@ӭnƵ{檺
 struct ScheduledTask
 {
+    std::string name;
     std::function<void()> callback;                 // Ȫ^ը禡
     std::chrono::seconds interval;                  // Ȫ涡j (H)
     std::chrono::steady_clock::time_point lastExecutionTime; // WȪɶI
+    std::chrono::steady_clock::time_point nextDueTime;      // next run, the heap key
     bool isRepeating;                               // ȬO_ư
 
+    // set from dispatch until the run ends: a task never overlaps itself, a due time that finds it set is skipped
+    std::atomic<bool> isRunning{ false };
+    std::atomic<uint64_t> skippedRuns{ 0 };
+    std::chrono::steady_clock::time_point runDueTime;   // due time of the dispatched run, read by the executor
+    LatencyHistogram lateness{};                    // due time -> callback start
+    LatencyHistogram execution{};                   // callback duration, its count is the finished runs
+
     // cy禡
-    ScheduledTask(std::function<void()> cb, std::chrono::seconds iv, bool repeat = true)
-        : callback(std::move(cb)), interval(iv), lastExecutionTime(std::chrono::steady_clock::now()), isRepeating(repeat)
+    ScheduledTask(std::string taskName, std::function<void()> cb, std::chrono::seconds iv, bool repeat = true)
+        : name(std::move(taskName)), callback(std::move(cb)), interval(iv), lastExecutionTime(std::chrono::steady_clock::now()),
+          nextDueTime(lastExecutionTime + iv), isRepeating(repeat)
     {
     }
 };
 
+// per task metrics ("schedstats"), times in ms
+struct ScheduleTaskStats
+{
+    std::string name;
+    int64_t intervalSeconds = 0;
+    uint64_t runs = 0;
+    uint64_t skippedRuns = 0;           // due while the previous run was still going
+    bool isRunning = false;
+    double latenessAvgMs = 0;
+    double latenessP99Ms = 0;
+    double latenessMaxMs = 0;
+    double executionAvgMs = 0;
+    double executionP99Ms = 0;
+    double executionMaxMs = 0;
+};
+
 // ScheduleManager O (ҼҦA޲zҦƵ{ȨæbW߰B)
 class ScheduleManager
 {
@@ -46,7 +77,11 @@ public:
     // callback: ȰɽեΪ禡C
     // intervalSeconds: Ȫ涡j (Ƭ)C
     // isRepeating: ȬO_ư (w] true)C
-    void scheduleTask(std::function<void()> callback, int intervalSeconds, bool isRepeating = true);
+    // name: shown by getTaskStats.
+    // the callback runs on one of the SCHEDULE_EXECUTOR_COUNT executor threads, not under the scheduler lock
+    void scheduleTask(std::function<void()> callback, int intervalSeconds, bool isRepeating = true, const std::string& name = "task");
+
+    std::vector<ScheduleTaskStats> getTaskStats();
 
 private:
     ScheduleManager();
@@ -57,14 +92,30 @@ private:
     ScheduleManager(ScheduleManager&&) = delete;
     ScheduleManager& operator=(ScheduleManager&&) = delete;
 
-    std::vector<ScheduledTask> m_tasks{};               // xsҦƵ{ȪC
+    // min-heap on nextDueTime (std::push_heap / pop_heap with isLaterDue), front = next task due.
+    // a running task stays in the heap, the executor job holds its own reference
+    std::vector<std::shared_ptr<ScheduledTask>> m_tasks{};               // xsҦƵ{ȪC
     std::mutex m_mutex;                                 // O@ m_tasks Vq
 
     std::thread m_workerThread;                         // ΨӰƵ{֤޿誺W߰
     std::atomic<bool> m_running;                        // лxO_~B
+    // the worker sleeps until the next due time, scheduleTask and release wake it early
+    std::condition_variable m_condition;
+    // every registered task in registration order, for the stats (guarded by m_mutex)
+    std::vector<std::shared_ptr<ScheduledTask>> m_vecAllTasks{};
+
+    // executor pool: the worker only queues due tasks here
+    std::vector<std::thread> m_vecExecutorThreads{};
+    std::mutex m_jobMutex;
+    std::condition_variable m_jobCondition;
+    std::deque<std::shared_ptr<ScheduledTask>> m_jobQueue{};
+    bool m_isExecutorStopping = false;
 
     // |檺֤߰j禡
     void workerLoop();
+    void executorLoop();
+    void dispatchTask(const std::shared_ptr<ScheduledTask>& pTask, std::chrono::steady_clock::time_point now);
+    static bool isLaterDue(const std::shared_ptr<ScheduledTask>& lhs, const std::shared_ptr<ScheduledTask>& rhs);
 };
 
 #endif // SCHEDULE_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,501 @@
+// @file  : shardedPlayerStore.cpp
+// @brief : player store split over sqlite shard files by id range
+// @author: August
+// @date  : 2026-10-19
+#include "shardedPlayerStore.h"
+#include "dbManager.h"
+#include "sqlitePlayerStore.h"
+#include "../include/globalDefine.h"
+#include "../sqlite/sqlite3.h"
+#include <iostream>
+#include <algorithm>
+
+ShardedPlayerStore::ShardedPlayerStore(DbManager& dbManager, const std::string& filePrefix, uint32_t shardCount)
+    : m_dbManager(dbManager), m_filePrefix(filePrefix)
+{
+    for (uint32_t i = 0; i < std::max<uint32_t>(1, shardCount); i++)
+    {
+        m_vecShards.emplace_back(new Shard());
+        m_vecShards.back()->fileName = getShardFileName(filePrefix, i);
+    }
+}
+
+ShardedPlayerStore::~ShardedPlayerStore()
+{
+    close();
+}
+
+std::string ShardedPlayerStore::getShardFileName(const std::string& filePrefix, uint32_t shard)
+{
+    return filePrefix + ".shard" + std::to_string(shard) + ".db";
+}
+
+uint32_t ShardedPlayerStore::getShardOf(uint64_t id) const
+{
+    return static_cast<uint32_t>((id / db_constant::PLAYER_SHARD_ID_STRIPE) % m_vecShards.size());
+}
+
+bool ShardedPlayerStore::open()
+{
+    if (m_isOpen)
+    {
+        return true;
+    }
+    for (std::unique_ptr<Shard>& pShard : m_vecShards)
+    {
+        if (!_openShard(*pShard))
+        {
+            close();
+            return false;
+        }
+    }
+    for (std::unique_ptr<Shard>& pShard : m_vecShards)
+    {
+        Shard* pRaw = pShard.get();
+        pRaw->isStopping = false;
+        pRaw->thread = std::thread([this, pRaw]() { _shardLoop(*pRaw); });
+    }
+    m_isOpen = true;
+    std::cout << "ShardedPlayerStore::open " << m_vecShards.size() << " shards '" << getShardFileName(m_filePrefix, 0)
+        << "'..., max id " << getMaxId() << "." << std::endl;
+    return true;
+}
+
+// the writer threads finish their queued tasks first
+void ShardedPlayerStore::close()
+{
+    for (std::unique_ptr<Shard>& pShard : m_vecShards)
+    {
+        {
+            std::lock_guard<std::mutex> lock(pShard->taskMutex);
+            pShard->isStopping = true;
+        }
+        pShard->taskCondition.notify_all();
+    }
+    for (std::unique_ptr<Shard>& pShard : m_vecShards)
+    {
+        if (pShard->thread.joinable())
+        {
+            pShard->thread.join();
+        }
+        _closeShard(*pShard);
+    }
+    m_isOpen = false;
+}
+
+uint64_t ShardedPlayerStore::getMaxId()
+{
+    std::lock_guard<std::mutex> lock(m_idMutex);
+    return m_maxId;
+}
+
+// the shards are scanned at the same time, func is still called on the caller's thread one row at a time.
+// each shard is read in one statement; the shards are not one consistent snapshot together
+bool ShardedPlayerStore::forEachPlayer(uint64_t minUpdatedTime, const std::function<void(const PlayerSnapshot&)>& func)
+{
+    std::vector<std::vector<PlayerSnapshot>> vecShardRows(m_vecShards.size());
+    std::vector<char> vecIsOk(m_vecShards.size(), 0);
+    _runOnShards([&](uint32_t index)
+        {
+            DbStats::Scope scope(m_dbManager.getDbStats(), DbStats::scanPlayers, &m_vecShards[index]->mutex);
+
+            sqlite3* handler = m_vecShards[index]->handler;
+            if (!handler)
+            {
+                return;
+            }
+            const char* sql = (minUpdatedTime == 0) ? SqlitePlayerStore::SQL_SCAN_PLAYER_BATTLES : SqlitePlayerStore::SQL_SCAN_PLAYER_BATTLES_SINCE;
+            sqlite3_stmt* stmt = nullptr;
+            if (m_dbManager.getDbStats().sqlitePrepare(handler, sql, &stmt) != SQLITE_OK)
+            {
+                std::cerr << "ShardedPlayerStore::forEachPlayer: Failed to prepare statement: " << sqlite3_errmsg(handler) << std::endl;
+                sqlite3_finalize(stmt);
+                return;
+            }
+            if (minUpdatedTime != 0)
+            {
+                sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(minUpdatedTime));
+            }
+            int rc = SQLITE_OK;
+            PlayerSnapshot row;
+            while ((rc = m_dbManager.getDbStats().sqliteStep(stmt)) == SQLITE_ROW)
+            {
+                row.id = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+                row.score = static_cast<uint32_t>(sqlite3_column_int(stmt, 1));
+                row.wins = static_cast<uint32_t>(sqlite3_column_int(stmt, 2));
+                row.updatedTime = static_cast<uint64_t>(sqlite3_column_int64(stmt, 3));
+                if (row.id != 0)
+                {
+                    vecShardRows[index].emplace_back(row);
+                }
+            }
+            sqlite3_finalize(stmt);
+            if (rc != SQLITE_DONE)
+            {
+                std::cerr << "ShardedPlayerStore::forEachPlayer: " << sqlite3_errmsg(handler) << std::endl;
+                return;
+            }
+            vecIsOk[index] = 1;
+        });
+
+    for (uint32_t index = 0; index < m_vecShards.size(); index++)
+    {
+        if (!vecIsOk[index])
+        {
+            std::cerr << "ShardedPlayerStore::forEachPlayer: Failed to scan '" << m_vecShards[index]->fileName << "'." << std::endl;
+            return false;
+        }
+    }
+    for (const std::vector<PlayerSnapshot>& vecRows : vecShardRows)
+    {
+        for (const PlayerSnapshot& row : vecRows)
+        {
+            func(row);
+        }
+    }
+    return true;
+}
+
+bool ShardedPlayerStore::loadPlayer(uint64_t id, PlayerSnapshot& snapshot)
+{
+    Shard& shard = *m_vecShards[getShardOf(id)];
+    DbStats::Scope scope(m_dbManager.getDbStats(), DbStats::loadPlayer, &shard.mutex);
+
+    if (!shard.handler)
+    {
+        std::cerr << "ShardedPlayerStore::loadPlayer: Database not open." << std::endl;
+        return false;
+    }
+    return _loadPlayerNoLock(shard, id, snapshot);
+}
+
+// grouped by shard, one read transaction per shard; func still gets the rows in the order of vecIds
+size_t ShardedPlayerStore::loadPlayers(const std::vector<uint64_t>& vecIds, const std::function<void(const PlayerSnapshot&)>& func)
+{
+    std::vector<std::vector<size_t>> vecShardIndexes(m_vecShards.size());
+    for (size_t i = 0; i < vecIds.size(); i++)
+    {
+        vecShardIndexes[getShardOf(vecIds[i])].emplace_back(i);
+    }
+
+    std::vector<PlayerSnapshot> vecRows(vecIds.size());
+    std::vector<char> vecIsFound(vecIds.size(), 0);
+    for (uint32_t index = 0; index < m_vecShards.size(); index++)
+    {
+        if (vecShardIndexes[index].empty())
+        {
+            continue;
+        }
+        Shard& shard = *m_vecShards[index];
+        DbStats::Scope scope(m_dbManager.getDbStats(), DbStats::loadPlayers, &shard.mutex);
+
+        if (!shard.handler)
+        {
+            std::cerr << "ShardedPlayerStore::loadPlayers: Database not open." << std::endl;
+            continue;
+        }
+        sqlite3_exec(shard.handler, "SAVEPOINT load_players;", nullptr, nullptr, nullptr);
+        for (const size_t i : vecShardIndexes[index])
+        {
+            vecIsFound[i] = _loadPlayerNoLock(shard, vecIds[i], vecRows[i]) ? 1 : 0;
+        }
+        sqlite3_exec(shard.handler, "RELEASE load_players;", nullptr, nullptr, nullptr);
+    }
+
+    size_t loadedCount = 0;
+    for (size_t i = 0; i < vecIds.size(); i++)
+    {
+        if (vecIsFound[i])
+        {
+            func(vecRows[i]);
+            loadedCount++;
+        }
+    }
+    return loadedCount;
+}
+
+// the rows are split by shard and every shard writes its part on its own thread at the same time.
+// when a shard fails, the rows from the first one it didn't write on are reported as not written;
+// rows after it that other shards did write are written again by the caller's retry, which is harmless for an upsert
+size_t ShardedPlayerStore::savePlayers(const std::vector<PlayerSnapshot>& vecSnapshots)
+{
+    if (vecSnapshots.empty())
+    {
+        return 0;
+    }
+    std::vector<std::vector<size_t>> vecShardIndexes(m_vecShards.size());
+    for (size_t i = 0; i < vecSnapshots.size(); i++)
+    {
+        vecShardIndexes[getShardOf(vecSnapshots[i].id)].emplace_back(i);
+    }
+
+    std::vector<size_t> vecSavedCounts(m_vecShards.size(), 0);
+    _runOnShards([&](uint32_t index)
+        {
+            if (!vecShardIndexes[index].empty())
+            {
+                vecSavedCounts[index] = _saveShardRows(*m_vecShards[index], vecSnapshots, vecShardIndexes[index]);
+            }
+        });
+
+    size_t savedCount = vecSnapshots.size();
+    uint64_t maxId = 0;
+    for (uint32_t index = 0; index < m_vecShards.size(); index++)
+    {
+        const std::vector<size_t>& vecIndexes = vecShardIndexes[index];
+        for (size_t i = 0; i < vecSavedCounts[index]; i++)
+        {
+            maxId = std::max(maxId, vecSnapshots[vecIndexes[i]].id);
+        }
+        if (vecSavedCounts[index] < vecIndexes.size())
+        {
+            savedCount = std::min(savedCount, vecIndexes[vecSavedCounts[index]]);
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_idMutex);
+
+    m_maxId = std::max(m_maxId, maxId);
+    return savedCount;
+}
+
+// the counter is kept in shard 0 and never goes below the highest id stored in any shard
+bool ShardedPlayerStore::reservePlayerIds(uint64_t count, uint64_t& firstId)
+{
+    Shard& shard = *m_vecShards[0];
+    DbStats::Scope scope(m_dbManager.getDbStats(), DbStats::reservePlayerIds, &shard.mutex);
+
+    sqlite3* handler = shard.handler;
+    if (!handler)
+    {
+        std::cerr << "ShardedPlayerStore::reservePlayerIds: Database not open." << std::endl;
+        return false;
+    }
+    if (sqlite3_exec(handler, "SAVEPOINT reserve_player_ids;", nullptr, nullptr, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "ShardedPlayerStore::reservePlayerIds: Failed to begin transaction: " << sqlite3_errmsg(handler) << std::endl;
+        return false;
+    }
+
+    uint64_t nextId = 1;
+    sqlite3_stmt* stmt = nullptr;
+    bool isOk = (m_dbManager.getDbStats().sqlitePrepare(handler, "SELECT next_id FROM id_allocator WHERE name = 'player_battles';", &stmt) == SQLITE_OK);
+    if (isOk)
+    {
+        const int rc = m_dbManager.getDbStats().sqliteStep(stmt);
+        if (rc == SQLITE_ROW)
+        {
+            nextId = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+        }
+        isOk = (rc == SQLITE_ROW || rc == SQLITE_DONE);
+    }
+    sqlite3_finalize(stmt);
+    firstId = std::max(nextId, getMaxId() + 1);
+
+    if (isOk)
+    {
+        stmt = nullptr;
+        isOk = (m_dbManager.getDbStats().sqlitePrepare(handler,
+            "INSERT INTO id_allocator (name, next_id) VALUES ('player_battles', ?) "
+            "ON CONFLICT(name) DO UPDATE SET next_id = excluded.next_id;", &stmt) == SQLITE_OK);
+        if (isOk)
+        {
+            sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(firstId + count));
+            isOk = (m_dbManager.getDbStats().sqliteStep(stmt) == SQLITE_DONE);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    if (!isOk || m_dbManager.getDbStats().sqliteCommit(handler, "RELEASE reserve_player_ids;") != SQLITE_OK)
+    {
+        std::cerr << "ShardedPlayerStore::reservePlayerIds: " << sqlite3_errmsg(handler) << std::endl;
+        sqlite3_exec(handler, "ROLLBACK TO reserve_player_ids; RELEASE reserve_player_ids;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+}
+
+// the shards are synced at the same time, each under its own lock
+bool ShardedPlayerStore::sync()
+{
+    std::vector<char> vecIsOk(m_vecShards.size(), 0);
+    _runOnShards([&](uint32_t index)
+        {
+            Shard& shard = *m_vecShards[index];
+            DbStats::Scope scope(m_dbManager.getDbStats(), DbStats::admin, &shard.mutex);
+
+            vecIsOk[index] = shard.handler && DbManager::syncCommittedNoLock(shard.fileName, db_constant::STORAGE_PROFILE);
+        });
+    return std::find(vecIsOk.begin(), vecIsOk.end(), 0) == vecIsOk.end();
+}
+
+// the shard gets the pragmas of the game db's storage profile
+bool ShardedPlayerStore::_openShard(Shard& shard)
+{
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    if (sqlite3_open(shard.fileName.c_str(), &shard.handler) != SQLITE_OK)
+    {
+        std::cerr << "ShardedPlayerStore::open: Can't open '" << shard.fileName << "': " << sqlite3_errmsg(shard.handler) << std::endl;
+        sqlite3_close(shard.handler);
+        shard.handler = nullptr;
+        return false;
+    }
+    // the same schema and statements as player_battles / id_allocator in the game db
+    std::string sql = DbManager::getStorageProfileSql(db_constant::STORAGE_PROFILE)
+        + SqlitePlayerStore::SQL_CREATE_PLAYER_BATTLES + ";" + SqlitePlayerStore::SQL_CREATE_PLAYER_BATTLES_INDEX + ";";
+    if (&shard == m_vecShards[0].get())
+    {
+        sql += std::string(SqlitePlayerStore::SQL_CREATE_ID_ALLOCATOR) + ";";
+    }
+    char* errMsg = nullptr;
+    if (sqlite3_exec(shard.handler, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK
+        || sqlite3_prepare_v2(shard.handler, SqlitePlayerStore::SQL_SAVE_PLAYER_BATTLES, -1, &shard.saveStmt, nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(shard.handler, SqlitePlayerStore::SQL_LOAD_PLAYER_BATTLES, -1, &shard.loadStmt, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "ShardedPlayerStore::open: '" << shard.fileName << "': " << (errMsg ? errMsg : sqlite3_errmsg(shard.handler)) << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(shard.handler, "SELECT IFNULL(MAX(id), 0) FROM player_battles;", -1, &stmt, nullptr) == SQLITE_OK
+        && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        std::lock_guard<std::mutex> idLock(m_idMutex);
+
+        m_maxId = std::max(m_maxId, static_cast<uint64_t>(sqlite3_column_int64(stmt, 0)));
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+void ShardedPlayerStore::_closeShard(Shard& shard)
+{
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    sqlite3_finalize(shard.saveStmt);
+    sqlite3_finalize(shard.loadStmt);
+    shard.saveStmt = nullptr;
+    shard.loadStmt = nullptr;
+    if (shard.handler)
+    {
+        sqlite3_close(shard.handler);
+        shard.handler = nullptr;
+    }
+}
+
+void ShardedPlayerStore::_shardLoop(Shard& shard)
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(shard.taskMutex);
+
+            shard.taskCondition.wait(lock, [&shard]() { return shard.isStopping || !shard.taskQueue.empty(); });
+            if (shard.taskQueue.empty())
+            {
+                return;
+            }
+            task = std::move(shard.taskQueue.front());
+            shard.taskQueue.pop_front();
+        }
+        task();
+    }
+}
+
+// before open (or after close) there are no threads, the shards are run on the caller's thread
+void ShardedPlayerStore::_runOnShards(const std::function<void(uint32_t)>& func)
+{
+    if (!m_isOpen)
+    {
+        for (uint32_t index = 0; index < m_vecShards.size(); index++)
+        {
+            func(index);
+        }
+        return;
+    }
+
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    size_t pendingCount = m_vecShards.size();
+    for (uint32_t index = 0; index < m_vecShards.size(); index++)
+    {
+        Shard& shard = *m_vecShards[index];
+        {
+            std::lock_guard<std::mutex> lock(shard.taskMutex);
+
+            shard.taskQueue.emplace_back([&func, &doneMutex, &doneCondition, &pendingCount, index]()
+                {
+                    func(index);
+                    std::lock_guard<std::mutex> doneLock(doneMutex);
+                    if (--pendingCount == 0)
+                    {
+                        doneCondition.notify_one();
+                    }
+                });
+        }
+        shard.taskCondition.notify_one();
+    }
+    std::unique_lock<std::mutex> lock(doneMutex);
+
+    doneCondition.wait(lock, [&pendingCount]() { return pendingCount == 0; });
+}
+
+// SAVE_BATCH_MAX_ROWS per transaction, like SqlitePlayerStore. a failed chunk is rolled back
+size_t ShardedPlayerStore::_saveShardRows(Shard& shard, const std::vector<PlayerSnapshot>& vecSnapshots, const std::vector<size_t>& vecIndexes)
+{
+    size_t savedCount = 0;
+    while (savedCount < vecIndexes.size())
+    {
+        DbStats::Scope scope(m_dbManager.getDbStats(), DbStats::savePlayers, &shard.mutex);
+
+        sqlite3* handler = shard.handler;
+        if (!handler)
+        {
+            std::cerr << "ShardedPlayerStore::savePlayers: Database not open." << std::endl;
+            return savedCount;
+        }
+
+        const size_t chunkEnd = std::min(savedCount + db_constant::SAVE_BATCH_MAX_ROWS, vecIndexes.size());
+        bool isOk = (sqlite3_exec(handler, "SAVEPOINT save_players;", nullptr, nullptr, nullptr) == SQLITE_OK);
+        for (size_t i = savedCount; isOk && i < chunkEnd; i++)
+        {
+            const PlayerSnapshot& snapshot = vecSnapshots[vecIndexes[i]];
+            sqlite3_bind_int(shard.saveStmt, 1, snapshot.score);
+            sqlite3_bind_int(shard.saveStmt, 2, snapshot.wins);
+            sqlite3_bind_int64(shard.saveStmt, 3, snapshot.updatedTime);
+            sqlite3_bind_int64(shard.saveStmt, 4, snapshot.id);
+            isOk = (m_dbManager.getDbStats().sqliteStep(shard.saveStmt) == SQLITE_DONE);
+            sqlite3_reset(shard.saveStmt);
+        }
+
+        if (!isOk || m_dbManager.getDbStats().sqliteCommit(handler, "RELEASE save_players;") != SQLITE_OK)
+        {
+            std::cerr << "ShardedPlayerStore::savePlayers: Failed to save players to '" << shard.fileName << "': "
+                << sqlite3_errmsg(handler) << std::endl;
+            sqlite3_exec(handler, "ROLLBACK TO save_players; RELEASE save_players;", nullptr, nullptr, nullptr);
+            return savedCount;
+        }
+        savedCount = chunkEnd;
+    }
+    return savedCount;
+}
+
+// *** caller holds shard.mutex ***
+bool ShardedPlayerStore::_loadPlayerNoLock(Shard& shard, uint64_t id, PlayerSnapshot& snapshot)
+{
+    sqlite3_stmt* stmt = shard.loadStmt;
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(id));
+
+    const bool isFound = (m_dbManager.getDbStats().sqliteStep(stmt) == SQLITE_ROW);
+    if (isFound)
+    {
+        snapshot.id = id;
+        snapshot.score = sqlite3_column_int(stmt, 0);
+        snapshot.wins = sqlite3_column_int(stmt, 1);
+        snapshot.updatedTime = sqlite3_column_int64(stmt, 2);
+    }
+    sqlite3_reset(stmt);
+    return isFound;
+}
@@ -0,0 +1,85 @@
+// shardedPlayerStore.h
+#ifndef SHARDED_PLAYER_STORE_H
+#define SHARDED_PLAYER_STORE_H
+
+#include "playerStore.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+class DbManager;
+struct sqlite3;
+struct sqlite3_stmt;
+
+// player rows split over several sqlite files by id: the player goes to shard (id / PLAYER_SHARD_ID_STRIPE) % count,
+// so ranges of ids stripe over every shard and new players don't all land in one file.
+// every shard has its own connection and its own writer thread: a save is split by shard and the
+// transactions (and their fsyncs) of the shards run at the same time instead of one after another.
+// reads go straight to the shard's connection on the caller's thread.
+// the id counter lives in shard 0 (id_allocator), above MAX(id) of all shards.
+// *** a save is atomic per shard, not across shards ***
+class ShardedPlayerStore : public IPlayerStore
+{
+public:
+    ShardedPlayerStore(DbManager& dbManager, const std::string& filePrefix, uint32_t shardCount);
+    ~ShardedPlayerStore();
+
+    bool open() override;
+    void close() override;
+    const char* getName() const override { return "sharded"; }
+
+    bool forEachPlayer(uint64_t minUpdatedTime, const std::function<void(const PlayerSnapshot&)>& func) override;
+    bool loadPlayer(uint64_t id, PlayerSnapshot& snapshot) override;
+    size_t loadPlayers(const std::vector<uint64_t>& vecIds, const std::function<void(const PlayerSnapshot&)>& func) override;
+    size_t savePlayers(const std::vector<PlayerSnapshot>& vecSnapshots) override;
+    bool reservePlayerIds(uint64_t count, uint64_t& firstId) override;
+    bool sync() override;
+
+    static std::string getShardFileName(const std::string& filePrefix, uint32_t shard);
+    uint32_t getShardCount() const { return static_cast<uint32_t>(m_vecShards.size()); }
+    uint32_t getShardOf(uint64_t id) const;
+    // highest stored id, 0 when every shard is empty
+    uint64_t getMaxId();
+
+private:
+    struct Shard
+    {
+        std::string fileName;
+        // guards the connection and its statements
+        std::mutex mutex;
+        sqlite3* handler = nullptr;
+        sqlite3_stmt* saveStmt = nullptr;
+        sqlite3_stmt* loadStmt = nullptr;
+
+        // the shard's writer thread runs the posted tasks in order
+        std::thread thread;
+        std::mutex taskMutex;
+        std::condition_variable taskCondition;
+        std::deque<std::function<void()>> taskQueue{};
+        bool isStopping = false;
+    };
+
+    bool _openShard(Shard& shard);
+    void _closeShard(Shard& shard);
+    void _shardLoop(Shard& shard);
+    // runs func(shardIndex) on every shard's writer thread and waits for all of them
+    void _runOnShards(const std::function<void(uint32_t)>& func);
+    // rows [0, return) of vecIndexes were written
+    size_t _saveShardRows(Shard& shard, const std::vector<PlayerSnapshot>& vecSnapshots, const std::vector<size_t>& vecIndexes);
+    bool _loadPlayerNoLock(Shard& shard, uint64_t id, PlayerSnapshot& snapshot);
+
+    DbManager& m_dbManager;
+    std::string m_filePrefix;
+    std::vector<std::unique_ptr<Shard>> m_vecShards{};
+    bool m_isOpen = false;
+
+    // highest id written to any shard, keeps reserved ids above the stored ones without a scan of every shard
+    std::mutex m_idMutex;
+    uint64_t m_maxId = 0;
+};
+
+#endif // SHARDED_PLAYER_STORE_H
@@ -0,0 +1,323 @@
+// @file  : sqlitePlayerStore.cpp
+// @brief : player store on the sqlite game db
+// @author: August
+// @date  : 2026-10-19
+#include "sqlitePlayerStore.h"
+#include "dbManager.h"
+#include "../include/globalDefine.h"
+#include "../sqlite/sqlite3.h"
+#include <iostream>
+#include <algorithm>
+
+const char* const SqlitePlayerStore::SQL_CREATE_PLAYER_BATTLES =
+    "CREATE TABLE IF NOT EXISTS player_battles (id INTEGER PRIMARY KEY, score INTEGER, wins INTEGER, updated_time INTEGER)";
+// startup replays the rows changed since the player snapshot was taken
+const char* const SqlitePlayerStore::SQL_CREATE_PLAYER_BATTLES_INDEX =
+    "CREATE INDEX IF NOT EXISTS idx_player_battles_updated_time ON player_battles (updated_time)";
+const char* const SqlitePlayerStore::SQL_CREATE_ID_ALLOCATOR = "CREATE TABLE IF NOT EXISTS id_allocator (name TEXT PRIMARY KEY, next_id INTEGER)";
+// upsert: players created in memory (PlayerIdAllocator) get their row on the first save,
+// a row that already holds these values is left alone (no page write)
+const char* const SqlitePlayerStore::SQL_SAVE_PLAYER_BATTLES =
+    "INSERT INTO player_battles (id, score, wins, updated_time) VALUES (?4, ?1, ?2, ?3) "
+    "ON CONFLICT(id) DO UPDATE SET score = excluded.score, wins = excluded.wins, updated_time = excluded.updated_time "
+    "WHERE score IS NOT excluded.score OR wins IS NOT excluded.wins OR updated_time IS NOT excluded.updated_time;";
+const char* const SqlitePlayerStore::SQL_LOAD_PLAYER_BATTLES = "SELECT score, wins, updated_time FROM player_battles WHERE id = ?;";
+const char* const SqlitePlayerStore::SQL_SCAN_PLAYER_BATTLES = "SELECT id, score, wins, updated_time FROM player_battles;";
+// goes through idx_player_battles_updated_time
+const char* const SqlitePlayerStore::SQL_SCAN_PLAYER_BATTLES_SINCE = "SELECT id, score, wins, updated_time FROM player_battles WHERE updated_time >= ?;";
+
+SqlitePlayerStore::SqlitePlayerStore(DbManager& dbManager)
+    : m_dbManager(dbManager)
+{
+}
+
+SqlitePlayerStore::~SqlitePlayerStore()
+{
+}
+
+// the connection is opened by DbManager::connect
+bool SqlitePlayerStore::open()
+{
+    return true;
+}
+
+void SqlitePlayerStore::close()
+{
+}
+
+// a single statement reads one consistent db state, on a pooled reader when there is one
+bool SqlitePlayerStore::forEachPlayer(uint64_t minUpdatedTime, const std::function<void(const PlayerSnapshot&)>& func)
+{
+    DbStats::Scope scope(m_dbManager.m_dbStats, DbStats::scanPlayers);
+    DbManager::ReadConnection* pReader = m_dbManager._acquireReader();
+    if (pReader)
+    {
+        const bool isOk = _forEachPlayerNoLock(pReader->handler, minUpdatedTime, func);
+        m_dbManager._releaseReader(pReader);
+        return isOk;
+    }
+    scope.lock(m_dbManager.m_mutex);
+
+    if (!m_dbManager.m_dbHandler)
+    {
+        std::cerr << "SqlitePlayerStore::forEachPlayer: Database not open." << std::endl;
+        return false;
+    }
+    return _forEachPlayerNoLock(m_dbManager.m_dbHandler, minUpdatedTime, func);
+}
+
+// served by the read pool, so a running flush doesn't hold it up; only committed rows are visible there
+bool SqlitePlayerStore::loadPlayer(uint64_t id, PlayerSnapshot& snapshot)
+{
+    DbStats::Scope scope(m_dbManager.m_dbStats, DbStats::loadPlayer);
+    DbManager::ReadConnection* pReader = m_dbManager._acquireReader();
+    if (pReader)
+    {
+        const bool isFound = _loadPlayerNoLock(pReader->handler, pReader->mapStatements, id, snapshot);
+        m_dbManager._releaseReader(pReader);
+        return isFound;
+    }
+    scope.lock(m_dbManager.m_mutex);
+
+    if (!m_dbManager.m_dbHandler)
+    {
+        std::cerr << "SqlitePlayerStore::loadPlayer: Database not open." << std::endl;
+        return false;
+    }
+    return _loadPlayerNoLock(m_dbManager.m_dbHandler, m_dbManager.m_mapStatements, id, snapshot);
+}
+
+size_t SqlitePlayerStore::loadPlayers(const std::vector<uint64_t>& vecIds, const std::function<void(const PlayerSnapshot&)>& func)
+{
+    DbStats::Scope scope(m_dbManager.m_dbStats, DbStats::loadPlayers);
+    DbManager::ReadConnection* pReader = m_dbManager._acquireReader();
+    if (pReader)
+    {
+        const size_t loadedCount = _loadPlayersNoLock(pReader->handler, pReader->mapStatements, vecIds, func);
+        m_dbManager._releaseReader(pReader);
+        return loadedCount;
+    }
+    scope.lock(m_dbManager.m_mutex);
+
+    if (!m_dbManager.m_dbHandler)
+    {
+        std::cerr << "SqlitePlayerStore::loadPlayers: Database not open." << std::endl;
+        return 0;
+    }
+    return _loadPlayersNoLock(m_dbManager.m_dbHandler, m_dbManager.m_mapStatements, vecIds, func);
+}
+
+// SAVE_BATCH_MAX_ROWS per transaction with one prepared statement.
+// the lock is released between chunks so reads on the writer connection can get in between.
+// on a failed chunk that chunk is rolled back and the rows from it on are left for the caller to retry
+size_t SqlitePlayerStore::savePlayers(const std::vector<PlayerSnapshot>& vecSnapshots)
+{
+    size_t savedCount = 0;
+    while (savedCount < vecSnapshots.size())
+    {
+        DbStats::Scope scope(m_dbManager.m_dbStats, DbStats::savePlayers, &m_dbManager.m_mutex);
+
+        sqlite3* handler = m_dbManager.m_dbHandler;
+        if (!handler)
+        {
+            std::cerr << "SqlitePlayerStore::savePlayers: Database not open." << std::endl;
+            return savedCount;
+        }
+        sqlite3_stmt* stmt = m_dbManager._prepareStatementNoLock(SQL_SAVE_PLAYER_BATTLES);
+        if (!stmt)
+        {
+            std::cerr << "SqlitePlayerStore::savePlayers: Failed to prepare statement: " << sqlite3_errmsg(handler) << std::endl;
+            return savedCount;
+        }
+
+        // a savepoint also nests inside a transaction that is already open on this connection
+        const size_t chunkEnd = std::min(savedCount + db_constant::SAVE_BATCH_MAX_ROWS, vecSnapshots.size());
+        bool isOk = (sqlite3_exec(handler, "SAVEPOINT save_players;", nullptr, nullptr, nullptr) == SQLITE_OK);
+        for (size_t i = savedCount; isOk && i < chunkEnd; i++)
+        {
+            const PlayerSnapshot& snapshot = vecSnapshots[i];
+            sqlite3_bind_int(stmt, 1, snapshot.score);
+            sqlite3_bind_int(stmt, 2, snapshot.wins);
+            sqlite3_bind_int64(stmt, 3, snapshot.updatedTime);
+            sqlite3_bind_int64(stmt, 4, snapshot.id);
+            isOk = (m_dbManager.m_dbStats.sqliteStep(stmt) == SQLITE_DONE);
+            sqlite3_reset(stmt);
+        }
+        m_dbManager._releaseStatementNoLock(stmt);
+
+        if (!isOk || m_dbManager.m_dbStats.sqliteCommit(handler, "RELEASE save_players;") != SQLITE_OK)
+        {
+            std::cerr << "SqlitePlayerStore::savePlayers: Failed to save players: " << sqlite3_errmsg(handler) << std::endl;
+            sqlite3_exec(handler, "ROLLBACK TO save_players; RELEASE save_players;", nullptr, nullptr, nullptr);
+            return savedCount;
+        }
+        savedCount = chunkEnd;
+    }
+    return savedCount;
+}
+
+// the next free id is kept in id_allocator and never goes below MAX(id) + 1 of player_battles
+bool SqlitePlayerStore::reservePlayerIds(uint64_t count, uint64_t& firstId)
+{
+    DbStats::Scope scope(m_dbManager.m_dbStats, DbStats::reservePlayerIds, &m_dbManager.m_mutex);
+
+    sqlite3* handler = m_dbManager.m_dbHandler;
+    if (!handler)
+    {
+        std::cerr << "SqlitePlayerStore::reservePlayerIds: Database not open." << std::endl;
+        return false;
+    }
+
+    // a savepoint also nests inside a transaction that is already open on this connection
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(handler, "SAVEPOINT reserve_player_ids;", nullptr, nullptr, &errMsg);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "SqlitePlayerStore::reservePlayerIds: Failed to begin transaction: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+
+    const char* sqlSelect =
+        "SELECT MAX(IFNULL((SELECT next_id FROM id_allocator WHERE name = 'player_battles'), 1), "
+        "IFNULL((SELECT MAX(id) FROM player_battles), 0) + 1);";
+    sqlite3_stmt* stmt = m_dbManager._prepareStatementNoLock(sqlSelect);
+    if (stmt && m_dbManager.m_dbStats.sqliteStep(stmt) == SQLITE_ROW)
+    {
+        firstId = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+    }
+    else
+    {
+        rc = SQLITE_ERROR;
+    }
+    m_dbManager._releaseStatementNoLock(stmt);
+
+    if (rc == SQLITE_OK)
+    {
+        const char* sqlUpdate =
+            "INSERT INTO id_allocator (name, next_id) VALUES ('player_battles', ?) "
+            "ON CONFLICT(name) DO UPDATE SET next_id = excluded.next_id;";
+        stmt = m_dbManager._prepareStatementNoLock(sqlUpdate);
+        rc = SQLITE_ERROR;
+        if (stmt)
+        {
+            sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(firstId + count));
+            rc = (m_dbManager.m_dbStats.sqliteStep(stmt) == SQLITE_DONE) ? SQLITE_OK : SQLITE_ERROR;
+        }
+        m_dbManager._releaseStatementNoLock(stmt);
+    }
+
+    if (rc != SQLITE_OK || m_dbManager.m_dbStats.sqliteCommit(handler, "RELEASE reserve_player_ids;") != SQLITE_OK)
+    {
+        std::cerr << "SqlitePlayerStore::reservePlayerIds: " << sqlite3_errmsg(handler) << std::endl;
+        sqlite3_exec(handler, "ROLLBACK TO reserve_player_ids; RELEASE reserve_player_ids;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+}
+
+// the writer connection is the only one that commits or checkpoints, holding its lock keeps both files still
+bool SqlitePlayerStore::sync()
+{
+    DbStats::Scope scope(m_dbManager.m_dbStats, DbStats::admin, &m_dbManager.m_mutex);
+
+    if (!m_dbManager.m_dbHandler)
+    {
+        return false;
+    }
+    return DbManager::syncCommittedNoLock(m_dbManager.m_dbName, m_dbManager.m_storageProfile);
+}
+
+// the filtered scan goes through idx_player_battles_updated_time.
+// *** caller owns handler: DbManager's m_mutex for its writer connection, an acquired reader otherwise ***
+bool SqlitePlayerStore::_forEachPlayerNoLock(sqlite3* handler, uint64_t minUpdatedTime, const std::function<void(const PlayerSnapshot&)>& func)
+{
+    const char* sql = (minUpdatedTime == 0) ? SQL_SCAN_PLAYER_BATTLES : SQL_SCAN_PLAYER_BATTLES_SINCE;
+    sqlite3_stmt* stmt = nullptr;
+    if (m_dbManager.m_dbStats.sqlitePrepare(handler, sql, &stmt) != SQLITE_OK)
+    {
+        std::cerr << "SqlitePlayerStore::forEachPlayer: Failed to prepare statement: " << sqlite3_errmsg(handler) << std::endl;
+        sqlite3_finalize(stmt);
+        return false;
+    }
+    if (minUpdatedTime != 0)
+    {
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(minUpdatedTime));
+    }
+    int rc = SQLITE_OK;
+    PlayerSnapshot row;
+    while ((rc = m_dbManager.m_dbStats.sqliteStep(stmt)) == SQLITE_ROW)
+    {
+        row.id = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+        row.score = static_cast<uint32_t>(sqlite3_column_int(stmt, 1));
+        row.wins = static_cast<uint32_t>(sqlite3_column_int(stmt, 2));
+        row.updatedTime = static_cast<uint64_t>(sqlite3_column_int64(stmt, 3));
+        if (row.id != 0)
+        {
+            func(row);
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        std::cerr << "SqlitePlayerStore::forEachPlayer: " << sqlite3_errmsg(handler) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SqlitePlayerStore::_loadPlayerNoLock(sqlite3* handler, StatementMap& mapStatements, uint64_t id, PlayerSnapshot& snapshot)
+{
+    sqlite3_stmt* stmt = m_dbManager._prepareStatementNoLock(handler, mapStatements, SQL_LOAD_PLAYER_BATTLES);
+    if (!stmt)
+    {
+        std::cerr << "SqlitePlayerStore::loadPlayer: Failed to prepare statement: " << sqlite3_errmsg(handler) << std::endl;
+        return false;
+    }
+    sqlite3_bind_int64(stmt, 1, id);
+
+    const bool isFound = (m_dbManager.m_dbStats.sqliteStep(stmt) == SQLITE_ROW);
+    if (isFound)
+    {
+        snapshot.id = id;
+        snapshot.score = sqlite3_column_int(stmt, 0);
+        snapshot.wins = sqlite3_column_int(stmt, 1);
+        snapshot.updatedTime = sqlite3_column_int64(stmt, 2);
+    }
+    m_dbManager._releaseStatementNoLock(stmt);
+    return isFound;
+}
+
+// one prepared statement inside one read transaction
+size_t SqlitePlayerStore::_loadPlayersNoLock(sqlite3* handler, StatementMap& mapStatements, const std::vector<uint64_t>& vecIds,
+    const std::function<void(const PlayerSnapshot&)>& func)
+{
+    sqlite3_stmt* stmt = m_dbManager._prepareStatementNoLock(handler, mapStatements, SQL_LOAD_PLAYER_BATTLES);
+    if (!stmt)
+    {
+        std::cerr << "SqlitePlayerStore::loadPlayers: Failed to prepare statement: " << sqlite3_errmsg(handler) << std::endl;
+        return 0;
+    }
+
+    // a savepoint nests in an open transaction
+    sqlite3_exec(handler, "SAVEPOINT load_players;", nullptr, nullptr, nullptr);
+    size_t loadedCount = 0;
+    PlayerSnapshot snapshot;
+    for (const uint64_t id : vecIds)
+    {
+        sqlite3_bind_int64(stmt, 1, id);
+        if (m_dbManager.m_dbStats.sqliteStep(stmt) == SQLITE_ROW)
+        {
+            snapshot.id = id;
+            snapshot.score = sqlite3_column_int(stmt, 0);
+            snapshot.wins = sqlite3_column_int(stmt, 1);
+            snapshot.updatedTime = sqlite3_column_int64(stmt, 2);
+            func(snapshot);
+            loadedCount++;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_exec(handler, "RELEASE load_players;", nullptr, nullptr, nullptr);
+    m_dbManager._releaseStatementNoLock(stmt);
+    return loadedCount;
+}
@@ -0,0 +1,52 @@
+// sqlitePlayerStore.h
+#ifndef SQLITE_PLAYER_STORE_H
+#define SQLITE_PLAYER_STORE_H
+
+#include "playerStore.h"
+#include <string>
+#include <unordered_map>
+
+class DbManager;
+struct sqlite3;
+struct sqlite3_stmt;
+
+// player rows in the player_battles / id_allocator tables. connections, the read pool and the
+// statement cache belong to DbManager: writes use its writer connection, reads a pooled reader
+class SqlitePlayerStore : public IPlayerStore
+{
+public:
+    explicit SqlitePlayerStore(DbManager& dbManager);
+    ~SqlitePlayerStore();
+
+    bool open() override;
+    void close() override;
+    const char* getName() const override { return "sqlite"; }
+
+    bool forEachPlayer(uint64_t minUpdatedTime, const std::function<void(const PlayerSnapshot&)>& func) override;
+    bool loadPlayer(uint64_t id, PlayerSnapshot& snapshot) override;
+    size_t loadPlayers(const std::vector<uint64_t>& vecIds, const std::function<void(const PlayerSnapshot&)>& func) override;
+    size_t savePlayers(const std::vector<PlayerSnapshot>& vecSnapshots) override;
+    bool reservePlayerIds(uint64_t count, uint64_t& firstId) override;
+    bool sync() override;
+
+    // schema and statements of the player rows, shared by every sqlite based store (the game db, the shards)
+    static const char* const SQL_CREATE_PLAYER_BATTLES;
+    static const char* const SQL_CREATE_PLAYER_BATTLES_INDEX;
+    static const char* const SQL_CREATE_ID_ALLOCATOR;
+    static const char* const SQL_SAVE_PLAYER_BATTLES;
+    static const char* const SQL_LOAD_PLAYER_BATTLES;
+    static const char* const SQL_SCAN_PLAYER_BATTLES;
+    static const char* const SQL_SCAN_PLAYER_BATTLES_SINCE;
+
+private:
+    typedef std::unordered_map<std::string, sqlite3_stmt*> StatementMap;
+
+    bool _forEachPlayerNoLock(sqlite3* handler, uint64_t minUpdatedTime, const std::function<void(const PlayerSnapshot&)>& func);
+    bool _loadPlayerNoLock(sqlite3* handler, StatementMap& mapStatements, uint64_t id, PlayerSnapshot& snapshot);
+    size_t _loadPlayersNoLock(sqlite3* handler, StatementMap& mapStatements, const std::vector<uint64_t>& vecIds,
+        const std::function<void(const PlayerSnapshot&)>& func);
+
+    DbManager& m_dbManager;
+};
+
+#endif // SQLITE_PLAYER_STORE_H
@@ -6,6 +6,9 @@
 #include <chrono>    // for std::chrono::system_clock, milliseconds, time_point
 #include <sstream>
 #include <iomanip>   // for std::put_time
+#include <thread>
+#include <vector>
+#include <algorithm>
 
 namespace time_utils
 {
@@ -48,3 +51,25 @@ namespace time_utils
         return oss.str();
     }
 }
+
+namespace thread_utils
+{
+    void parallelFor(size_t count, size_t minRangeSize, const std::function<void(size_t, size_t)>& func)
+    {
+        const size_t hardwareThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        const size_t rangeCount = std::max<size_t>(1, std::min(hardwareThreads, count / std::max<size_t>(1, minRangeSize)));
+        const size_t rangeSize = (count + rangeCount - 1) / rangeCount;
+
+        std::vector<std::thread> vecThreads;
+        for (size_t begin = rangeSize; begin < count; begin += rangeSize)
+        {
+            vecThreads.emplace_back(func, begin, std::min(begin + rangeSize, count));
+        }
+        // the first range runs here
+        func(0, std::min(rangeSize, count));
+        for (std::thread& thread : vecThreads)
+        {
+            thread.join();
+        }
+    }
+}
@@ -5,6 +5,7 @@
 #include <cstdint> // For uint64_t
 #include <random>
 #include <limits>
+#include <functional>
 
 namespace time_utils
 {
@@ -12,6 +13,12 @@ namespace time_utils
     uint64_t getTimestamp();
     std::string formatTimestampMs(uint64_t timestamp);
 }
+namespace thread_utils
+{
+    // runs func(begin, end) over [0, count) split into one range per hardware thread, returns when all are done.
+    // ranges below minRangeSize are not worth a thread and run on the caller's thread
+    void parallelFor(size_t count, size_t minRangeSize, const std::function<void(size_t, size_t)>& func);
+}
 namespace random_utils
 {
     static std::random_device rd;